@@ -0,0 +1,312 @@
+//     ____  __________     ___   ____ ___  _____ //
+//    / __ \/ ____/ __ \   |__ \ / __ \__ \|__  / //
+//   / /_/ / /   / / / /   __/ // / / /_/ / /_ <  //
+//  / ____/ /___/ /_/ /   / __// /_/ / __/___/ /  //
+// /_/    \____/\____/   /____/\____/____/____/   //
+// Auteurs : Timothée Van Hove, Aubry Mangold
+
+// Headless batch runner: submits the computations of a request file to a ComputationManager and writes
+// their results to a result file, in the order of the requests (see batchfile.h for the formats).
+//
+//   PCO_lab06_batch [options] <requests> <results>
+//   PCO_lab06_batch --generate <count> <max size> <requests>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "batchfile.h"
+#include "computationmanager.h"
+#include "computeenvironment.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Large stream buffers, the files are read and written sequentially
+constexpr std::size_t IO_BUFFER_SIZE = std::size_t{1} << 20;
+
+struct Options
+{
+    int queueSize = 16;
+    unsigned engines[4] = {2, 1, 1, 1};
+    std::size_t granularity = 0;
+    unsigned fiberWorkers = 0;
+    std::string requests;
+    std::string results;
+};
+
+/**
+ * @brief The SubmitLog class hands the submission times of the requests from the reader to the writer, in
+ * the order of the requests
+ */
+class SubmitLog
+{
+public:
+    void push(Clock::time_point time) {
+        std::lock_guard<std::mutex> lock(mutex);
+        times.push_back(time);
+        available.notify_one();
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        available.notify_one();
+    }
+
+    /**
+     * @brief pop Waits for the time of the next request, empty once every request was popped and the log closed
+     */
+    std::optional<Clock::time_point> pop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        available.wait(lock, [this] {return !times.empty() || closed;});
+        if (times.empty()) {
+            return std::nullopt;
+        }
+        auto const time = times.front();
+        times.pop_front();
+        return time;
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable available;
+    std::deque<Clock::time_point> times;
+    bool closed = false;
+};
+
+/**
+ * @brief The Stats struct gathers what the writer saw of the results
+ */
+struct Stats
+{
+    std::vector<double> latencies;
+    std::size_t notOk = 0;
+};
+
+void usage() {
+    std::fprintf(stderr,
+                 "Usage: PCO_lab06_batch [options] <requests> <results>\n"
+                 "       PCO_lab06_batch --generate <count> <max size> <requests>\n"
+                 "Options:\n"
+                 "  --queue <n>        maximum number of pending requests per type (16)\n"
+                 "  -a <n>, -b <n>, -c <n>, -d <n>  number of engines of each type (2, 1, 1, 1)\n"
+                 "  --granularity <n>  elements reduced between two checks for cancellation (4096)\n"
+                 "  --fibers <n>       run the engines on fibers over n worker threads\n");
+}
+
+unsigned long parseNumber(const char* text) {
+    char* end = nullptr;
+    auto const value = std::strtoul(text, &end, 10);
+    if (end == text || *end != '\0') {
+        throw std::invalid_argument(std::string("Not a number: ") + text);
+    }
+    return value;
+}
+
+std::optional<Options> parseOptions(int argc, char** argv) {
+    Options options;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto const value = [&] {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Missing value for " + arg);
+            }
+            return parseNumber(argv[++i]);
+        };
+        if (arg == "--queue") {
+            options.queueSize = static_cast<int>(value());
+        } else if (arg == "-a" || arg == "-b" || arg == "-c" || arg == "-d") {
+            options.engines[arg[1] - 'a'] = static_cast<unsigned>(value());
+        } else if (arg == "--granularity") {
+            options.granularity = value();
+        } else if (arg == "--fibers") {
+            options.fiberWorkers = static_cast<unsigned>(value());
+        } else if (!arg.empty() && arg[0] == '-') {
+            return std::nullopt;
+        } else {
+            files.push_back(arg);
+        }
+    }
+    if (files.size() != 2) {
+        return std::nullopt;
+    }
+    options.requests = files[0];
+    options.results = files[1];
+    return options;
+}
+
+/**
+ * @brief generate Writes a request file of count random computations, A, B and D of up to maxSize elements
+ * and C of two operands
+ */
+void generate(std::size_t count, std::size_t maxSize, const std::string& path) {
+    std::vector<char> buffer(IO_BUFFER_SIZE);
+    std::ofstream out;
+    out.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    out.open(path, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("Could not create " + path);
+    }
+
+    std::mt19937_64 random(42);
+    std::uniform_int_distribution<int> types(0, 3);
+    std::uniform_int_distribution<std::size_t> sizes(1, std::max<std::size_t>(maxSize, 1));
+    // Factors close to one so that the products stay in range
+    std::uniform_real_distribution<double> values(0.9, 1.1);
+
+    BatchRequestWriter writer(out);
+    for (std::size_t i = 0; i < count; ++i) {
+        auto const type = static_cast<ComputationType>(types(random));
+        Computation c(type, type == ComputationType::C ? 2 : sizes(random));
+        std::generate(c.data->begin(), c.data->end(), [&] {return values(random);});
+        writer.write(c);
+    }
+}
+
+/**
+ * @brief run Submits the requests of the file and writes the results, then prints the statistics
+ */
+void run(const Options& options) {
+    std::vector<char> inBuffer(IO_BUFFER_SIZE);
+    std::ifstream in;
+    in.rdbuf()->pubsetbuf(inBuffer.data(), static_cast<std::streamsize>(inBuffer.size()));
+    in.open(options.requests, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Could not open " + options.requests);
+    }
+    std::vector<char> outBuffer(IO_BUFFER_SIZE);
+    std::ofstream out;
+    out.rdbuf()->pubsetbuf(outBuffer.data(), static_cast<std::streamsize>(outBuffer.size()));
+    out.open(options.results, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("Could not create " + options.results);
+    }
+
+    BatchRequestReader reader(in);
+    BatchResultWriter writer(out);
+
+    auto cm = std::make_shared<ComputationManager>(options.queueSize);
+    Execution execution;
+    if (options.fiberWorkers > 0) {
+        execution.mode = ExecutionMode::Fibers;
+        execution.workers = options.fiberWorkers;
+    }
+    auto const granularity = options.granularity > 0 ? Granularity::byElements(options.granularity) : Granularity{};
+    ComputeEnvironment environment(cm, granularity, {}, execution);
+    environment.populateComputeEnvironment(options.engines[0], options.engines[1], options.engines[2], options.engines[3]);
+    environment.startComputeEnvironment();
+
+    // The results come in the order of the requests, the writer matches them with their submission times
+    SubmitLog log;
+    Stats stats;
+    std::string writeError;
+    auto resultWriter = std::thread([&] {
+        try {
+            while (auto const submitted = log.pop()) {
+                auto const result = cm->getNextResult();
+                stats.latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - *submitted).count());
+                stats.notOk += result.getStatus() != ResultStatus::Ok;
+                writer.write(result);
+            }
+        } catch (ComputationManager::StopException&) {
+            // The reader failed, the remaining results are not written
+        } catch (std::exception& e) {
+            // Releases the reader
+            writeError = e.what();
+            cm->stop();
+        }
+    });
+
+    auto const start = Clock::now();
+    std::size_t requests = 0;
+    std::size_t elements = 0;
+    try {
+        while (auto c = reader.next()) {
+            // The request would wait forever for an engine, and the writer for its result
+            if (options.engines[static_cast<std::size_t>(c->computationType)] == 0) {
+                throw std::runtime_error(std::string("The request file holds computations of type ") +
+                                         static_cast<char>('A' + static_cast<int>(c->computationType)) +
+                                         " but no engine of this type was asked for");
+            }
+            elements += c->size();
+            auto const now = Clock::now();
+            cm->requestComputation(std::move(*c));
+            log.push(now);
+            ++requests;
+        }
+    } catch (...) {
+        cm->stop();
+        log.close();
+        resultWriter.join();
+        environment.joinComputeEnvironment();
+        if (!writeError.empty()) {
+            throw std::runtime_error(writeError);
+        }
+        throw;
+    }
+    log.close();
+    resultWriter.join();
+    auto const seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    cm->stop();
+    environment.joinComputeEnvironment();
+    if (!writeError.empty()) {
+        throw std::runtime_error(writeError);
+    }
+    out.flush();
+    if (!out) {
+        throw std::runtime_error("Could not write " + options.results);
+    }
+
+    auto& latencies = stats.latencies;
+    std::sort(latencies.begin(), latencies.end());
+    auto const percentile = [&latencies](double p) {
+        return latencies.empty() ? 0.0 : latencies[static_cast<std::size_t>(p / 100.0 * static_cast<double>(latencies.size() - 1))];
+    };
+    std::printf("%zu requests (%zu elements) in %.3f s\n", requests, elements, seconds);
+    std::printf("  throughput  %12.0f requests/s %12.0f elements/s\n", static_cast<double>(requests) / seconds,
+                static_cast<double>(elements) / seconds);
+    std::printf("  latency     p50 %10.1f us   p99 %10.1f us   max %10.1f us\n", percentile(50.0), percentile(99.0),
+                percentile(100.0));
+    std::printf("  %zu results are not Ok\n", stats.notOk);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    try {
+        if (argc > 1 && std::string(argv[1]) == "--generate") {
+            if (argc != 5) {
+                usage();
+                return 2;
+            }
+            generate(parseNumber(argv[2]), parseNumber(argv[3]), argv[4]);
+            return 0;
+        }
+
+        auto const options = parseOptions(argc, argv);
+        if (!options) {
+            usage();
+            return 2;
+        }
+        run(*options);
+    } catch (std::exception& e) {
+        std::fprintf(stderr, "PCO_lab06_batch: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,73 @@
+#ifndef BENCHUTILS_H
+#define BENCHUTILS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using BenchClock = std::chrono::steady_clock;
+
+/**
+ * @brief The LatencySamples class collects latencies and reports their percentiles
+ */
+class LatencySamples
+{
+public:
+    explicit LatencySamples(std::size_t expected = 0) {samples.reserve(expected);}
+
+    void add(std::chrono::nanoseconds latency) {samples.push_back(latency.count());}
+
+    /**
+     * @brief percentile Returns the given percentile of the samples in nanoseconds
+     * @param p the percentile, between 0 and 100
+     */
+    [[nodiscard]] long long percentile(double p) {
+        if (samples.empty()) {
+            return 0;
+        }
+        auto const rank = static_cast<std::size_t>(p / 100.0 * static_cast<double>(samples.size() - 1));
+        std::nth_element(samples.begin(), samples.begin() + static_cast<std::ptrdiff_t>(rank), samples.end());
+        return samples[rank];
+    }
+
+    void report(const std::string& label) {
+        std::printf("  %-40s p50 %8lld ns   p99 %8lld ns\n", label.c_str(), percentile(50.0), percentile(99.0));
+    }
+
+private:
+    std::vector<long long> samples;
+};
+
+/**
+ * @brief busyWait Burns the cpu for the given duration (used to space out requests without sleeping)
+ */
+inline void busyWait(std::chrono::nanoseconds duration) {
+    auto const until = BenchClock::now() + duration;
+    while (BenchClock::now() < until) {}
+}
+
+/**
+ * @brief timeIt Returns the best wall time of a few runs of f, in seconds
+ */
+template <typename F>
+double timeIt(F&& f, int runs = 5) {
+    double best = 1e300;
+    for (int i = 0; i < runs; ++i) {
+        auto const start = BenchClock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double>(BenchClock::now() - start).count());
+    }
+    return best;
+}
+
+/**
+ * @brief doNotOptimize Prevents the compiler from discarding a computed value
+ */
+template <typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+#endif // BENCHUTILS_H
@@ -0,0 +1,795 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <thread>
+
+#include "benchutils.h"
+
+#include "computationmanager.h"
+#include "computeengine.h"
+#include "computeenvironment.h"
+#include "kernels.h"
+#include "mappedpayload.h"
+#include "payloadpool.h"
+#include "placement.h"
+#include "resultsink.h"
+
+/* Round trip latency (request to result) of sub-microsecond C jobs depending on the wait strategy.
+ * The client spaces out its requests by a think time, which is what makes the engine and the client
+ * park between jobs. */
+static void benchWaitStrategy() {
+    constexpr int ROUNDS = 20000;
+    const std::vector<std::pair<WaitStrategy, std::string>> strategies = {
+        {WaitStrategy::Park, "Park"},
+        {WaitStrategy::SpinThenPark, "SpinThenPark"},
+    };
+
+    std::printf("Round trip latency of C requests\n");
+    for (auto const& [strategy, name] : strategies) {
+        for (auto const thinkTime : {0, 5'000, 50'000}) {
+            auto cm = std::make_shared<ComputationManager>(10, strategy);
+            ComputeEngineC engine(cm);
+            engine.startThread();
+
+            LatencySamples latencies(ROUNDS);
+            for (int i = 0; i < ROUNDS; ++i) {
+                Computation c(ComputationType::C);
+                *c.data = {1.0, 3.0};
+                auto const start = BenchClock::now();
+                cm->requestComputation(c);
+                doNotOptimize(cm->getNextResult().getResult());
+                latencies.add(BenchClock::now() - start);
+                busyWait(std::chrono::nanoseconds(thinkTime));
+            }
+            latencies.report(name + ", think time " + std::to_string(thinkTime / 1000) + " us");
+
+            cm->stop();
+            engine.join();
+        }
+    }
+}
+
+/* Time to sum 10M doubles through a ComputeEngineA depending on the step granularity. */
+static void benchGranularity() {
+    const std::vector<std::pair<Granularity, std::string>> granularities = {
+        {Granularity::byElements(1), "1 element"},
+        {Granularity::byElements(4096), "4096 elements"},
+        {Granularity::byTime(std::chrono::microseconds(100)), "100 us"},
+    };
+
+    Computation sum(ComputationType::A);
+    sum.data->assign(10'000'000, 1.0);
+
+    std::printf("Sum of 10M doubles per step granularity\n");
+    for (auto const& [granularity, name] : granularities) {
+        auto cm = std::make_shared<ComputationManager>();
+        ComputeEngineA engine(cm, granularity);
+        engine.startThread();
+
+        auto const seconds = timeIt([&] {
+            cm->requestComputation(sum);
+            doNotOptimize(cm->getNextResult().getResult());
+        }, 3);
+        std::printf("  %-40s %8.2f ms\n", name.c_str(), seconds * 1e3);
+
+        cm->stop();
+        engine.join();
+    }
+}
+
+/* Throughput of the sum kernels against the element by element loop ComputeEngineA used to run. */
+static void benchSum() {
+    std::printf("Sum kernels (detected: %s)\n", simdLevelName(detectedSimdLevel()));
+    for (std::size_t n : {std::size_t{1} << 16, std::size_t{1} << 25}) {
+        std::vector<double> values(n);
+        std::iota(values.begin(), values.end(), 0.0);
+        auto const gigabytes = static_cast<double>(n * sizeof(double)) / 1e9;
+        auto const report = [&](const std::string& label, double seconds) {
+            std::printf("  %-40s %8.2f GB/s\n", (label + ", " + std::to_string(n) + " doubles").c_str(), gigabytes / seconds);
+        };
+
+        report("scalar at() loop", timeIt([&] {
+            double result = 0.0;
+            for (std::size_t i = 0; i < values.size(); ++i) {
+                result += values.at(i);
+            }
+            doNotOptimize(result);
+        }));
+
+        for (auto level : {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512}) {
+            if (level > detectedSimdLevel()) {
+                continue;
+            }
+            for (auto const& [mode, name] : {std::pair{SummationMode::Fast, "fast"},
+                                             std::pair{SummationMode::Compensated, "compensated"},
+                                             std::pair{SummationMode::Pairwise, "pairwise"}}) {
+                report(std::string(simdLevelName(level)) + " " + name, timeIt([&] {
+                    SumAccumulator acc;
+                    accumulateSum(acc, values.data(), values.size(), mode, level);
+                    doNotOptimize(acc.value());
+                }));
+            }
+        }
+    }
+}
+
+/* Throughput of the scaled product kernels against the plain loop ComputeEngineB used to run. */
+static void benchProduct() {
+    std::printf("Product kernels (detected: %s)\n", simdLevelName(detectedSimdLevel()));
+    for (std::size_t n : {std::size_t{1} << 16, std::size_t{1} << 25}) {
+        // Values around 1 so that the plain loop does not stop on an infinity or a zero
+        std::vector<double> values(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            values[i] = i % 2 ? 1.25 : 0.8;
+        }
+        auto const gigabytes = static_cast<double>(n * sizeof(double)) / 1e9;
+        auto const report = [&](const std::string& label, double seconds) {
+            std::printf("  %-40s %8.2f GB/s\n", (label + ", " + std::to_string(n) + " doubles").c_str(), gigabytes / seconds);
+        };
+
+        report("scalar at() loop", timeIt([&] {
+            double result = 1.0;
+            for (std::size_t i = 0; i < values.size(); ++i) {
+                result *= values.at(i);
+            }
+            doNotOptimize(result);
+        }));
+
+        for (auto level : {SimdLevel::Scalar, SimdLevel::AVX2, SimdLevel::AVX512}) {
+            if (level > detectedSimdLevel()) {
+                continue;
+            }
+            report(std::string(simdLevelName(level)) + " scaled", timeIt([&] {
+                ProductAccumulator acc;
+                accumulateProduct(acc, values.data(), values.size(), level);
+                doNotOptimize(acc.value());
+            }));
+        }
+    }
+}
+
+/* Throughput of C requests with one request per getWork against batches of requests. */
+static void benchBatch() {
+    constexpr int REQUESTS = 200000;
+
+    auto const run = [](auto makeEngine, const std::string& label) {
+        auto cm = std::make_shared<ComputationManager>(1024);
+        auto engine = makeEngine(cm);
+        engine->startThread();
+
+        auto const seconds = timeIt([&] {
+            auto producer = std::thread([&] {
+                for (int i = 0; i < REQUESTS; ++i) {
+                    Computation c(ComputationType::C);
+                    c.data->assign({static_cast<double>(i), 3.0});
+                    cm->requestComputation(c);
+                }
+            });
+            for (int i = 0; i < REQUESTS; ++i) {
+                doNotOptimize(cm->getNextResult().getResult());
+            }
+            producer.join();
+        }, 1);
+        std::printf("  %-40s %8.0f requests/s\n", label.c_str(), REQUESTS / seconds);
+
+        cm->stop();
+        engine->join();
+    };
+
+    std::printf("Throughput of C requests\n");
+    run([](auto cm) {return std::make_unique<ComputeEngineC>(cm);}, "ComputeEngineC");
+    run([](auto cm) {return std::make_unique<BatchedComputeEngineC>(cm);}, "BatchedComputeEngineC");
+}
+
+/* Latency of one large A request depending on the number of engines it is sharded across. */
+static void benchSharding() {
+    Computation sum(ComputationType::A);
+    sum.data->assign(50'000'000, 1.0);
+
+    std::printf("Sum of 50M doubles per number of shards (%u hardware threads)\n", std::thread::hardware_concurrency());
+    for (std::size_t engines : {1u, 2u, 4u, 8u}) {
+        auto cm = std::make_shared<ComputationManager>();
+        cm->setShardingPolicy(ComputationType::A, ShardingPolicy{ShardReduction::Sum, engines, 1 << 16});
+        std::vector<std::unique_ptr<ComputeEngineA>> pool;
+        for (std::size_t i = 0; i < engines; ++i) {
+            pool.push_back(std::make_unique<ComputeEngineA>(cm, Granularity::byElements(1 << 16)));
+            pool.back()->startThread();
+        }
+
+        auto const seconds = timeIt([&] {
+            cm->requestComputation(sum);
+            doNotOptimize(cm->getNextResult().getResult());
+        }, 3);
+        std::printf("  %-40s %8.2f ms\n", (std::to_string(engines) + " engines").c_str(), seconds * 1e3);
+
+        cm->stop();
+        for (auto& engine : pool) {
+            engine->join();
+        }
+    }
+}
+
+/* Per step cost of the virtual engine run loop against the CRTP one. The engines run against a manager
+ * without synchronization that hands out a single request, so that only the step loop is measured. */
+class SingleRequestManager : public ComputeEngineInterface
+{
+public:
+    explicit SingleRequestManager(Computation c): computation(std::move(c)) {}
+
+    Request getWork(ComputationType) override {
+        if (served) {
+            throw ComputationManager::StopException();
+        }
+        served = true;
+        return Request(computation, 0);
+    }
+    Request getWork(TypeMask) override {return getWork(ComputationType::A);}
+    std::vector<Request> getWorkBatch(ComputationType type, std::size_t) override {return {getWork(type)};}
+    bool continueWork(int) override {return true;}
+    WorkDirective workDirective(int) override {return WorkDirective::Continue;}
+    void yieldWork(Request) override {}
+    void provideResult(Result result) override {doNotOptimize(result.getResult());}
+    void provideResults(std::vector<Result>) override {}
+
+private:
+    Computation computation;
+    bool served = false;
+};
+
+/* ReductionEngine needs a ComputationManager, this one only overrides what the engine calls per step */
+class UnsynchronizedManager : public ComputationManager
+{
+public:
+    explicit UnsynchronizedManager(Computation c): manager(std::move(c)) {}
+
+    Request getWork(ComputationType type) override {return manager.getWork(type);}
+    bool continueWork(int id) override {return manager.continueWork(id);}
+    WorkDirective workDirective(int id) override {return manager.workDirective(id);}
+    void provideResult(Result result) override {manager.provideResult(result);}
+
+private:
+    SingleRequestManager manager;
+};
+
+static void benchDispatch() {
+    constexpr std::size_t STEPS = 20'000'000;
+    Computation sum(ComputationType::A);
+    sum.data->assign(STEPS, 1.0);
+
+    auto const run = [&](auto makeEngine, const std::string& label) {
+        auto const seconds = timeIt([&] {
+            auto engine = makeEngine();
+            engine->startThread();
+            engine->join();
+        }, 3);
+        std::printf("  %-40s %8.2f ns/step\n", label.c_str(), seconds * 1e9 / STEPS);
+    };
+
+    std::printf("Run loop overhead, one element per step\n");
+    run([&] {
+        return std::make_unique<ComputeEngineA>(std::make_shared<UnsynchronizedManager>(sum), Granularity::byElements(1));
+    }, "virtual ReductionEngine");
+    run([&] {
+        return std::make_unique<StaticReductionEngine<ComputationType::A, SumReduction>>(
+            std::make_shared<SingleRequestManager>(sum), Granularity::byElements(1));
+    }, "CRTP StaticReductionEngine");
+}
+
+/* Throughput of large A reductions depending on the placement of the engines and of the payloads. The
+ * effect only shows on machines with several NUMA nodes, where unplaced payloads are read across nodes. */
+static void benchPlacement() {
+    constexpr int REQUESTS = 16;
+    constexpr std::size_t SIZE = 8'000'000;
+    const std::vector<std::pair<Placement, std::string>> placements = {
+        {Placement{false, false, false}, "no placement"},
+        {Placement{true, false, false}, "pinned"},
+        {Placement{true, true, true}, "pinned, node per type, first touch"},
+    };
+
+    auto const& topology = CpuTopology::system();
+    std::printf("Large A reductions per placement (%zu NUMA nodes, %zu cpus)\n", topology.nodeCount(), topology.cpus().size());
+    for (auto const& [placement, name] : placements) {
+        auto cm = std::make_shared<ComputationManager>(REQUESTS);
+        ComputeEnvironment environment(cm, Granularity::byElements(1 << 16), placement);
+        environment.populateComputeEnvironment();
+        environment.startComputeEnvironment();
+
+        std::vector<Computation> computations;
+        for (int i = 0; i < REQUESTS; ++i) {
+            Computation sum(ComputationType::A);
+            sum.data = environment.allocatePayload(ComputationType::A, SIZE);
+            std::fill(sum.data->begin(), sum.data->end(), 1.0);
+            computations.push_back(sum);
+        }
+
+        auto const seconds = timeIt([&] {
+            for (auto const& c : computations) {
+                cm->requestComputation(c);
+            }
+            for (int i = 0; i < REQUESTS; ++i) {
+                doNotOptimize(cm->getNextResult().getResult());
+            }
+        }, 3);
+        auto const gigabytes = static_cast<double>(REQUESTS * SIZE * sizeof(double)) / 1e9;
+        std::printf("  %-40s %8.2f GB/s\n", name.c_str(), gigabytes / seconds);
+
+        cm->stop();
+        environment.joinComputeEnvironment();
+    }
+}
+
+/* Round trip latency of C requests served by a large pool of engines, each engine having its own thread
+ * or all of them running on fibers over as many worker threads as processors. */
+static void benchFibers() {
+    constexpr int ROUNDS = 20000;
+    constexpr unsigned ENGINES = 256;
+    auto const workers = std::max(1u, std::thread::hardware_concurrency());
+    const std::vector<std::pair<Execution, std::string>> executions = {
+        {Execution{ExecutionMode::Threads}, std::to_string(ENGINES) + " engines on threads"},
+        {Execution{ExecutionMode::Fibers, workers}, std::to_string(ENGINES) + " engines on fibers, " + std::to_string(workers) + " workers"},
+    };
+
+    std::printf("Round trip latency of C requests per execution mode\n");
+    for (auto const& [execution, name] : executions) {
+        auto cm = std::make_shared<ComputationManager>();
+        ComputeEnvironment environment(cm, Granularity{}, Placement{}, execution);
+        environment.addPolymorphicComputeEngines(ENGINES);
+        environment.startComputeEnvironment();
+
+        LatencySamples latencies(ROUNDS);
+        for (int i = 0; i < ROUNDS; ++i) {
+            Computation c(ComputationType::C);
+            *c.data = {1.0, 3.0};
+            auto const start = BenchClock::now();
+            cm->requestComputation(c);
+            doNotOptimize(cm->getNextResult().getResult());
+            latencies.add(BenchClock::now() - start);
+        }
+        latencies.report(name);
+
+        cm->stop();
+        environment.joinComputeEnvironment();
+    }
+}
+
+/* Cost of the payloads of small A requests, allocated on the heap by the client and freed by the engine
+ * or taken from the payload pool and recycled. */
+static void benchPayloads() {
+    constexpr int REQUESTS = 200000;
+    constexpr std::size_t SIZE = 256;
+    const std::vector<std::pair<bool, std::string>> variants = {
+        {false, "make_shared per request"},
+        {true, "PayloadPool"},
+    };
+
+    std::printf("Round trips of %zu element A requests per payload allocation\n", SIZE);
+    for (auto const& [pooled, name] : variants) {
+        auto cm = std::make_shared<ComputationManager>(64);
+        ComputeEngineA engine(cm, Granularity::byElements(SIZE));
+        engine.startThread();
+
+        auto const seconds = timeIt([&, pooled = pooled] {
+            for (int i = 0; i < REQUESTS; i += 32) {
+                for (int j = 0; j < 32; ++j) {
+                    Computation sum(ComputationType::A, pooled ? SIZE : 0);
+                    if (!pooled) {
+                        sum.data = std::make_shared<std::vector<double>>(SIZE);
+                    }
+                    cm->requestComputation(sum);
+                }
+                for (int j = 0; j < 32; ++j) {
+                    doNotOptimize(cm->getNextResult().getResult());
+                }
+            }
+        }, 3);
+        std::printf("  %-40s %8.2f ns/request\n", name.c_str(), seconds * 1e9 / REQUESTS);
+
+        cm->stop();
+        engine.join();
+    }
+}
+
+/* Time from a file of doubles to the sum of its elements, reading the file into the payload or mapping it.
+ * The file is in the page cache, the difference is the copy (and the allocation) of the payload. */
+static void benchMapped() {
+    constexpr std::size_t SIZE = 32'000'000;
+    auto const path = std::string("/tmp/labo6_bench_mapped.bin");
+    {
+        std::vector<double> values(SIZE, 1.0);
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(SIZE * sizeof(double)));
+    }
+
+    std::printf("Sum of a %zu MB file of doubles\n", SIZE * sizeof(double) >> 20);
+    for (auto const mapped : {false, true}) {
+        auto cm = std::make_shared<ComputationManager>();
+        ComputeEngineA engine(cm, Granularity::byElements(1 << 16));
+        engine.startThread();
+
+        auto const seconds = timeIt([&] {
+            if (mapped) {
+                cm->requestComputation(Computation(ComputationType::A, MappedPayload::open(path)));
+            } else {
+                Computation sum(ComputationType::A, SIZE);
+                std::ifstream file(path, std::ios::binary);
+                file.read(reinterpret_cast<char*>(sum.data->data()), static_cast<std::streamsize>(SIZE * sizeof(double)));
+                cm->requestComputation(sum);
+            }
+            doNotOptimize(cm->getNextResult().getResult());
+        }, 5);
+        std::printf("  %-40s %8.2f ms\n", mapped ? "MappedPayload" : "read into the payload", seconds * 1e3);
+
+        cm->stop();
+        engine.join();
+    }
+    std::remove(path.c_str());
+}
+
+/* Latency from the first produced element to the result when the client produces the data in chunks: the
+ * whole payload is produced before the request, or the chunks are appended to a streamed computation. The
+ * production and the reduction only overlap when the client and the engine run on different processors, on a
+ * single one the streamed chunks are still reduced while they are in the cache. */
+static void benchStreaming() {
+    constexpr std::size_t CHUNKS = 256;
+    constexpr std::size_t CHUNK = 1 << 16;
+    auto const produce = [](double* values, std::size_t count, std::size_t seed) {
+        for (std::size_t i = 0; i < count; ++i) {
+            values[i] = std::sqrt(static_cast<double>(seed + i));
+        }
+    };
+
+    std::printf("Sum of %zu chunks of %zu produced elements\n", CHUNKS, CHUNK);
+    for (auto const streamed : {false, true}) {
+        auto cm = std::make_shared<ComputationManager>();
+        ComputeEngineA engine(cm, Granularity::byElements(CHUNK / 4));
+        engine.startThread();
+
+        auto const seconds = timeIt([&] {
+            if (streamed) {
+                auto const stream = cm->openComputation(ComputationType::A, 4 * CHUNK);
+                for (std::size_t c = 0; c < CHUNKS; ++c) {
+                    std::vector<double> chunk(CHUNK);
+                    produce(chunk.data(), CHUNK, c * CHUNK);
+                    stream->append(std::move(chunk));
+                }
+                stream->close();
+            } else {
+                Computation sum(ComputationType::A, CHUNKS * CHUNK);
+                for (std::size_t c = 0; c < CHUNKS; ++c) {
+                    produce(sum.data->data() + c * CHUNK, CHUNK, c * CHUNK);
+                }
+                cm->requestComputation(sum);
+            }
+            doNotOptimize(cm->getNextResult().getResult());
+        }, 5);
+        std::printf("  %-40s %8.2f ms\n", streamed ? "openComputation" : "requestComputation", seconds * 1e3);
+
+        cm->stop();
+        engine.join();
+    }
+}
+
+/* Sum of a large A computation depending on the type of its elements, the reduction is bound by the memory
+ * bandwidth once the payload does not fit in the caches. */
+static void benchElementTypes() {
+    constexpr std::size_t SIZE = 32'000'000;
+    auto cm = std::make_shared<ComputationManager>();
+    ComputeEngineA engine(cm, Granularity::byElements(1 << 16));
+    engine.startThread();
+
+    auto const run = [&cm](const char* name, const Computation& c, std::size_t elementSize) {
+        auto const seconds = timeIt([&] {
+            cm->requestComputation(c);
+            doNotOptimize(cm->getNextResult().getResult());
+        }, 5);
+        std::printf("  %-40s %8.2f ms %8.2f GB/s\n", name, seconds * 1e3, static_cast<double>(SIZE * elementSize) / seconds * 1e-9);
+    };
+
+    std::printf("Sum of %zu elements per element type\n", SIZE);
+    Computation doubles(ComputationType::A, SIZE);
+    std::fill(doubles.data->begin(), doubles.data->end(), 1.0);
+    run("double", doubles, sizeof(double));
+    run("float", Computation(ComputationType::A, std::vector<float>(SIZE, 1.0f)), sizeof(float));
+    run("int32 (exact)", Computation(ComputationType::A, std::vector<std::int32_t>(SIZE, 1)), sizeof(std::int32_t));
+    run("int64 (exact)", Computation(ComputationType::A, std::vector<std::int64_t>(SIZE, 1)), sizeof(std::int64_t));
+
+    cm->stop();
+    engine.join();
+}
+
+/* Round trips of small A requests spread over many engines, copying the computation into the manager or moving
+ * it. A copy keeps a reference in the client, every engine then releases a payload whose count is shared with
+ * the client thread, the moved payload only ever has one owner. */
+static void benchHandoff() {
+    constexpr int REQUESTS = 200000;
+    constexpr int ENGINES = 16;
+    constexpr int BURST = 64;
+    constexpr std::size_t SIZE = 16;
+
+    std::printf("Round trips of %zu element A requests with %d engines\n", SIZE, ENGINES);
+    for (auto const moved : {false, true}) {
+        auto cm = std::make_shared<ComputationManager>(BURST);
+        std::vector<std::unique_ptr<ComputeEngineA>> engines;
+        for (int i = 0; i < ENGINES; ++i) {
+            engines.push_back(std::make_unique<ComputeEngineA>(cm, Granularity::byElements(SIZE)));
+            engines.back()->startThread();
+        }
+
+        auto const seconds = timeIt([&] {
+            for (int i = 0; i < REQUESTS; i += BURST) {
+                for (int j = 0; j < BURST; ++j) {
+                    Computation c(ComputationType::A, SIZE);
+                    if (moved) {
+                        cm->requestComputation(std::move(c));
+                    } else {
+                        cm->requestComputation(c);
+                    }
+                }
+                for (int j = 0; j < BURST; ++j) {
+                    doNotOptimize(cm->getNextResult().getResult());
+                }
+            }
+        }, 3);
+        std::printf("  %-40s %8.2f ns/request\n", moved ? "std::move into requestComputation" : "copy into requestComputation",
+                    seconds * 1e9 / REQUESTS);
+
+        cm->stop();
+        for (auto& engine : engines) {
+            engine->join();
+        }
+    }
+}
+
+/* Throughput of C requests whose two operands are written into a pooled payload or stored inline. */
+static void benchInline() {
+    constexpr int REQUESTS = 200000;
+    constexpr int BURST = 500;
+
+    std::printf("Throughput of C requests per operand storage\n");
+    for (auto const inlined : {false, true}) {
+        auto cm = std::make_shared<ComputationManager>(1024);
+        BatchedComputeEngineC engine(cm);
+        engine.startThread();
+
+        auto const seconds = timeIt([&] {
+            for (int i = 0; i < REQUESTS; i += BURST) {
+                for (int j = i; j < i + BURST; ++j) {
+                    if (inlined) {
+                        cm->requestComputation(Computation(ComputationType::C, {static_cast<double>(j), 3.0}));
+                    } else {
+                        Computation c(ComputationType::C);
+                        c.data->assign({static_cast<double>(j), 3.0});
+                        cm->requestComputation(std::move(c));
+                    }
+                }
+                for (int j = 0; j < BURST; ++j) {
+                    doNotOptimize(cm->getNextResult().getResult());
+                }
+            }
+        }, 3);
+        std::printf("  %-40s %8.0f requests/s\n", inlined ? "inline operands" : "pooled payload", REQUESTS / seconds);
+
+        cm->stop();
+        engine.join();
+    }
+}
+
+/* Time for the engines to get rid of their results when the client writes them to a slow output (a fixed cost
+ * per write, like a flushed log line), writing each result itself or through a ResultSink which batches them.
+ * The drain time is when the last result left the manager, the engines are then free. */
+static void benchResultSink() {
+    constexpr int REQUESTS = 20000;
+    constexpr auto WRITE_COST = std::chrono::microseconds(50);
+
+    auto const slowWrite = [WRITE_COST](const Result*, std::size_t) {std::this_thread::sleep_for(WRITE_COST);};
+    std::printf("Results of %d C requests written to an output costing %lld us per write\n", REQUESTS,
+                static_cast<long long>(WRITE_COST.count()));
+    for (auto const sunk : {false, true}) {
+        auto cm = std::make_shared<ComputationManager>(64);
+        BatchedComputeEngineC engine(cm);
+        engine.startThread();
+        std::atomic<int> drained{0};
+        auto const counted = [&](const Result* results, std::size_t count) {
+            slowWrite(results, count);
+            drained += static_cast<int>(count);
+        };
+        auto sink = std::make_unique<ResultSink>(cm, counted);
+
+        auto const start = BenchClock::now();
+        BenchClock::time_point drainedAt;
+        auto producer = std::thread([&] {
+            for (int i = 0; i < REQUESTS; ++i) {
+                cm->requestComputation(Computation(ComputationType::C, {static_cast<double>(i), 3.0}));
+            }
+        });
+        if (sunk) {
+            sink->startThread();
+            while (sink->getStats().written + sink->getStats().buffered < REQUESTS) {
+                std::this_thread::yield();
+            }
+            drainedAt = BenchClock::now();
+            while (drained < REQUESTS) {
+                std::this_thread::yield();
+            }
+        } else {
+            for (int i = 0; i < REQUESTS; ++i) {
+                auto const result = cm->getNextResult();
+                slowWrite(&result, 1);
+            }
+            drainedAt = BenchClock::now();
+        }
+        auto const end = BenchClock::now();
+        producer.join();
+
+        std::printf("  %-40s drained %8.1f ms   written %8.1f ms\n", sunk ? "ResultSink (batches)" : "getNextResult() and write",
+                    std::chrono::duration<double, std::milli>(drainedAt - start).count(),
+                    std::chrono::duration<double, std::milli>(end - start).count());
+
+        cm->stop();
+        engine.join();
+        sink->join();
+    }
+}
+
+/* Jobs made of a sum and a product over the same data, then the ratio of both, driven by the client (which
+ * waits for both results before it requests the ratio) or submitted at once as a graph. Each job is done
+ * before the next one starts. */
+static void benchDependencies() {
+    constexpr int JOBS = 20000;
+    constexpr std::size_t SIZE = 64;
+
+    std::printf("Sum / product jobs over %zu elements\n", SIZE);
+    for (auto const graph : {false, true}) {
+        auto cm = std::make_shared<ComputationManager>(64);
+        ComputeEngineA a(cm);
+        ComputeEngineB b(cm);
+        ComputeEngineC c(cm);
+        a.startThread();
+        b.startThread();
+        c.startThread();
+
+        auto const seconds = timeIt([&] {
+            for (int job = 0; job < JOBS; ++job) {
+                Computation sum(ComputationType::A, SIZE);
+                std::fill(sum.data->begin(), sum.data->end(), 1.0);
+                Computation product(ComputationType::B, SIZE);
+                std::fill(product.data->begin(), product.data->end(), 1.0);
+                if (graph) {
+                    std::vector<Computation> nodes;
+                    nodes.push_back(std::move(sum));
+                    nodes.push_back(std::move(product));
+                    nodes.emplace_back(ComputationType::C);
+                    nodes.back().inputs.assign({0, 1});
+                    cm->requestGraph(std::move(nodes));
+                    doNotOptimize(cm->getNextResult().getResult());
+                    doNotOptimize(cm->getNextResult().getResult());
+                } else {
+                    cm->requestComputation(std::move(sum));
+                    cm->requestComputation(std::move(product));
+                    auto const s = cm->getNextResult().getResult();
+                    auto const p = cm->getNextResult().getResult();
+                    cm->requestComputation(Computation(ComputationType::C, {s, p}));
+                }
+                doNotOptimize(cm->getNextResult().getResult());
+            }
+        }, 3);
+        std::printf("  %-40s %8.0f jobs/s\n", graph ? "requestGraph()" : "client in the loop", JOBS / seconds);
+
+        cm->stop();
+        a.join();
+        b.join();
+        c.join();
+    }
+}
+
+/* Sum of squares of many doubles, squared by the client into a new payload then summed, or summed by the engine
+ * with an element map which squares each block right before the sum kernel. */
+static void benchElementMap() {
+    constexpr std::size_t SIZE = 32'000'000;
+    auto cm = std::make_shared<ComputationManager>();
+    ComputeEngineA engine(cm, Granularity::byElements(1 << 16));
+    engine.startThread();
+
+    Computation source(ComputationType::A, SIZE);
+    std::iota(source.data->begin(), source.data->end(), 0.0);
+
+    std::printf("Sum of squares of %zu doubles\n", SIZE);
+    for (auto const fused : {false, true}) {
+        auto const seconds = timeIt([&] {
+            if (fused) {
+                // Shares the payload of the source, nothing is copied
+                auto c = source;
+                c.map = ElementMap().square();
+                cm->requestComputation(std::move(c));
+            } else {
+                Computation c(ComputationType::A, SIZE);
+                std::transform(source.data->begin(), source.data->end(), c.data->begin(), [](double x) {return x * x;});
+                cm->requestComputation(std::move(c));
+            }
+            doNotOptimize(cm->getNextResult().getResult());
+        }, 5);
+        std::printf("  %-40s %8.2f ms\n", fused ? "element map" : "squared by the client", seconds * 1e3);
+    }
+
+    cm->stop();
+    engine.join();
+}
+
+/* Sum, product, min, max and count of many doubles, one D request per aggregate or one D request for all of
+ * them. The payload is much larger than the caches, each request reads it from memory. */
+static void benchAggregates() {
+    constexpr std::size_t SIZE = 32'000'000;
+    auto cm = std::make_shared<ComputationManager>();
+    ComputeEngineD engine(cm, Granularity::byElements(1 << 16));
+    engine.startThread();
+
+    Computation source(ComputationType::D, SIZE);
+    std::fill(source.data->begin(), source.data->end(), 1.0);
+    const std::vector<AggregateSet> separate = {Aggregate::Sum, Aggregate::Product, Aggregate::Min, Aggregate::Max,
+                                                Aggregate::Count};
+
+    std::printf("Five aggregates of %zu doubles\n", SIZE);
+    for (auto const together : {false, true}) {
+        auto const seconds = timeIt([&] {
+            auto const requests = together ? std::vector<AggregateSet>{AggregateSet::all()} : separate;
+            for (auto const aggregates : requests) {
+                auto c = source;
+                c.aggregates = aggregates;
+                cm->requestComputation(std::move(c));
+            }
+            for (std::size_t i = 0; i < requests.size(); ++i) {
+                doNotOptimize(cm->getNextResult().getResult());
+            }
+        }, 5);
+        std::printf("  %-40s %8.2f ms\n", together ? "one request" : "one request per aggregate", seconds * 1e3);
+    }
+
+    cm->stop();
+    engine.join();
+}
+
+int main(int argc, char **argv) {
+    const std::map<std::string, std::function<void()>> benchmarks = {
+        {"waitstrategy", benchWaitStrategy},
+        {"granularity", benchGranularity},
+        {"sum", benchSum},
+        {"product", benchProduct},
+        {"batch", benchBatch},
+        {"sharding", benchSharding},
+        {"dispatch", benchDispatch},
+        {"placement", benchPlacement},
+        {"fibers", benchFibers},
+        {"payloads", benchPayloads},
+        {"mapped", benchMapped},
+        {"streaming", benchStreaming},
+        {"elements", benchElementTypes},
+        {"handoff", benchHandoff},
+        {"inline", benchInline},
+        {"resultsink", benchResultSink},
+        {"dependencies", benchDependencies},
+        {"elementmap", benchElementMap},
+        {"aggregates", benchAggregates},
+    };
+
+    // Without arguments every benchmark is run, otherwise only the ones given by name
+    if (argc < 2) {
+        for (auto const& [name, bench] : benchmarks) {
+            bench();
+        }
+        return 0;
+    }
+    for (int i = 1; i < argc; ++i) {
+        auto const it = benchmarks.find(argv[i]);
+        if (it == benchmarks.end()) {
+            std::fprintf(stderr, "Unknown benchmark %s\n", argv[i]);
+            return 1;
+        }
+        it->second();
+    }
+    return 0;
+}
@@ -9,12 +9,12 @@ ComputeEngineGUI::ComputeEngineGUI(std::unique_ptr<ComputeEngineCommon> ce) : Ab
     GuiInterface::instance->registerComputeEngine(guiId, myName.c_str());
 }
 
-void ComputeEngineGUI::startComputation(const Request& r) {
+void ComputeEngineGUI::startComputation(Request r) {
     //qDebug() << guiId << "GUI start comp";
     auto t = GuiInterface::instance->getCurrentTime();
     //qDebug() << "time :" << t;
     GuiInterface::instance->addTaskStart(guiId, t);
-    computeEngine->startComputation(r);
+    computeEngine->startComputation(std::move(r));
     lastTime = t;
     started = true;
 }
@@ -14,11 +14,14 @@ protected:
 
     // Compute Engine Specific Functions
     ComputationType myType() const override {return computeEngine->myType();}
-    void startComputation(const Request& r) override;
+    void startComputation(Request r) override;
     void advanceComputation() override;
     bool isComputationDone() const override {return computeEngine->isComputationDone();}
     double getResult() const override {return computeEngine->result;}
-    int getCurrentRequestId() const override {return computeEngine->currentRequest.getId();}
+    ResultStatus getResultStatus() const override {return computeEngine->resultStatus;}
+    int getCurrentRequestId() const override {return computeEngine->getCurrentRequestId();}
+    Result makeResult() const override {return computeEngine->makeResult();}
+    Request saveComputation() const override {return computeEngine->saveComputation();}
     void stopComputation() override;
 
     // Behavior function
@@ -35,6 +38,7 @@ private:
         case ComputationType::A : return std::string("A");
         case ComputationType::B : return std::string("B");
         case ComputationType::C : return std::string("C");
+        case ComputationType::D : return std::string("D");
         default: return std::string("?");
         }
     }
@@ -9,21 +9,17 @@ class ComputeEnvironmentGui : public ComputeEnvironment
 public:
     ComputeEnvironmentGui(std::shared_ptr<ComputationManager> computationManager): ComputeEnvironment(computationManager) {}
 
+    /**
+     * @brief Engines The compute engines displayed for each computation type
+     */
+    using Engines = EngineList<ComputeEngineA, ComputeEngineB, ComputeEngineC, ComputeEngineD>;
+
     void addComputeEngine(ComputationType type, unsigned int quantity = 1) override {
         for (unsigned i = 0; i < quantity; ++i) {
-            switch(type) {
-            case ComputationType::A :
-                threads.push_back(std::make_shared<ComputeEngineGUI>(std::make_unique<ComputeEngineA>(computationManager)));
-                break;
-            case ComputationType::B :
-                 threads.push_back(std::make_shared<ComputeEngineGUI>(std::make_unique<ComputeEngineB>(computationManager)));
-                break;
-            case ComputationType::C :
-                 threads.push_back(std::make_shared<ComputeEngineGUI>(std::make_unique<ComputeEngineC>(computationManager)));
-                break;
-            default:
-                break;
-            }
+            Engines::forType(type, [this](auto tag) {
+                using Engine = typename decltype(tag)::type;
+                threads.push_back(std::make_shared<ComputeEngineGUI>(std::make_unique<Engine>(computationManager)));
+            });
         }
     }
 };
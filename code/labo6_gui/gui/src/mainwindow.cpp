@@ -157,6 +157,7 @@ std::string nameFromType(ComputationType ct) {
     case ComputationType::A : return std::string("A");
     case ComputationType::B : return std::string("B");
     case ComputationType::C : return std::string("C");
+    case ComputationType::D : return std::string("D");
     default: return std::string("?");
     }
 }
@@ -1,9 +1,28 @@
 
 #include <gtest/gtest.h>
 
+#include <any>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <sstream>
+#include <thread>
+
+#include <sched.h>
+
 #include "pcotest.h"
 
+#include "autoscaler.h"
+#include "batchfile.h"
 #include "computationmanager.h"
+#include "computeenvironment.h"
+#include "fiber.h"
+#include "kernels.h"
+#include "mappedpayload.h"
+#include "payloadpool.h"
+#include "placement.h"
+#include "resultsink.h"
 #include "testcomputengine.h"
 
 TEST(Pass, AlwaysPass) {
@@ -313,6 +332,2043 @@ TEST(Etape4, ResultsShouldArriveInOrderAndBufferMustStop) {
     })
 }
 
+TEST(SpinThenPark, ComputeEngineShouldStillWait) {
+    ASSERT_DURATION_GE(1, {
+        ComputationManager cm(2, WaitStrategy::SpinThenPark);
+        cm.getWork(ComputationType::A);
+    })
+}
+
+TEST(SpinThenPark, AResultShouldArrive) {
+    ASSERT_DURATION_LE(1, {
+        ComputationManager cm(2, WaitStrategy::SpinThenPark);
+        auto id = cm.requestComputation(Computation(ComputationType::C));
+        auto req = cm.getWork(ComputationType::C);
+        ASSERT_EQ(id, req.getId());
+        cm.provideResult(Result(id, 1.5));
+        auto res = cm.getNextResult();
+        ASSERT_EQ(id, res.getId());
+        ASSERT_EQ(1.5, res.getResult());
+    })
+}
+
+TEST(SpinThenPark, SpinningThreadsShouldBeReleasedOnStop) {
+    ASSERT_DURATION_LE(1, {
+        auto cm = std::make_shared<ComputationManager>(2, WaitStrategy::SpinThenPark);
+
+        auto engine = std::thread([=](){
+            try {
+                cm->getWork(ComputationType::C);
+                ASSERT_TRUE(false) << "getWork() should have thrown exception";
+            } catch (ComputationManager::StopException& e) {
+            }
+        });
+        auto client = std::thread([=](){
+            try {
+                cm->getNextResult();
+                ASSERT_TRUE(false) << "getNextResult() should have thrown exception";
+            } catch (ComputationManager::StopException& e) {
+            }
+        });
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        cm->stop();
+
+        engine.join();
+        client.join();
+    })
+}
+
+TEST(SpinThenPark, ResultsShouldArriveInOrder) {
+    ASSERT_DURATION_LE(2, {
+        auto cm = std::make_shared<ComputationManager>(10, WaitStrategy::SpinThenPark);
+
+        std::vector<TestComputeEngine> tce;
+        tce.push_back(TestComputeEngine(cm, ComputationType::A, 2, 1));
+        tce.push_back(TestComputeEngine(cm, ComputationType::C, 0, 0));
+
+        for (auto& t : tce) {
+            t.startThread();
+        }
+
+        for (int i = 0; i < 10; ++i) {
+            cm->requestComputation(Computation(ComputationType::A));
+            cm->requestComputation(Computation(ComputationType::C));
+        }
+        auto oldResult = cm->getNextResult();
+        for (int i = 0; i < 20-1; ++i) {
+            auto newResult = cm->getNextResult();
+            ASSERT_LT(oldResult.getId(), newResult.getId()) << "The results should arrive in order";
+            oldResult = newResult;
+        }
+
+        cm->stop();
+        for (auto& t : tce) {
+            t.join();
+        }
+    })
+}
+
+/* Chunked engines must compute the same results as the element by element ones */
+TEST(Granularity, ChunkedEnginesShouldComputeCorrectResults) {
+    ASSERT_DURATION_LE(1, {
+        auto cm = std::make_shared<ComputationManager>();
+
+        ComputeEngineA byCount(cm, Granularity::byElements(64));
+        ComputeEngineB byTime(cm, Granularity::byTime(std::chrono::microseconds(10)));
+        byCount.startThread();
+        byTime.startThread();
+
+        Computation sum(ComputationType::A);
+        sum.data->resize(1000);
+        std::iota(sum.data->begin(), sum.data->end(), 1.0);
+        Computation mult(ComputationType::B);
+        mult.data->assign(10, 2.0);
+        Computation empty(ComputationType::A);
+
+        cm->requestComputation(sum);
+        cm->requestComputation(mult);
+        cm->requestComputation(empty);
+        ASSERT_EQ(500500.0, cm->getNextResult().getResult());
+        ASSERT_EQ(1024.0, cm->getNextResult().getResult());
+        ASSERT_EQ(0.0, cm->getNextResult().getResult());
+
+        cm->stop();
+        byCount.join();
+        byTime.join();
+    })
+}
+
+/* The number of steps (and thus of workDirective round trips) follows the chunk size */
+TEST(Granularity, StepsShouldProcessWholeChunks) {
+    class StepCountingEngine : public ComputeEngineA
+    {
+    public:
+        StepCountingEngine(std::shared_ptr<ComputationManager> cm, Granularity g): AbstractComputeEngine(cm, 0), ComputeEngineA(cm, g) {}
+        std::atomic<int> steps = 0;
+    protected:
+        void advanceComputation() override {++steps; ComputeEngineA::advanceComputation();}
+    };
+
+    ASSERT_DURATION_LE(1, {
+        auto cm = std::make_shared<ComputationManager>();
+
+        StepCountingEngine engine(cm, Granularity::byElements(100));
+        engine.startThread();
+
+        Computation sum(ComputationType::A);
+        sum.data->assign(1000, 1.0);
+        cm->requestComputation(sum);
+        ASSERT_EQ(1000.0, cm->getNextResult().getResult());
+        ASSERT_EQ(10, engine.steps);
+
+        cm->stop();
+        engine.join();
+    })
+}
+
+/* Every instruction set must give the same sums, including for the tails that do not fill a vector */
+TEST(Kernels, SumShouldMatchOnEverySimdLevel) {
+    const std::vector<std::size_t> sizes = {0, 1, 3, 7, 17, 33, 1000, 4099};
+    for (auto n : sizes) {
+        std::vector<double> values(n);
+        std::iota(values.begin(), values.end(), 1.0);
+        auto const expected = static_cast<double>(n * (n + 1) / 2);
+
+        for (auto level : {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512}) {
+            for (auto mode : {SummationMode::Fast, SummationMode::Compensated, SummationMode::Pairwise}) {
+                SumAccumulator acc;
+                accumulateSum(acc, values.data(), n, mode, level);
+                ASSERT_EQ(expected, acc.value()) << "n = " << n << ", level = " << simdLevelName(level);
+            }
+        }
+    }
+}
+
+/* The compensated sum must recover the small terms a plain sum loses */
+TEST(Kernels, CompensatedSumShouldBeAccurate) {
+    std::vector<double> values;
+    for (int i = 0; i < 1000; ++i) {
+        values.insert(values.end(), {1e16, 1.0, -1e16});
+    }
+
+    for (auto level : {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512}) {
+        SumAccumulator acc;
+        // Split in uneven chunks as the engines do
+        accumulateSum(acc, values.data(), 1001, SummationMode::Compensated, level);
+        accumulateSum(acc, values.data() + 1001, values.size() - 1001, SummationMode::Compensated, level);
+        ASSERT_EQ(1000.0, acc.value()) << "level = " << simdLevelName(level);
+    }
+}
+
+/* Long products that leave the range of a double midway must still give the right result */
+TEST(Kernels, ProductShouldNotOverflowMidway) {
+    std::vector<double> values;
+    for (int i = 0; i < 1000; ++i) {
+        values.push_back(1e200);
+    }
+    for (int i = 0; i < 1000; ++i) {
+        values.push_back(1e-200);
+    }
+    values.push_back(-3.0);
+
+    for (auto level : {SimdLevel::Scalar, SimdLevel::AVX2, SimdLevel::AVX512}) {
+        ProductAccumulator acc;
+        accumulateProduct(acc, values.data(), values.size(), level);
+        ASSERT_NEAR(-3.0, acc.value(), 1e-9) << "level = " << simdLevelName(level);
+        ASSERT_FALSE(acc.overflows());
+        ASSERT_FALSE(acc.underflows());
+    }
+}
+
+/* Every instruction set must give the same products, including for subnormal values and tails */
+TEST(Kernels, ProductShouldMatchOnEverySimdLevel) {
+    std::vector<double> values;
+    for (int i = 0; i < 3000; ++i) {
+        values.push_back(i % 2 ? 1.5 : -0.75);
+    }
+    values[1234] = 0x1p-1060;
+    values[2345] = 0x1p+1000;
+
+    for (auto level : {SimdLevel::Scalar, SimdLevel::AVX2, SimdLevel::AVX512}) {
+        ProductAccumulator acc;
+        accumulateProduct(acc, values.data(), values.size(), level);
+        // 1499 pairs (-0.75 * 1.5 = -1.125) are left, times 2^-1060 * 2^1000
+        auto const expected = -std::pow(1.125, 1499) * 0x1p-60;
+        ASSERT_NEAR(1.0, acc.value() / expected, 1e-12) << "level = " << simdLevelName(level);
+    }
+}
+
+TEST(Kernels, ProductShouldReportOutOfRangeResults) {
+    std::vector<double> huge(2000, 1e300);
+    std::vector<double> tiny(2000, 1e-300);
+
+    for (auto level : {SimdLevel::Scalar, SimdLevel::AVX2, SimdLevel::AVX512}) {
+        ProductAccumulator big;
+        accumulateProduct(big, huge.data(), huge.size(), level);
+        ASSERT_TRUE(std::isinf(big.value()));
+        ASSERT_TRUE(big.overflows());
+
+        ProductAccumulator small;
+        accumulateProduct(small, tiny.data(), tiny.size(), level);
+        ASSERT_EQ(0.0, small.value());
+        ASSERT_TRUE(small.underflows());
+    }
+}
+
+TEST(Kernels, ProductShouldHandleZeroAndNaN) {
+    std::vector<double> values(5000, 1e300);
+    values[4000] = std::numeric_limits<double>::infinity();
+
+    for (auto level : {SimdLevel::Scalar, SimdLevel::AVX2, SimdLevel::AVX512}) {
+        auto withZero = values;
+        withZero[777] = 0.0;
+        ProductAccumulator zero;
+        accumulateProduct(zero, withZero.data(), 1000, level);
+        ASSERT_FALSE(zero.isFinal()) << "An infinity after the zero still changes the product";
+        ASSERT_EQ(0.0, zero.value());
+        ASSERT_FALSE(zero.underflows());
+        accumulateProduct(zero, withZero.data() + 1000, withZero.size() - 1000, level);
+        ASSERT_TRUE(std::isnan(zero.value())) << "The infinity found after the zero should give NaN";
+
+        auto withNaN = values;
+        withNaN[3000] = std::numeric_limits<double>::quiet_NaN();
+        ProductAccumulator nan;
+        accumulateProduct(nan, withNaN.data(), withNaN.size(), level);
+        ASSERT_TRUE(std::isnan(nan.value()));
+
+        ProductAccumulator infinite;
+        accumulateProduct(infinite, values.data(), values.size(), level);
+        ASSERT_TRUE(std::isinf(infinite.value()));
+        ASSERT_FALSE(infinite.overflows()) << "A true infinity is not an overflow";
+    }
+}
+
+/* 0 * inf is NaN whatever the order of the zero and the infinity, also across blocks and shards */
+TEST(Kernels, ProductOfZeroAndInfinityShouldNotDependOnTheOrder) {
+    auto const inf = std::numeric_limits<double>::infinity();
+    std::vector<double> zeroFirst(3000, 1.5);
+    zeroFirst[100] = 0.0;
+    zeroFirst[2900] = -inf;
+    std::vector<double> infinityFirst(zeroFirst.rbegin(), zeroFirst.rend());
+
+    for (auto level : {SimdLevel::Scalar, SimdLevel::AVX2, SimdLevel::AVX512}) {
+        for (auto const* values : {&zeroFirst, &infinityFirst}) {
+            ProductAccumulator acc;
+            accumulateProduct(acc, values->data(), values->size(), level);
+            ASSERT_TRUE(std::isnan(acc.value())) << "level = " << simdLevelName(level);
+        }
+
+        ProductAccumulator pair;
+        double const zeroThenInfinity[2] = {0.0, inf};
+        accumulateProduct(pair, zeroThenInfinity, 2, level);
+        ASSERT_TRUE(std::isnan(pair.value()));
+
+        ProductAccumulator zeroOnly;
+        accumulateProduct(zeroOnly, zeroFirst.data(), 2000, level);
+        ASSERT_EQ(0.0, zeroOnly.value());
+        ASSERT_FALSE(zeroOnly.underflows());
+    }
+
+    ASSERT_DURATION_LE(1, {
+        auto cm = std::make_shared<ComputationManager>();
+        cm->setShardingPolicy(ComputationType::B, ShardingPolicy{ShardReduction::Product, 4, 500});
+        ComputeEngineB engine1(cm, Granularity::byElements(100));
+        ComputeEngineB engine2(cm, Granularity::byElements(100));
+        engine1.startThread();
+        engine2.startThread();
+
+        for (auto const* values : {&zeroFirst, &infinityFirst}) {
+            Computation c(ComputationType::B);
+            *c.data = *values;
+            cm->requestComputation(c);
+            ASSERT_TRUE(std::isnan(cm->getNextResult().getResult()));
+        }
+
+        cm->stop();
+        engine1.join();
+        engine2.join();
+    })
+}
+
+/* The engine reports when the true product is outside of the range of a double */
+TEST(Kernels, EngineBShouldReportOverflow) {
+    ASSERT_DURATION_LE(1, {
+        auto cm = std::make_shared<ComputationManager>();
+        ComputeEngineB engine(cm, Granularity::byElements(1000));
+        engine.startThread();
+
+        Computation big(ComputationType::B);
+        big.data->assign(10000, 1e100);
+        Computation fine(ComputationType::B);
+        fine.data->assign(5000, 1e100);
+        fine.data->resize(10000, 1e-100);
+
+        cm->requestComputation(big);
+        cm->requestComputation(fine);
+        auto const overflow = cm->getNextResult();
+        ASSERT_EQ(ResultStatus::Overflow, overflow.getStatus());
+        ASSERT_TRUE(std::isinf(overflow.getResult()));
+        auto const ok = cm->getNextResult();
+        ASSERT_EQ(ResultStatus::Ok, ok.getStatus());
+        ASSERT_NEAR(1.0, ok.getResult(), 1e-9);
+
+        cm->stop();
+        engine.join();
+    })
+}
+
+TEST(Batch, WorkBatchShouldWait) {
+    ASSERT_DURATION_GE(1, {
+        ComputationManager cm(2);
+        cm.getWorkBatch(ComputationType::C, 10);
+    })
+}
+
+TEST(Batch, WorkBatchShouldTakeRequestsInOrder) {
+    ASSERT_DURATION_LE(1, {
+        ComputationManager cm(4);
+        std::vector<int> ids;
+        for (int i = 0; i < 4; ++i) {
+            ids.push_back(cm.requestComputation(Computation(ComputationType::C)));
+        }
+        auto first = cm.getWorkBatch(ComputationType::C, 3);
+        ASSERT_EQ(3u, first.size());
+        auto second = cm.getWorkBatch(ComputationType::C, 3);
+        ASSERT_EQ(1u, second.size());
+        ASSERT_EQ(ids[0], first[0].getId());
+        ASSERT_EQ(ids[2], first[2].getId());
+        ASSERT_EQ(ids[3], second[0].getId());
+
+        cm.provideResults({Result(ids[3], 3.0), Result(ids[1], 1.0), Result(ids[0], 0.0), Result(ids[2], 2.0)});
+        for (std::size_t i = 0; i < 4; ++i) {
+            auto res = cm.getNextResult();
+            ASSERT_EQ(ids[i], res.getId());
+            ASSERT_EQ(i, res.getResult());
+        }
+    })
+}
+
+/* A batch frees several slots of a full queue, every blocked client must get through */
+TEST(Batch, WorkBatchShouldReleaseClientsWaitingOnFullQueue) {
+    ASSERT_DURATION_LE(1, {
+        ComputationManager cm(2);
+        cm.requestComputation(Computation(ComputationType::C));
+        cm.requestComputation(Computation(ComputationType::C));
+        auto t1 = std::thread([&](){cm.requestComputation(Computation(ComputationType::C));});
+        auto t2 = std::thread([&](){cm.requestComputation(Computation(ComputationType::C));});
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        ASSERT_EQ(2u, cm.getWorkBatch(ComputationType::C, 10).size());
+        t1.join();
+        t2.join();
+        ASSERT_EQ(2u, cm.getWorkBatch(ComputationType::C, 10).size());
+    })
+}
+
+TEST(Batch, BatchedEngineShouldDivideAndFlagInvalidOperands) {
+    ASSERT_DURATION_LE(1, {
+        auto cm = std::make_shared<ComputationManager>(100);
+        BatchedComputeEngineC engine(cm, 16);
+
+        for (int i = 0; i < 50; ++i) {
+            Computation div(ComputationType::C);
+            if (i % 10 == 3) {
+                div.data->push_back(1.0);
+            } else {
+                div.data->push_back(i);
+                div.data->push_back(4.0);
+            }
+            cm->requestComputation(div);
+        }
+        engine.startThread();
+
+        for (int i = 0; i < 50; ++i) {
+            auto res = cm->getNextResult();
+            if (i % 10 == 3) {
+                ASSERT_EQ(ResultStatus::InvalidOperands, res.getStatus());
+                ASSERT_TRUE(std::isnan(res.getResult()));
+            } else {
+                ASSERT_EQ(ResultStatus::Ok, res.getStatus());
+                ASSERT_EQ(i / 4.0, res.getResult());
+            }
+        }
+
+        cm->stop();
+        engine.join();
+    })
+}
+
+TEST(Batch, EngineCShouldFlagInvalidOperands) {
+    ASSERT_DURATION_LE(1, {
+        auto cm = std::make_shared<ComputationManager>();
+        ComputeEngineC engine(cm);
+        engine.startThread();
+
+        Computation div(ComputationType::C);
+        div.data->assign(3, 1.0);
+        cm->requestComputation(div);
+        auto res = cm->getNextResult();
+        ASSERT_EQ(ResultStatus::InvalidOperands, res.getStatus());
+        ASSERT_TRUE(std::isnan(res.getResult()));
+
+        cm->stop();
+        engine.join();
+    })
+}
+
+TEST(Sharding, ShardedComputationsShouldGiveOneResultPerRequest) {
+    ASSERT_DURATION_LE(2, {
+        auto cm = std::make_shared<ComputationManager>();
+        cm->setShardingPolicy(ComputationType::A, ShardingPolicy{ShardReduction::Sum, 4, 1000});
+        ComputeEngineA a1(cm, Granularity::byElements(256));
+        ComputeEngineA a2(cm, Granularity::byElements(256));
+        ComputeEngineA a3(cm, Granularity::byElements(256));
+        a1.startThread();
+        a2.startThread();
+        a3.startThread();
+
+        Computation small(ComputationType::A);
+        small.data->assign(1500, 1.0);
+        Computation large(ComputationType::A);
+        large.data->resize(10001);
+        std::iota(large.data->begin(), large.data->end(), 0.0);
+
+        auto const smallId = cm->requestComputation(small);
+        auto const largeId = cm->requestComputation(large);
+        auto res = cm->getNextResult();
+        ASSERT_EQ(smallId, res.getId());
+        ASSERT_EQ(1500.0, res.getResult());
+        res = cm->getNextResult();
+        ASSERT_EQ(largeId, res.getId());
+        ASSERT_EQ(10000.0 * 10001.0 / 2.0, res.getResult());
+
+        cm->stop();
+        a1.join();
+        a2.join();
+        a3.join();
+    })
+}
+
+/* The shards of the product overflow and underflow on their own, the combined product is in range */
+TEST(Sharding, ShardedProductShouldCombineOutOfRangePartials) {
+    ASSERT_DURATION_LE(2, {
+        auto cm = std::make_shared<ComputationManager>();
+        cm->setShardingPolicy(ComputationType::B, ShardingPolicy{ShardReduction::Product, 4, 1000});
+        ComputeEngineB b1(cm, Granularity::byElements(512));
+        ComputeEngineB b2(cm, Granularity::byElements(512));
+        b1.startThread();
+        b2.startThread();
+
+        Computation mul(ComputationType::B);
+        mul.data->assign(4000, 1024.0);
+        mul.data->resize(8000, 1.0 / 1024.0);
+        (*mul.data)[7999] = 3.0;
+        cm->requestComputation(mul);
+        auto res = cm->getNextResult();
+        ASSERT_EQ(ResultStatus::Ok, res.getStatus());
+        ASSERT_EQ(3.0 * 1024.0, res.getResult());
+
+        mul.data->assign(8000, 1024.0);
+        cm->requestComputation(mul);
+        res = cm->getNextResult();
+        ASSERT_EQ(ResultStatus::Overflow, res.getStatus());
+        ASSERT_TRUE(std::isinf(res.getResult()));
+
+        cm->stop();
+        b1.join();
+        b2.join();
+    })
+}
+
+/* A sharded computation takes one slot of the queue, aborting it removes all of its shards */
+TEST(Sharding, AbortShouldCancelAllShards) {
+    ASSERT_DURATION_LE(1, {
+        auto cm = std::make_shared<ComputationManager>(1);
+        cm->setShardingPolicy(ComputationType::A, ShardingPolicy{ShardReduction::Sum, 8, 100});
+
+        Computation sum(ComputationType::A);
+        sum.data->assign(1000, 1.0);
+        auto const abortedId = cm->requestComputation(sum);
+        auto const shard = cm->getWork(ComputationType::A);
+        ASSERT_TRUE(shard.isShard());
+        ASSERT_EQ(abortedId, shard.getId());
+        ASSERT_EQ(125u, shard.size());
+        cm->abortComputation(abortedId);
+        ASSERT_FALSE(cm->continueWork(abortedId));
+        cm->provideResult(Result::partial(abortedId, 0, 125.0));
+
+        // Would block if the aborted computation still held the only slot of the queue
+        auto const id = cm->requestComputation(sum);
+        ComputeEngineA engine(cm, Granularity::byElements(64));
+        engine.startThread();
+        auto res = cm->getNextResult();
+        ASSERT_EQ(id, res.getId());
+        ASSERT_EQ(1000.0, res.getResult());
+
+        cm->stop();
+        engine.join();
+    })
+}
+
+/* Only A and B have a reduction that combines the partial results, with the operation of their type */
+TEST(Sharding, OnlyReducedTypesShouldBeSharded) {
+    ComputationManager cm;
+    ASSERT_THROW(cm.setShardingPolicy(ComputationType::C, ShardingPolicy{ShardReduction::Sum, 2, 1}), std::invalid_argument);
+    ASSERT_THROW(cm.setShardingPolicy(ComputationType::D, ShardingPolicy{ShardReduction::Sum, 2, 1}), std::invalid_argument);
+    ASSERT_NO_THROW(cm.setShardingPolicy(ComputationType::C, ShardingPolicy{}));
+    ASSERT_NO_THROW(cm.setShardingPolicy(ComputationType::B, ShardingPolicy{ShardReduction::Product, 2, 1}));
+
+    ASSERT_THROW(cm.setShardingPolicy(ComputationType::A, ShardingPolicy{ShardReduction::Product, 2, 1}), std::invalid_argument);
+    ASSERT_THROW(cm.setShardingPolicy(ComputationType::B, ShardingPolicy{ShardReduction::Sum, 2, 1}), std::invalid_argument);
+    ASSERT_NO_THROW(cm.setShardingPolicy(ComputationType::A, ShardingPolicy{ShardReduction::Max, 2, 1}));
+    ASSERT_NO_THROW(cm.setShardingPolicy(ComputationType::B, ShardingPolicy{ShardReduction::Min, 2, 1}));
+    ASSERT_NO_THROW(cm.setShardingPolicy(ComputationType::B, ShardingPolicy{}));
+}
+
+/* The elements are spread over lanes, the tails that do not fill all the lanes must be reduced too */
+TEST(Reduction, ElementwiseReductionsShouldCoverEveryElement) {
+    const std::vector<std::size_t> sizes = {0, 1, 15, 16, 17, 33, 1000, 4099};
+    ASSERT_DURATION_LE(1, {
+        for (std::size_t n : sizes) {
+            std::vector<double> values(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                values[i] = static_cast<double>((i * 7919) % 1009) - 500.0;
+            }
+
+            MinReduction min;
+            MaxReduction max;
+            SumOfSquaresReduction squares;
+            auto minAcc = min.identity();
+            auto maxAcc = max.identity();
+            auto squaresAcc = squares.identity();
+            min.accumulate(minAcc, values.data(), n);
+            max.accumulate(maxAcc, values.data(), n);
+            squares.accumulate(squaresAcc, values.data(), n);
+
+            auto expectedSquares = 0.0;
+            for (auto x : values) {
+                expectedSquares += x * x;
+            }
+            ASSERT_EQ(n ? *std::min_element(values.begin(), values.end()) : INFINITY, min.value(minAcc));
+            ASSERT_EQ(n ? *std::max_element(values.begin(), values.end()) : -INFINITY, max.value(maxAcc));
+            ASSERT_EQ(expectedSquares, squares.value(squaresAcc));
+        }
+    })
+}
+
+TEST(Reduction, ReductionEnginesShouldRunUserOperations) {
+    using MaxEngine = ReductionEngine<ComputationType::A, MaxReduction>;
+    using SumOfSquaresEngine = ReductionEngine<ComputationType::B, SumOfSquaresReduction>;
+    ASSERT_DURATION_LE(1, {
+        auto cm = std::make_shared<ComputationManager>();
+        cm->setShardingPolicy(ComputationType::A, ShardingPolicy{ShardReduction::Max, 4, 100});
+        MaxEngine max1(cm, Granularity::byElements(64));
+        MaxEngine max2(cm, Granularity::byElements(64));
+        SumOfSquaresEngine squares(cm, Granularity::byElements(64));
+        max1.startThread();
+        max2.startThread();
+        squares.startThread();
+
+        Computation max(ComputationType::A);
+        max.data->assign(1000, -1.0);
+        (*max.data)[777] = 42.0;
+        Computation norm(ComputationType::B);
+        norm.data->assign(100, 2.0);
+
+        cm->requestComputation(max);
+        cm->requestComputation(norm);
+        ASSERT_EQ(42.0, cm->getNextResult().getResult());
+        ASSERT_EQ(400.0, cm->getNextResult().getResult());
+
+        cm->stop();
+        max1.join();
+        max2.join();
+        squares.join();
+    })
+}
+
+TEST(Reduction, EnvironmentShouldCreateTheRegisteredEngines) {
+    ASSERT_DURATION_LE(1, {
+        auto cm = std::make_shared<ComputationManager>();
+        ComputeEnvironment environment(cm, Granularity::byElements(64));
+        environment.populateComputeEnvironment();
+        environment.startComputeEnvironment();
+
+        Computation sum(ComputationType::A);
+        sum.data->assign(100, 2.0);
+        Computation mul(ComputationType::B);
+        mul.data->assign(10, 2.0);
+        Computation div(ComputationType::C);
+        div.data->push_back(1.0);
+        div.data->push_back(4.0);
+        cm->requestComputation(sum);
+        cm->requestComputation(mul);
+        cm->requestComputation(div);
+        ASSERT_EQ(200.0, cm->getNextResult().getResult());
+        ASSERT_EQ(1024.0, cm->getNextResult().getResult());
+        ASSERT_EQ(0.25, cm->getNextResult().getResult());
+
+        cm->stop();
+        environment.joinComputeEnvironment();
+    })
+}
+
+/* The GUI reads the request of an engine from ComputeEngineCommon, the reduction engines keep it up to date */
+TEST(Reduction, ReductionEnginesShouldSetTheCurrentRequest) {
+    class RequestRecordingEngine : public ComputeEngineB
+    {
+    public:
+        RequestRecordingEngine(std::shared_ptr<ComputationManager> cm): AbstractComputeEngine(cm, 0), ComputeEngineB(cm) {}
+        std::atomic<int> seenId = -1;
+        std::atomic<std::size_t> seenSize = 0;
+    protected:
+        void advanceComputation() override {
+            seenId = currentRequest.getId();
+            seenSize = currentRequest.size();
+            ComputeEngineB::advanceComputation();
+        }
+    };
+
+    ASSERT_DURATION_LE(1, {
+        auto cm = std::make_shared<ComputationManager>();
+        RequestRecordingEngine engine(cm);
+        engine.startThread();
+
+        for (std::size_t n : {3u, 7u}) {
+            Computation mul(ComputationType::B);
+            mul.data->assign(n, 2.0);
+            auto const id = cm->requestComputation(mul);
+            ASSERT_EQ(std::ldexp(1.0, static_cast<int>(n)), cm->getNextResult().getResult());
+            ASSERT_EQ(id, engine.seenId);
+            ASSERT_EQ(n, engine.seenSize);
+        }
+
+        cm->stop();
+        engine.join();
+    })
+}
+
+/* The environment runs the static engines and the batched C engine, not the virtual ComputeEngineA/B/C */
+TEST(Reduction, EnvironmentShouldUseTheStaticAndBatchedEngines) {
+    auto engineOf = [](ComputationType type) {
+        std::string name = "none";
+        ComputeEnvironment::Engines::forType(type, [&name](auto tag) {
+            using Engine = typename decltype(tag)::type;
+            name = std::is_same_v<Engine, StaticReductionEngine<ComputationType::A, SumReduction>>       ? "static A"
+                 : std::is_same_v<Engine, StaticReductionEngine<ComputationType::B, ProductReduction>>   ? "static B"
+                 : std::is_same_v<Engine, BatchedComputeEngineC>                                         ? "batched C"
+                 : std::is_same_v<Engine, StaticReductionEngine<ComputationType::D, AggregateReduction>> ? "static D"
+                                                                                                         : "other";
+        });
+        return name;
+    };
+    ASSERT_EQ("static A", engineOf(ComputationType::A));
+    ASSERT_EQ("static B", engineOf(ComputationType::B));
+    ASSERT_EQ("batched C", engineOf(ComputationType::C));
+    ASSERT_EQ("static D", engineOf(ComputationType::D));
+}
+
+TEST(Reduction, StaticEnginesShouldComputeAndAbortLikeVirtualEngines) {
+    using StaticSumEngine = StaticReductionEngine<ComputationType::A, SumReduction>;
+    using StaticProductEngine = StaticReductionEngine<ComputationType::B, ProductReduction>;
+    ASSERT_DURATION_LE(2, {
+        auto cm = std::make_shared<ComputationManager>();
+        cm->setShardingPolicy(ComputationType::B, ShardingPolicy{ShardReduction::Product, 2, 1000});
+        StaticSumEngine sum(cm, Granularity::byElements(1));
+        StaticProductEngine mul1(cm, Granularity::byElements(128));
+        StaticProductEngine mul2(cm, Granularity::byElements(128));
+        sum.startThread();
+        mul1.startThread();
+        mul2.startThread();
+
+        // Element by element, aborting stops the engine long before the end of the data
+        Computation longSum(ComputationType::A);
+        longSum.data->assign(100'000'000, 1.0);
+        auto const abortedId = cm->requestComputation(longSum);
+        Computation shortSum(ComputationType::A);
+        shortSum.data->assign(1000, 0.5);
+        auto const sumId = cm->requestComputation(shortSum);
+        Computation mul(ComputationType::B);
+        mul.data->assign(4000, 2.0);
+        mul.data->resize(6000, 0.25);
+        auto const mulId = cm->requestComputation(mul);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        cm->abortComputation(abortedId);
+
+        auto res = cm->getNextResult();
+        ASSERT_EQ(sumId, res.getId());
+        ASSERT_EQ(500.0, res.getResult());
+        res = cm->getNextResult();
+        ASSERT_EQ(mulId, res.getId());
+        ASSERT_EQ(1.0, res.getResult());
+
+        cm->stop();
+        sum.join();
+        mul1.join();
+        mul2.join();
+    })
+}
+
+TEST(MultiType, WorkOfAnyTypeShouldWaitForATypeOfTheMask) {
+    ASSERT_DURATION_LE(1, {
+        ComputationManager cm;
+        Request request;
+        auto engine = std::thread([&](){request = cm.getWork(ComputationType::A | ComputationType::B);});
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        cm.requestComputation(Computation(ComputationType::C));
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        auto const id = cm.requestComputation(Computation(ComputationType::B));
+        engine.join();
+        ASSERT_EQ(id, request.getId());
+        ASSERT_EQ(ComputationType::B, request.getType());
+
+        // The C request was left for the engines of type C
+        ASSERT_EQ(ComputationType::C, cm.getWork(TypeMask::all()).getType());
+    })
+}
+
+TEST(MultiType, WorkOfAnyTypeShouldFollowTheSelectionPolicy) {
+    ASSERT_DURATION_LE(1, {
+        ComputationManager cm;
+        cm.requestComputation(Computation(ComputationType::A));
+        for (int i = 0; i < 3; ++i) {
+            cm.requestComputation(Computation(ComputationType::B));
+        }
+
+        cm.setSelectionPolicy(SelectionPolicy::OldestRequest);
+        ASSERT_EQ(ComputationType::A, cm.getWork(TypeMask::all()).getType());
+        cm.requestComputation(Computation(ComputationType::A));
+        cm.setSelectionPolicy(SelectionPolicy::LongestQueue);
+        ASSERT_EQ(ComputationType::B, cm.getWork(TypeMask::all()).getType());
+        cm.setSelectionPolicy(SelectionPolicy::Weighted);
+        cm.setTypeWeight(ComputationType::A, 3.0);
+        ASSERT_EQ(ComputationType::A, cm.getWork(TypeMask::all()).getType());
+    })
+}
+
+TEST(MultiType, EveryTypeShouldHaveADefaultWeight) {
+    ASSERT_DURATION_LE(1, {
+        ComputationManager cm;
+        cm.setSelectionPolicy(SelectionPolicy::Weighted);
+        cm.requestComputation(Computation(ComputationType::A));
+        cm.requestComputation(Computation(ComputationType::D));
+        cm.requestComputation(Computation(ComputationType::D));
+        ASSERT_EQ(ComputationType::D, cm.getWork(TypeMask::all()).getType());
+        cm.setTypeWeight(ComputationType::A, 3.0);
+        ASSERT_EQ(ComputationType::A, cm.getWork(TypeMask::all()).getType());
+        ASSERT_EQ(ComputationType::D, cm.getWork(TypeMask::all()).getType());
+    })
+}
+
+TEST(MultiType, StopShouldReleaseEnginesWaitingOnSeveralTypes) {
+    ASSERT_DURATION_LE(1, {
+        ComputationManager cm;
+        auto const wait = [&](TypeMask mask) {
+            ASSERT_THROW(cm.getWork(mask), ComputationManager::StopException);
+        };
+        auto t1 = std::thread(wait, TypeMask::all());
+        auto t2 = std::thread(wait, TypeMask::all());
+        auto t3 = std::thread(wait, ComputationType::A | ComputationType::C);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        cm.stop();
+        t1.join();
+        t2.join();
+        t3.join();
+    })
+}
+
+TEST(MultiType, PolymorphicEnginesShouldServeEveryType) {
+    ASSERT_DURATION_LE(2, {
+        auto cm = std::make_shared<ComputationManager>(100);
+        ComputeEnvironment environment(cm, Granularity::byElements(256));
+        environment.addPolymorphicComputeEngines(3);
+        environment.startComputeEnvironment();
+
+        for (int i = 0; i < 60; ++i) {
+            Computation c(static_cast<ComputationType>(i % 3));
+            c.data->assign(1000, 2.0);
+            if (i % 3 == 2) {
+                c.data->assign(2, static_cast<double>(i));
+            }
+            cm->requestComputation(c);
+        }
+        for (int i = 0; i < 60; ++i) {
+            auto res = cm->getNextResult();
+            ASSERT_EQ(i % 3 == 0 ? 2000.0 : i % 3 == 1 ? std::ldexp(1.0, 1000) : 1.0, res.getResult());
+        }
+
+        cm->stop();
+        environment.joinComputeEnvironment();
+    })
+}
+
+TEST(Autoscaler, QueueStatsShouldReportDepthWaitAndIdleEngines) {
+    ASSERT_DURATION_LE(1, {
+        ComputationManager cm;
+        auto engine = std::thread([&](){cm.getWork(ComputationType::B);});
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ASSERT_EQ(1u, cm.getQueueStats(ComputationType::B).idleEngines);
+        cm.requestComputation(Computation(ComputationType::B));
+        engine.join();
+
+        cm.requestComputation(Computation(ComputationType::A));
+        cm.requestComputation(Computation(ComputationType::A));
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        auto const stats = cm.getQueueStats(ComputationType::A);
+        ASSERT_EQ(2u, stats.queuedRequests);
+        ASSERT_EQ(0u, stats.idleEngines);
+        ASSERT_GE(stats.oldestWait, std::chrono::milliseconds(20));
+
+        cm.stop();
+        ASSERT_THROW(cm.getQueueStats(ComputationType::A), ComputationManager::StopException);
+    })
+}
+
+TEST(Autoscaler, RetireShouldStopOneEngineAndKeepTheManagerRunning) {
+    ASSERT_DURATION_LE(1, {
+        auto cm = std::make_shared<ComputationManager>();
+        ComputeEngineC c1(cm);
+        ComputeEngineC c2(cm);
+        c1.startThread();
+        c2.startThread();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+        cm->retireEngine(ComputationType::C);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ASSERT_EQ(1, c1.isFinished() + c2.isFinished());
+
+        Computation div(ComputationType::C);
+        div.data->push_back(1.0);
+        div.data->push_back(2.0);
+        cm->requestComputation(div);
+        ASSERT_EQ(0.5, cm->getNextResult().getResult());
+
+        cm->stop();
+        c1.join();
+        c2.join();
+    })
+}
+
+TEST(Autoscaler, EnginesShouldFollowThePressure) {
+    ASSERT_DURATION_LE(3, {
+        auto cm = std::make_shared<ComputationManager>(100);
+        ScalingPolicy policy;
+        policy.minEngines = 1;
+        policy.maxEngines = 3;
+        policy.scaleUpQueueLength = 2;
+        policy.scaleDownIdle = std::chrono::milliseconds(50);
+        policy.cooldown = std::chrono::milliseconds(10);
+        Autoscaler autoscaler(cm, std::chrono::milliseconds(2));
+        autoscaler.addType(ComputationType::A, [cm] {return std::make_shared<TestComputeEngine>(cm, ComputationType::A, 5, 2);}, policy);
+        autoscaler.startThread();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ASSERT_EQ(1u, autoscaler.engineCount(ComputationType::A));
+
+        for (int i = 0; i < 40; ++i) {
+            cm->requestComputation(Computation(ComputationType::A));
+        }
+        unsigned maxEngines = 0;
+        for (int i = 0; i < 40; ++i) {
+            cm->getNextResult();
+            maxEngines = std::max(maxEngines, autoscaler.engineCount(ComputationType::A));
+        }
+        ASSERT_EQ(3u, maxEngines);
+
+        // Once idle, engines are retired one at a time down to the minimum
+        std::this_thread::sleep_for(std::chrono::milliseconds(400));
+        ASSERT_EQ(1u, autoscaler.engineCount(ComputationType::A));
+
+        cm->stop();
+        autoscaler.join();
+    })
+}
+
+TEST(Placement, CpuListsShouldBeParsed) {
+    ASSERT_EQ(CpuSet({0, 1, 2, 3, 8, 10, 11}), CpuTopology::parseCpuList("0-3,8,10-11"));
+    ASSERT_EQ(CpuSet({5}), CpuTopology::parseCpuList("5\n"));
+    ASSERT_TRUE(CpuTopology::parseCpuList("").empty());
+}
+
+TEST(Placement, EnginesShouldBeSpreadAccordingToThePolicy) {
+    const CpuTopology topology({CpuSet({0, 1}), CpuSet({2, 3})});
+    Placement placement;
+    ASSERT_TRUE(placement.cpusFor(1, 0, topology).empty());
+
+    placement.pinToCore = true;
+    ASSERT_EQ(CpuSet({3}), placement.cpusFor(-1, 3, topology));
+    ASSERT_EQ(CpuSet({0}), placement.cpusFor(-1, 4, topology));
+
+    placement.pinToCore = false;
+    placement.groupByType = true;
+    ASSERT_EQ(CpuSet({2, 3}), placement.cpusFor(1, 0, topology));
+    ASSERT_EQ(CpuSet({0, 1}), placement.cpusFor(2, 0, topology));
+    ASSERT_EQ(CpuSet({0, 1, 2, 3}), placement.cpusFor(-1, 0, topology));
+
+    placement.pinToCore = true;
+    ASSERT_EQ(CpuSet({3}), placement.cpusFor(1, 1, topology));
+    ASSERT_EQ(CpuSet({2}), placement.cpusFor(1, 2, topology));
+}
+
+/* Records the processor its thread runs on */
+class CpuRecorder : public Launchable
+{
+public:
+    int cpu = -1;
+protected:
+    void run() override {cpu = sched_getcpu();}
+    void printStartMessage() const override {}
+    void printCompletionMessage() const override {}
+};
+
+TEST(Placement, ThreadsShouldRunOnTheirProcessors) {
+    ASSERT_DURATION_LE(1, {
+        auto const& cpus = CpuTopology::system().cpus();
+        ASSERT_FALSE(cpus.empty());
+        for (auto const cpu : cpus) {
+            CpuRecorder recorder;
+            recorder.setPlacement(CpuSet(1, cpu));
+            recorder.startThread();
+            recorder.join();
+            ASSERT_EQ(cpu, recorder.cpu);
+        }
+
+        auto const data = allocateOnCpus(1000, CpuSet(1, cpus.back()));
+        ASSERT_EQ(1000u, data->size());
+        ASSERT_EQ(0.0, std::accumulate(data->begin(), data->end(), 0.0));
+    })
+}
+
+TEST(Preemption, YieldedRequestsShouldGoBackToTheEndOfTheBuffer) {
+    ASSERT_DURATION_LE(1, {
+        ComputationManager cm;
+        auto const longId = cm.requestComputation(Computation(ComputationType::A));
+        auto const shortId = cm.requestComputation(Computation(ComputationType::A));
+
+        auto request = cm.getWork(ComputationType::A);
+        ASSERT_EQ(longId, request.getId());
+        ASSERT_EQ(WorkDirective::Continue, cm.workDirective(longId));
+
+        cm.preemptComputation(longId);
+        ASSERT_EQ(WorkDirective::Yield, cm.workDirective(longId));
+        ASSERT_EQ(WorkDirective::Continue, cm.workDirective(longId));
+        request.setCheckpoint(42);
+        cm.yieldWork(request);
+
+        ASSERT_EQ(shortId, cm.getWork(ComputationType::A).getId());
+        auto const resumed = cm.getWork(ComputationType::A);
+        ASSERT_EQ(longId, resumed.getId());
+        ASSERT_TRUE(resumed.hasCheckpoint());
+        ASSERT_EQ(42, std::any_cast<int>(resumed.getCheckpoint()));
+
+        ASSERT_EQ(WorkDirective::Abort, cm.workDirective(99));
+        cm.stop();
+        ASSERT_EQ(WorkDirective::Abort, cm.workDirective(longId));
+    })
+}
+
+TEST(Preemption, AbortedRequestsShouldNotBeRequeued) {
+    ASSERT_DURATION_LE(1, {
+        ComputationManager cm;
+        auto const first = cm.requestComputation(Computation(ComputationType::B));
+        auto const second = cm.requestComputation(Computation(ComputationType::B));
+        auto const r1 = cm.getWork(ComputationType::B);
+        auto const r2 = cm.getWork(ComputationType::B);
+
+        // Aborted after being yielded
+        cm.preemptComputation(first);
+        ASSERT_EQ(WorkDirective::Yield, cm.workDirective(first));
+        cm.yieldWork(r1);
+        ASSERT_EQ(1u, cm.getQueueStats(ComputationType::B).queuedRequests);
+        cm.abortComputation(first);
+        ASSERT_EQ(0u, cm.getQueueStats(ComputationType::B).queuedRequests);
+
+        // Aborted while being saved
+        cm.preemptComputation(second);
+        cm.abortComputation(second);
+        ASSERT_EQ(WorkDirective::Abort, cm.workDirective(second));
+        cm.yieldWork(r2);
+        ASSERT_EQ(0u, cm.getQueueStats(ComputationType::B).queuedRequests);
+        cm.stop();
+    })
+}
+
+/* A preempted reduction resumes where it stopped, no step is done twice */
+TEST(Preemption, EnginesShouldResumePreemptedComputations) {
+    class SlowEngine : public ComputeEngineA
+    {
+    public:
+        SlowEngine(std::shared_ptr<ComputationManager> cm): AbstractComputeEngine(cm, 0), ComputeEngineA(cm, Granularity::byElements(1000)) {}
+        std::atomic<int> steps = 0;
+        mutable std::atomic<int> yields = 0;
+    protected:
+        void advanceComputation() override {
+            ++steps;
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            ComputeEngineA::advanceComputation();
+        }
+        Request saveComputation() const override {
+            ++yields;
+            return ComputeEngineA::saveComputation();
+        }
+    };
+
+    ASSERT_DURATION_LE(2, {
+        auto cm = std::make_shared<ComputationManager>();
+        SlowEngine engine(cm);
+        engine.startThread();
+
+        Computation sum(ComputationType::A);
+        sum.data->assign(100'000, 1.0);
+        Computation small(ComputationType::A);
+        small.data->assign(10, 1.0);
+
+        auto const id = cm->requestComputation(sum);
+        for (int i = 0; i < 3; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            cm->requestComputation(small);
+            cm->preemptComputation(id);
+        }
+
+        ASSERT_EQ(100'000.0, cm->getNextResult().getResult());
+        for (int i = 0; i < 3; ++i) {
+            ASSERT_EQ(10.0, cm->getNextResult().getResult());
+        }
+        ASSERT_GE(engine.yields, 1);
+        ASSERT_EQ(100 + 3, engine.steps);
+
+        cm->stop();
+        engine.join();
+    })
+}
+
+TEST(Fiber, FibersShouldYieldAndPark) {
+    ASSERT_DURATION_LE(1, {
+        FiberScheduler scheduler(2);
+        std::atomic<int> steps = 0;
+        for (int i = 0; i < 100; ++i) {
+            scheduler.spawn([&steps] {
+                for (int j = 0; j < 10; ++j) {
+                    ++steps;
+                    Fiber::yield();
+                }
+            });
+        }
+
+        // The unpark may come before or after the park, the parked fiber goes on in both cases
+        std::atomic<Fiber*> parked = nullptr;
+        std::atomic<bool> resumed = false;
+        scheduler.spawn([&] {
+            parked = Fiber::current();
+            Fiber::park();
+            resumed = true;
+        });
+        scheduler.spawn([&] {
+            while (parked == nullptr) {
+                Fiber::yield();
+            }
+            parked.load()->unpark();
+        });
+
+        ASSERT_EQ(nullptr, Fiber::current());
+        scheduler.start();
+        scheduler.join();
+        ASSERT_EQ(1000, steps);
+        ASSERT_TRUE(resumed);
+    })
+}
+
+/* Engines waiting for work park their fiber, a single worker thus serves many engines of several types */
+TEST(Fiber, ManyEnginesShouldShareFewWorkers) {
+    ASSERT_DURATION_LE(2, {
+        auto cm = std::make_shared<ComputationManager>();
+        FiberScheduler scheduler(1);
+        std::vector<std::unique_ptr<Launchable>> engines;
+        for (int i = 0; i < 100; ++i) {
+            engines.push_back(std::make_unique<ComputeEngineA>(cm, Granularity::byElements(16)));
+            engines.push_back(std::make_unique<ComputeEngineB>(cm));
+        }
+        engines.push_back(std::make_unique<ComputeEngineC>(cm));
+        for (auto& engine : engines) {
+            engine->startFiber(scheduler);
+        }
+        scheduler.start();
+
+        for (int i = 0; i < 20; ++i) {
+            Computation sum(ComputationType::A);
+            sum.data->assign(100, 1.0);
+            cm->requestComputation(sum);
+            Computation div(ComputationType::C);
+            div.data->push_back(static_cast<double>(i));
+            div.data->push_back(2.0);
+            cm->requestComputation(div);
+        }
+        for (int i = 0; i < 20; ++i) {
+            ASSERT_EQ(100.0, cm->getNextResult().getResult());
+            ASSERT_EQ(i / 2.0, cm->getNextResult().getResult());
+        }
+        ASSERT_EQ(100u, cm->getQueueStats(ComputationType::B).idleEngines);
+
+        cm->stop();
+        for (auto& engine : engines) {
+            engine->join();
+        }
+        scheduler.join();
+    })
+}
+
+TEST(Fiber, EnvironmentShouldRunEnginesOnFibers) {
+    ASSERT_DURATION_LE(1, {
+        auto cm = std::make_shared<ComputationManager>();
+        ComputeEnvironment environment(cm, Granularity::byElements(64), Placement{}, Execution{ExecutionMode::Fibers, 2});
+        environment.populateComputeEnvironment();
+        environment.addPolymorphicComputeEngines(8);
+        environment.startComputeEnvironment();
+
+        Computation mult(ComputationType::B);
+        mult.data->assign(10, 2.0);
+        Computation sum(ComputationType::A);
+        sum.data->assign(1000, 0.5);
+        cm->requestComputation(mult);
+        cm->requestComputation(sum);
+        ASSERT_EQ(1024.0, cm->getNextResult().getResult());
+        ASSERT_EQ(500.0, cm->getNextResult().getResult());
+
+        cm->stop();
+        environment.joinComputeEnvironment();
+    })
+}
+
+TEST(Utilization, EnginesShouldAccountForTheirTime) {
+    ASSERT_DURATION_LE(2, {
+        auto cm = std::make_shared<ComputationManager>();
+        TestComputeEngine engine(cm, ComputationType::A, 3, 10);
+        engine.startThread();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+        auto const done = cm->requestComputation(Computation(ComputationType::A));
+        ASSERT_EQ(done, cm->getNextResult().getId());
+        auto u = engine.getUtilization();
+        ASSERT_EQ(ComputationType::A, u.type);
+        ASSERT_EQ(1u, u.completed);
+        ASSERT_GE(u.idle, std::chrono::milliseconds(20));
+        ASSERT_GE(u.busy, std::chrono::milliseconds(30));
+        ASSERT_EQ(0, u.wasted.count());
+
+        auto const aborted = cm->requestComputation(Computation(ComputationType::A));
+        std::this_thread::sleep_for(std::chrono::milliseconds(15));
+        cm->abortComputation(aborted);
+        for (int i = 0; i < 100 && engine.getUtilization().aborted == 0; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        u = engine.getUtilization();
+        ASSERT_EQ(1u, u.aborted);
+        ASSERT_EQ(1u, u.completed);
+        ASSERT_GE(u.wasted, std::chrono::milliseconds(10));
+        ASSERT_GT(u.utilization(), 0.0);
+        ASSERT_LT(u.utilization(), 1.0);
+
+        cm->stop();
+        engine.join();
+    })
+}
+
+TEST(Utilization, EnvironmentShouldReportEveryEngine) {
+    ASSERT_DURATION_LE(1, {
+        auto cm = std::make_shared<ComputationManager>();
+        ComputeEnvironment environment(cm);
+        environment.populateComputeEnvironment();
+        environment.startComputeEnvironment();
+
+        for (int i = 0; i < 10; ++i) {
+            Computation sum(ComputationType::A);
+            sum.data->assign(100, 1.0);
+            cm->requestComputation(sum);
+            Computation div(ComputationType::C);
+            div.data->push_back(1.0);
+            div.data->push_back(2.0);
+            cm->requestComputation(div);
+        }
+        for (int i = 0; i < 20; ++i) {
+            cm->getNextResult();
+        }
+
+        auto const utilization = environment.getUtilization();
+        ASSERT_EQ(4u, utilization.size());
+        std::uint64_t completedA = 0;
+        std::uint64_t completedC = 0;
+        for (auto const& u : utilization) {
+            (u.type == ComputationType::A ? completedA : completedC) += u.completed;
+        }
+        ASSERT_EQ(10u, completedA);
+        ASSERT_EQ(10u, completedC);
+
+        cm->stop();
+        environment.joinComputeEnvironment();
+    })
+}
+
+/* A polymorphic engine reports the type of the computation it took last */
+TEST(Utilization, PolymorphicEngineShouldReportTheTypeOfItsKernel) {
+    ASSERT_DURATION_LE(1, {
+        auto cm = std::make_shared<ComputationManager>();
+        PolymorphicComputeEngine engine(cm);
+        ASSERT_EQ(ComputationType::COUNT, engine.getUtilization().type);
+        engine.startThread();
+
+        cm->requestComputation(Computation(ComputationType::B, {2.0, 3.0}));
+        ASSERT_EQ(6.0, cm->getNextResult().getResult());
+        ASSERT_EQ(ComputationType::B, engine.getUtilization().type);
+
+        cm->requestComputation(Computation(ComputationType::A, {2.0, 3.0}));
+        ASSERT_EQ(5.0, cm->getNextResult().getResult());
+        ASSERT_EQ(ComputationType::A, engine.getUtilization().type);
+        ASSERT_EQ(2u, engine.getUtilization().completed);
+
+        cm->stop();
+        engine.join();
+    })
+}
+
+TEST(PayloadPool, ReleasedPayloadsShouldBeReusedZeroed) {
+    for (int i = 0; i < 4; ++i) {
+        auto payload = PayloadPool::acquire(1000);
+        ASSERT_EQ(1000u, payload->size());
+        ASSERT_GE(payload->capacity(), 1000u);
+        ASSERT_TRUE(std::all_of(payload->begin(), payload->end(), [](double x) { return x == 0.0; }));
+        std::fill(payload->begin(), payload->end(), 1.0);
+    }
+
+    auto const before = PayloadPool::stats();
+    for (int i = 0; i < 1000; ++i) {
+        Computation c(ComputationType::A, 1000);
+        ASSERT_EQ(0.0, c.data->back());
+        c.data->back() = 1.0;
+    }
+    auto const after = PayloadPool::stats();
+    ASSERT_EQ(before.payloadAllocations, after.payloadAllocations);
+    ASSERT_EQ(before.blockAllocations, after.blockAllocations);
+}
+
+/* The engines release the payloads of the client, they go back to the client through the depot. The number
+ * of payloads allocated is bounded by what the caches of the two threads and the requests in flight hold, it
+ * does not grow with the number of requests. */
+TEST(PayloadPool, RequestsShouldReuseThePayloadsReleasedByTheEngines) {
+    ASSERT_DURATION_LE(5, {
+        auto cm = std::make_shared<ComputationManager>();
+        ComputeEngineA engine(cm, Granularity::byElements(1024));
+        engine.startThread();
+
+        auto const before = PayloadPool::stats();
+        for (int round = 0; round < 200; ++round) {
+            for (int i = 0; i < 10; ++i) {
+                Computation sum(ComputationType::A, 4096);
+                std::fill(sum.data->begin(), sum.data->end(), 1.0);
+                cm->requestComputation(sum);
+            }
+            for (int i = 0; i < 10; ++i) {
+                ASSERT_EQ(4096.0, cm->getNextResult().getResult());
+            }
+        }
+        auto const after = PayloadPool::stats();
+        ASSERT_LE(after.payloadAllocations - before.payloadAllocations, 2 * PayloadPool::LOCAL_CACHE_SIZE + 20);
+        ASSERT_LE(after.blockAllocations - before.blockAllocations, 2 * 64 + 20u);
+
+        cm->stop();
+        engine.join();
+    })
+}
+
+/**
+ * @brief writeDoubles Writes a header of headerBytes bytes then the values 0, 1, ..., count - 1 to a file
+ */
+static std::string writeDoubles(const std::string& name, std::size_t headerBytes, std::size_t count) {
+    auto const path = testing::TempDir() + name;
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    std::vector<char> header(headerBytes, 'h');
+    file.write(header.data(), static_cast<std::streamsize>(header.size()));
+    std::vector<double> values(count);
+    std::iota(values.begin(), values.end(), 0.0);
+    file.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(count * sizeof(double)));
+    return path;
+}
+
+TEST(MappedPayload, RegionsShouldBeMappedOrRejected) {
+    auto const path = writeDoubles("mapped_region.bin", 24, 3000);
+
+    auto const whole = MappedPayload::open(path, 24);
+    ASSERT_EQ(3000u, whole->size());
+    ASSERT_EQ(0.0, whole->values()[0]);
+    ASSERT_EQ(2999.0, whole->values()[2999]);
+
+    // The region starts in the middle of the second page
+    auto const region = MappedPayload::open(path, 24 + 600 * sizeof(double), 100);
+    ASSERT_EQ(100u, region->size());
+    ASSERT_EQ(600.0, region->values()[0]);
+    ASSERT_EQ(699.0, region->values()[99]);
+    ASSERT_EQ(0u, MappedPayload::open(path, 24 + 3000 * sizeof(double))->size());
+
+    ASSERT_THROW(MappedPayload::open(path, 20), std::invalid_argument);
+    ASSERT_THROW(MappedPayload::open(path, 24, 3001), std::invalid_argument);
+    ASSERT_THROW(MappedPayload::open(path + ".missing"), std::system_error);
+    std::remove(path.c_str());
+}
+
+/* The mapped data goes to the engines without being copied, whole or split in shards */
+TEST(MappedPayload, EnginesShouldReduceMappedComputations) {
+    auto const path = writeDoubles("mapped_computation.bin", 8, 10001);
+    ASSERT_DURATION_LE(2, {
+        auto cm = std::make_shared<ComputationManager>();
+        ComputeEngineA a1(cm, Granularity::byElements(256));
+        ComputeEngineA a2(cm, Granularity::byElements(256));
+        a1.startThread();
+        a2.startThread();
+
+        Computation whole(ComputationType::A, MappedPayload::open(path, 8));
+        ASSERT_EQ(nullptr, whole.data);
+        ASSERT_EQ(10001u, whole.size());
+        cm->requestComputation(whole);
+        ASSERT_EQ(10000.0 * 10001.0 / 2.0, cm->getNextResult().getResult());
+
+        cm->setShardingPolicy(ComputationType::A, ShardingPolicy{ShardReduction::Sum, 4, 1000});
+        Computation tail(ComputationType::A, MappedPayload::open(path, 8 + 1 * sizeof(double), 10000));
+        cm->requestComputation(tail);
+        ASSERT_EQ(10000.0 * 10001.0 / 2.0, cm->getNextResult().getResult());
+
+        cm->stop();
+        a1.join();
+        a2.join();
+    })
+    std::remove(path.c_str());
+}
+
+/* The engine reduces the chunks while the client appends them, the other requests keep their order */
+TEST(Streaming, StreamedComputationsShouldBeReducedWhileAppended) {
+    ASSERT_DURATION_LE(2, {
+        auto cm = std::make_shared<ComputationManager>();
+        ComputeEngineA a(cm, Granularity::byElements(256));
+        ComputeEngineB b(cm);
+        a.startThread();
+        b.startThread();
+
+        auto const stream = cm->openComputation(ComputationType::A, 4000);
+        Computation mult(ComputationType::B);
+        mult.data->assign(10, 2.0);
+        auto const multId = cm->requestComputation(mult);
+        for (int i = 0; i < 100; ++i) {
+            ASSERT_TRUE(stream->append(std::vector<double>(1000, 1.0)));
+        }
+        stream->close();
+
+        auto res = cm->getNextResult();
+        ASSERT_EQ(stream->getId(), res.getId());
+        ASSERT_EQ(100000.0, res.getResult());
+        res = cm->getNextResult();
+        ASSERT_EQ(multId, res.getId());
+        ASSERT_EQ(1024.0, res.getResult());
+        ASSERT_THROW(cm->openComputation(ComputationType::C), std::invalid_argument);
+
+        cm->stop();
+        a.join();
+        b.join();
+    })
+}
+
+/* An engine on a fiber parks while the stream is empty, the other fibers of its worker keep running */
+TEST(Streaming, FibersShouldParkOnEmptyStreams) {
+    ASSERT_DURATION_LE(2, {
+        auto cm = std::make_shared<ComputationManager>();
+        FiberScheduler scheduler(1);
+        ComputeEngineA a(cm, Granularity::byElements(256));
+        ComputeEngineB b(cm);
+        a.startFiber(scheduler);
+        b.startFiber(scheduler);
+        scheduler.start();
+
+        auto const stream = cm->openComputation(ComputationType::A);
+        ASSERT_TRUE(stream->append({1.0, 2.0, 3.0}));
+        Computation mult(ComputationType::B);
+        mult.data->assign(3, 2.0);
+        cm->requestComputation(mult);
+        ASSERT_TRUE(stream->append({4.0}));
+        stream->close();
+        ASSERT_EQ(10.0, cm->getNextResult().getResult());
+        ASSERT_EQ(8.0, cm->getNextResult().getResult());
+
+        cm->stop();
+        a.join();
+        b.join();
+        scheduler.join();
+    })
+}
+
+/* The client blocks on a full stream until it is aborted, the engine is released by the abort as well */
+TEST(Streaming, AbortShouldReleaseTheClientAndTheEngine) {
+    ASSERT_DURATION_LE(2, {
+        auto cm = std::make_shared<ComputationManager>();
+        auto const full = cm->openComputation(ComputationType::A, 100);
+        ASSERT_TRUE(full->append(std::vector<double>(100, 1.0)));
+        std::atomic<bool> appended = true;
+        std::thread client([&full, &appended] { appended = full->append(std::vector<double>(100, 1.0)); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        cm->abortComputation(full->getId());
+        client.join();
+        ASSERT_FALSE(appended);
+
+        ComputeEngineA a(cm, Granularity::byElements(256));
+        a.startThread();
+        auto const starved = cm->openComputation(ComputationType::A);
+        ASSERT_TRUE(starved->append({1.0}));
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        cm->abortComputation(starved->getId());
+        ASSERT_FALSE(starved->append({1.0}));
+
+        Computation sum(ComputationType::A);
+        sum.data->assign(10, 1.0);
+        cm->requestComputation(sum);
+        ASSERT_EQ(10.0, cm->getNextResult().getResult());
+
+        cm->stop();
+        a.join();
+    })
+}
+
+/* The engine reduces the span handed out by next() outside the monitor, a cancellation must not free it */
+TEST(Streaming, CancelShouldKeepTheSpanOfTheEngine) {
+    ASSERT_DURATION_LE(5, {
+        ComputationStream stream(0, 1000);
+        ASSERT_TRUE(stream.append(std::vector<double>(100, 1.0)));
+        ASSERT_TRUE(stream.append(std::vector<double>(100, 2.0)));
+        auto const span = stream.next();
+        ASSERT_EQ(100u, span.size);
+        stream.cancel();
+        ASSERT_TRUE(std::all_of(span.values, span.values + span.size, [](double x) { return x == 1.0; }));
+        stream.consume(span.size);
+        ASSERT_EQ(0u, stream.next().size);
+        ASSERT_FALSE(stream.append({1.0}));
+
+        // Aborted while the engine reduces a large chunk, at various points of the reduction
+        auto cm = std::make_shared<ComputationManager>();
+        ComputeEngineA a(cm, Granularity::byElements(std::size_t{1} << 22));
+        a.startThread();
+        for (int i = 0; i < 20; ++i) {
+            auto const large = cm->openComputation(ComputationType::A);
+            ASSERT_TRUE(large->append(std::vector<double>(std::size_t{1} << 20, 1.0)));
+            std::this_thread::sleep_for(std::chrono::microseconds(50 * i));
+            cm->abortComputation(large->getId());
+        }
+        Computation sum(ComputationType::A, {1.0, 2.0});
+        cm->requestComputation(std::move(sum));
+        ASSERT_EQ(3.0, cm->getNextResult().getResult());
+
+        cm->stop();
+        a.join();
+    })
+}
+
+/* The integer sums are exact beyond 2^53, also when they are combined from shards */
+TEST(ElementTypes, IntegerSumsShouldBeExact) {
+    ASSERT_DURATION_LE(2, {
+        auto cm = std::make_shared<ComputationManager>();
+        ComputeEngineA a1(cm, Granularity::byElements(100));
+        ComputeEngineA a2(cm, Granularity::byElements(100));
+        a1.startThread();
+        a2.startThread();
+
+        std::vector<std::int32_t> counters(1000, 3);
+        counters.back() = -1;
+        cm->requestComputation(Computation(ComputationType::A, counters));
+        auto res = cm->getNextResult();
+        ASSERT_EQ(2996, res.getExactResult());
+        ASSERT_EQ(2996.0, res.getResult());
+
+        constexpr std::int64_t BIG = std::int64_t{1} << 60;
+        std::vector<std::int64_t> large(2000, 1);
+        large.front() = BIG;
+        cm->setShardingPolicy(ComputationType::A, ShardingPolicy{ShardReduction::Sum, 4, 500});
+        cm->requestComputation(Computation(ComputationType::A, large));
+        res = cm->getNextResult();
+        ASSERT_EQ(ResultStatus::Ok, res.getStatus());
+        ASSERT_EQ(BIG + 1999, res.getExactResult());
+
+        std::vector<std::int64_t> overflowing(1000, std::numeric_limits<std::int64_t>::max() / 500);
+        cm->requestComputation(Computation(ComputationType::A, overflowing));
+        res = cm->getNextResult();
+        ASSERT_EQ(ResultStatus::Overflow, res.getStatus());
+        ASSERT_EQ(std::numeric_limits<double>::infinity(), res.getResult());
+        ASSERT_FALSE(res.getExactResult().has_value());
+
+        // Overflowing within a single engine, the wrapped integer sum is not returned
+        cm->setShardingPolicy(ComputationType::A, ShardingPolicy{});
+        std::vector<std::int64_t> underflowing(3, -1);
+        underflowing.front() = std::numeric_limits<std::int64_t>::min();
+        cm->requestComputation(Computation(ComputationType::A, underflowing));
+        res = cm->getNextResult();
+        ASSERT_EQ(ResultStatus::Overflow, res.getStatus());
+        ASSERT_EQ(-std::numeric_limits<double>::infinity(), res.getResult());
+
+        Computation doubles(ComputationType::A);
+        doubles.data->assign(10, 0.5);
+        cm->requestComputation(doubles);
+        ASSERT_FALSE(cm->getNextResult().getExactResult().has_value());
+
+        cm->stop();
+        a1.join();
+        a2.join();
+    })
+}
+
+/* Every reduction takes every element type, through its own kernels or through doubles */
+TEST(ElementTypes, ReductionsShouldTakeEveryElementType) {
+    std::vector<float> floats(1001);
+    std::iota(floats.begin(), floats.end(), 0.0f);
+    for (auto const level : {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512}) {
+        for (auto const mode : {SummationMode::Fast, SummationMode::Compensated}) {
+            SumAccumulator acc;
+            accumulateSum(acc, floats.data(), floats.size(), mode, level);
+            ASSERT_EQ(500500.0, acc.value());
+        }
+        std::vector<std::int32_t> integers(1001, -7);
+        SumAccumulator acc;
+        accumulateSum(acc, integers.data(), integers.size(), level);
+        ASSERT_EQ(-7007, acc.integer);
+    }
+
+    using MaxEngine = ReductionEngine<ComputationType::A, MaxReduction>;
+    ASSERT_DURATION_LE(2, {
+        auto cm = std::make_shared<ComputationManager>();
+        ComputeEngineB b(cm, Granularity::byElements(100));
+        MaxEngine max(cm, Granularity::byElements(100));
+        b.startThread();
+        max.startThread();
+
+        cm->requestComputation(Computation(ComputationType::B, std::vector<std::int32_t>(10, 2)));
+        cm->requestComputation(Computation(ComputationType::A, floats));
+        cm->requestComputation(Computation(ComputationType::B, std::vector<float>(3, 0.5f)));
+        ASSERT_EQ(1024.0, cm->getNextResult().getResult());
+        ASSERT_EQ(1000.0, cm->getNextResult().getResult());
+        ASSERT_EQ(0.125, cm->getNextResult().getResult());
+        ASSERT_THROW(cm->requestComputation(Computation(ComputationType::C, std::vector<float>(2, 1.0f))), std::invalid_argument);
+
+        cm->stop();
+        b.join();
+        max.join();
+    })
+}
+
+/* A computation submitted as an rvalue hands its payload over to the engine, the payload is never shared */
+TEST(Handoff, MovedComputationsShouldNotSharePayload) {
+    ASSERT_DURATION_LE(1, {
+        ComputationManager cm;
+
+        Computation moved(ComputationType::A, 1000);
+        std::weak_ptr<std::vector<double>> payload = moved.data;
+        auto const elements = moved.data->data();
+        cm.requestComputation(std::move(moved));
+        ASSERT_EQ(1, payload.use_count()) << "Only the queued request should hold the payload";
+
+        auto request = cm.getWork(ComputationType::A);
+        ASSERT_EQ(1, payload.use_count());
+        ASSERT_EQ(static_cast<const void*>(elements), static_cast<const void*>(request.values()));
+
+        // A copied computation shares its payload with the client, the batches are moved out of the buffer
+        Computation copied(ComputationType::A, 1000);
+        cm.requestComputation(copied);
+        cm.requestComputation(Computation(ComputationType::A, 1000));
+        ASSERT_EQ(2, copied.data.use_count());
+        auto const batch = cm.getWorkBatch(ComputationType::A, 2);
+        ASSERT_EQ(2u, batch.size());
+        ASSERT_EQ(2, copied.data.use_count());
+        ASSERT_EQ(1, batch[1].data.use_count());
+    })
+}
+
+TEST(InlinePayload, SmallComputationsShouldNotAllocateAPayload) {
+    ASSERT_DURATION_LE(2, {
+        auto cm = std::make_shared<ComputationManager>();
+        ComputeEngineC c(cm);
+        BatchedComputeEngineC batched(cm);
+        ComputeEngineA a(cm);
+        c.startThread();
+        batched.startThread();
+        a.startThread();
+
+        Computation division(ComputationType::C, {6.0, 3.0});
+        ASSERT_TRUE(division.isInline());
+        ASSERT_EQ(nullptr, division.data);
+        ASSERT_EQ(2u, division.size());
+
+        // The operands are copied with the request, the computation may be gone before the engine reads them
+        for (int i = 0; i < 100; ++i) {
+            cm->requestComputation(Computation(ComputationType::C, {static_cast<double>(i), 2.0}));
+        }
+        cm->requestComputation(Computation(ComputationType::C, {1.0}));
+        for (int i = 0; i < 100; ++i) {
+            ASSERT_EQ(i / 2.0, cm->getNextResult().getResult());
+        }
+        ASSERT_EQ(ResultStatus::InvalidOperands, cm->getNextResult().getStatus());
+
+        Computation sum(ComputationType::A, {1.0, 2.0, 3.0, 4.0, 5.0});
+        ASSERT_FALSE(sum.isInline());
+        ASSERT_EQ(5u, sum.data->size());
+        cm->requestComputation(std::move(sum));
+        ASSERT_EQ(15.0, cm->getNextResult().getResult());
+
+        cm->stop();
+        c.join();
+        batched.join();
+        a.join();
+    })
+}
+
+TEST(BatchFile, RequestsAndResultsShouldRoundTrip) {
+    std::stringstream requests;
+    BatchRequestWriter requestWriter(requests);
+    requestWriter.write(Computation(ComputationType::C, {6.0, 3.0}));
+    requestWriter.write(Computation(ComputationType::A, std::vector<std::int32_t>{1, 2, 3}));
+    Computation product(ComputationType::B, 1000);
+    std::fill(product.data->begin(), product.data->end(), 1.0);
+    requestWriter.write(product);
+
+    BatchRequestReader requestReader(requests);
+    auto c = requestReader.next();
+    ASSERT_TRUE(c.has_value());
+    ASSERT_EQ(ComputationType::C, c->computationType);
+    ASSERT_EQ(2u, c->size());
+    ASSERT_EQ(3.0, c->values()[1]);
+    c = requestReader.next();
+    ASSERT_EQ(ElementType::Int32, c->getElementType());
+    ASSERT_EQ(3, static_cast<const std::int32_t*>(c->elements())[2]);
+    c = requestReader.next();
+    ASSERT_EQ(ComputationType::B, c->computationType);
+    ASSERT_EQ(1000u, c->size());
+    ASSERT_FALSE(requestReader.next().has_value());
+
+    std::stringstream results;
+    BatchResultWriter resultWriter(results);
+    resultWriter.write(Result(0, 2.0));
+    Result exact(1, 6.0);
+    exact.setExactResult(6);
+    resultWriter.write(exact);
+    resultWriter.write(Result(2, NAN, ResultStatus::InvalidOperands));
+
+    BatchResultReader resultReader(results);
+    ASSERT_EQ(2.0, resultReader.next()->getResult());
+    ASSERT_EQ(6, resultReader.next()->getExactResult());
+    auto const invalid = resultReader.next();
+    ASSERT_EQ(2, invalid->getId());
+    ASSERT_EQ(ResultStatus::InvalidOperands, invalid->getStatus());
+    ASSERT_FALSE(resultReader.next().has_value());
+
+    // Not a request file, then a truncated one
+    std::stringstream wrongFile(results.str());
+    ASSERT_THROW(BatchRequestReader{wrongFile}, std::runtime_error);
+    std::stringstream truncated(requests.str().substr(0, requests.str().size() - 1));
+    BatchRequestReader truncatedReader(truncated);
+    truncatedReader.next();
+    truncatedReader.next();
+    ASSERT_THROW(truncatedReader.next(), std::runtime_error);
+}
+
+TEST(ResultSink, SlowOutputsShouldGetEveryResultInOrder) {
+    ASSERT_DURATION_LE(5, {
+        auto cm = std::make_shared<ComputationManager>();
+        ComputeEngineC c(cm);
+        c.startThread();
+
+        std::vector<int> ids;
+        ResultSink sink(cm, [&ids](const Result* results, std::size_t count) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            for (std::size_t i = 0; i < count; ++i) {
+                ids.push_back(results[i].getId());
+            }
+        }, SinkPolicy{8, 4, OverflowPolicy::Block});
+        sink.startThread();
+
+        for (int i = 0; i < 200; ++i) {
+            cm->requestComputation(Computation(ComputationType::C, {1.0, 2.0}));
+        }
+        while (sink.getStats().written < 200) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        cm->stop();
+        sink.join();
+        c.join();
+
+        auto const stats = sink.getStats();
+        ASSERT_EQ(0u, stats.dropped);
+        ASSERT_GT(stats.stalls, 0u);
+        ASSERT_EQ(200u, ids.size());
+        for (int i = 0; i < 200; ++i) {
+            ASSERT_EQ(i, ids[static_cast<std::size_t>(i)]);
+        }
+    })
+}
+
+TEST(ResultSink, DropPolicyShouldKeepDrainingTheManager) {
+    ASSERT_DURATION_LE(5, {
+        auto cm = std::make_shared<ComputationManager>();
+        ComputeEngineC c(cm);
+        c.startThread();
+
+        // The output is stuck until every result left the manager
+        PcoSemaphore unblock(0);
+        std::vector<int> ids;
+        ResultSink sink(cm, [&](const Result* results, std::size_t count) {
+            if (ids.empty()) {
+                unblock.acquire();
+            }
+            for (std::size_t i = 0; i < count; ++i) {
+                ids.push_back(results[i].getId());
+            }
+        }, SinkPolicy{4, 1, OverflowPolicy::DropNewest});
+        sink.startThread();
+
+        for (int i = 0; i < 50; ++i) {
+            cm->requestComputation(Computation(ComputationType::C, {1.0, 2.0}));
+        }
+        for (;;) {
+            auto const stats = sink.getStats();
+            if (stats.dropped + stats.buffered + 1 == 50) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        unblock.release();
+        while (sink.getStats().buffered > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        cm->stop();
+        sink.join();
+        c.join();
+
+        auto const stats = sink.getStats();
+        ASSERT_EQ(5u, stats.written);
+        ASSERT_EQ(45u, stats.dropped);
+        ASSERT_EQ(0u, stats.stalls);
+        ASSERT_TRUE(std::is_sorted(ids.begin(), ids.end()));
+    })
+}
+
+TEST(Dependencies, DependentComputationsShouldGetTheResultsOfTheirInputs) {
+    ASSERT_DURATION_LE(2, {
+        auto cm = std::make_shared<ComputationManager>();
+        ComputeEngineA a(cm);
+        ComputeEngineB b(cm);
+        ComputeEngineC c(cm);
+        a.startThread();
+        b.startThread();
+        c.startThread();
+
+        auto const sum = cm->requestComputation(Computation(ComputationType::A, {1.0, 2.0, 3.0, 4.0}));
+        auto const product = cm->requestComputation(Computation(ComputationType::B, {1.0, 2.0, 3.0, 4.0}));
+        Computation ratio(ComputationType::C);
+        ratio.inputs.assign({sum, product});
+        auto const ratioId = cm->requestComputation(ratio);
+        // The results of the inputs are appended to the elements
+        Computation shifted(ComputationType::A, {1.0});
+        shifted.inputs = {ratioId};
+        cm->requestComputation(shifted);
+
+        ASSERT_EQ(10.0, cm->getNextResult().getResult());
+        ASSERT_EQ(24.0, cm->getNextResult().getResult());
+        ASSERT_EQ(10.0 / 24.0, cm->getNextResult().getResult());
+        ASSERT_EQ(1.0 + 10.0 / 24.0, cm->getNextResult().getResult());
+
+        // The graph refers to its own nodes, the ids are given back in the same order
+        std::vector<Computation> graph;
+        graph.emplace_back(ComputationType::A, std::initializer_list<double>{2.0, 4.0});
+        graph.emplace_back(ComputationType::B, std::initializer_list<double>{2.0, 4.0});
+        graph.emplace_back(ComputationType::C);
+        graph.back().inputs.assign({1, 0});
+        auto const ids = cm->requestGraph(std::move(graph));
+        ASSERT_EQ(3u, ids.size());
+        ASSERT_EQ(ids[0] + 2, ids[2]);
+        ASSERT_EQ(6.0, cm->getNextResult().getResult());
+        ASSERT_EQ(8.0, cm->getNextResult().getResult());
+        auto const last = cm->getNextResult();
+        ASSERT_EQ(ids[2], last.getId());
+        ASSERT_EQ(8.0 / 6.0, last.getResult());
+
+        // A consumed result can not be an input anymore, and a graph node can only depend on earlier ones
+        Computation late(ComputationType::C);
+        late.inputs = {sum};
+        ASSERT_THROW(cm->requestComputation(late), std::invalid_argument);
+        std::vector<Computation> cyclic(1, Computation(ComputationType::C));
+        cyclic[0].inputs = {0};
+        ASSERT_THROW(cm->requestGraph(cyclic), std::invalid_argument);
+
+        cm->stop();
+        a.join();
+        b.join();
+        c.join();
+    })
+}
+
+TEST(Dependencies, AbortShouldPropagateToTheDependentComputations) {
+    ASSERT_DURATION_LE(3, {
+        auto cm = std::make_shared<ComputationManager>();
+        TestComputeEngine slow(cm, ComputationType::A, 100, 10);
+        ComputeEngineB b(cm);
+        ComputeEngineC c(cm);
+        slow.startThread();
+        b.startThread();
+        c.startThread();
+
+        auto const root = cm->requestComputation(Computation(ComputationType::A, {1.0}));
+        Computation child(ComputationType::C, {1.0});
+        child.inputs = {root};
+        auto const childId = cm->requestComputation(child);
+        Computation grandChild(ComputationType::B);
+        grandChild.inputs.assign({childId, childId});
+        cm->requestComputation(grandChild);
+        auto const independent = cm->requestComputation(Computation(ComputationType::C, {3.0, 2.0}));
+
+        cm->abortComputation(root);
+        auto const next = cm->getNextResult();
+        ASSERT_EQ(independent, next.getId());
+        ASSERT_EQ(1.5, next.getResult());
+
+        cm->stop();
+        slow.join();
+        b.join();
+        c.join();
+    })
+}
+
+/* A released computation does not fill its buffer beyond its capacity, it waits for the next freed slot */
+TEST(Dependencies, ReleasedComputationsShouldWaitForASlot) {
+    ASSERT_DURATION_LE(2, {
+        auto cm = std::make_shared<ComputationManager>(1);
+
+        auto const root = cm->requestComputation(Computation(ComputationType::A, {1.0, 2.0}));
+        for (int i = 0; i < 2; ++i) {
+            Computation child(ComputationType::B, {2.0});
+            child.inputs = {root};
+            cm->requestComputation(child);
+        }
+        cm->requestComputation(Computation(ComputationType::B, {5.0}));
+
+        // The root releases both children while the buffer of B is full
+        ComputeEngineA a(cm);
+        a.startThread();
+        ASSERT_EQ(3.0, cm->getNextResult().getResult());
+        ASSERT_EQ(1u, cm->getQueueStats(ComputationType::B).queuedRequests);
+
+        ComputeEngineB b(cm);
+        b.startThread();
+        for (auto const expected : {6.0, 6.0, 5.0}) {
+            ASSERT_EQ(expected, cm->getNextResult().getResult());
+            ASSERT_LE(cm->getQueueStats(ComputationType::B).queuedRequests, 1u);
+        }
+
+        cm->stop();
+        a.join();
+        b.join();
+    })
+}
+
+TEST(ElementMap, OperationsShouldApplyInOrder) {
+    auto const map = ElementMap().offset(-1.0).square().scale(0.5);
+    ASSERT_EQ(3u, map.size());
+    ASSERT_EQ(2.0, map(3.0));
+    ASSERT_EQ(0.0, map(1.0));
+    ASSERT_EQ(4.0, ElementMap().abs()(-4.0));
+    ASSERT_EQ(-4.0, ElementMap()(-4.0));
+
+    std::vector<double> in{-2.0, -1.0, 0.0, 1.0, 2.0};
+    std::vector<double> out(in.size());
+    ElementMap().abs().offset(1.0).apply(in.data(), out.data(), in.size());
+    ASSERT_EQ((std::vector<double>{3.0, 2.0, 1.0, 2.0, 3.0}), out);
+
+    ASSERT_THROW(static_cast<void>(map.abs().abs()), std::length_error);
+}
+
+TEST(ElementMap, ReductionsShouldBeFusedWithTheMap) {
+    ASSERT_DURATION_LE(5, {
+        auto cm = std::make_shared<ComputationManager>();
+        ComputeEngineA a(cm, Granularity::byElements(100));
+        ComputeEngineB b(cm);
+        a.startThread();
+        b.startThread();
+
+        // Sum of squares over several blocks and chunks, the elements themselves are left untouched
+        Computation squares(ComputationType::A, 1000);
+        std::iota(squares.data->begin(), squares.data->end(), 1.0);
+        squares.map = ElementMap().square();
+        auto const payload = squares.data;
+        cm->requestComputation(squares);
+        ASSERT_EQ(1000.0 * 1001.0 * 2001.0 / 6.0, cm->getNextResult().getResult());
+        ASSERT_EQ(1000.0, payload->back());
+
+        // Integer elements are reduced as doubles once mapped, there is no exact result
+        Computation norm(ComputationType::A, std::vector<std::int32_t>{-3, 4, -5});
+        norm.map = ElementMap().abs();
+        cm->requestComputation(std::move(norm));
+        auto const result = cm->getNextResult();
+        ASSERT_EQ(12.0, result.getResult());
+        ASSERT_FALSE(result.getExactResult().has_value());
+
+        Computation product(ComputationType::B, {-1.0, -2.0, -3.0, -4.0, -5.0});
+        product.map = ElementMap().abs().offset(1.0);
+        cm->requestComputation(std::move(product));
+        ASSERT_EQ(720.0, cm->getNextResult().getResult());
+
+        // Each shard applies the map to its own elements
+        cm->setShardingPolicy(ComputationType::A, ShardingPolicy{ShardReduction::Sum, 4, 100});
+        Computation sharded(ComputationType::A, 1000);
+        std::fill(sharded.data->begin(), sharded.data->end(), -2.0);
+        sharded.map = ElementMap().scale(-0.5);
+        cm->requestComputation(std::move(sharded));
+        ASSERT_EQ(1000.0, cm->getNextResult().getResult());
+
+        Computation division(ComputationType::C, {6.0, 3.0});
+        division.map = ElementMap().square();
+        ASSERT_THROW(cm->requestComputation(std::move(division)), std::invalid_argument);
+
+        cm->stop();
+        a.join();
+        b.join();
+    })
+}
+
+TEST(Aggregates, OneRequestShouldGiveEveryAggregateAskedFor) {
+    ASSERT_DURATION_LE(5, {
+        auto cm = std::make_shared<ComputationManager>();
+        ComputeEngineD d(cm, Granularity::byElements(1000));
+        d.startThread();
+
+        // Several blocks and chunks
+        Computation all(ComputationType::D, 5000);
+        std::iota(all.data->begin(), all.data->end(), -2499.0);
+        cm->requestComputation(all);
+        auto result = cm->getNextResult();
+        ASSERT_TRUE(result.getAggregates().has_value());
+        auto aggregates = *result.getAggregates();
+        ASSERT_EQ(2500.0, aggregates.sum);
+        ASSERT_EQ(0.0, aggregates.product);
+        ASSERT_EQ(-2499.0, aggregates.min);
+        ASSERT_EQ(2500.0, aggregates.max);
+        ASSERT_EQ(5000u, aggregates.count);
+        ASSERT_EQ(2500.0, result.getResult());
+
+        // The value of the result is the first aggregate asked for, the others are left untouched
+        Computation some(ComputationType::D, std::vector<std::int32_t>{3, -1, 2});
+        some.aggregates = Aggregate::Max | Aggregate::Count;
+        cm->requestComputation(std::move(some));
+        result = cm->getNextResult();
+        aggregates = *result.getAggregates();
+        ASSERT_TRUE(aggregates.computed.contains(Aggregate::Max));
+        ASSERT_FALSE(aggregates.computed.contains(Aggregate::Sum));
+        ASSERT_EQ(3.0, result.getResult());
+        ASSERT_EQ(3u, aggregates.count);
+        ASSERT_EQ(0.0, aggregates.sum);
+
+        // The element map is applied before every aggregate
+        Computation mapped(ComputationType::D, {-1.0, -2.0, -3.0});
+        mapped.map = ElementMap().abs();
+        cm->requestComputation(std::move(mapped));
+        aggregates = *cm->getNextResult().getAggregates();
+        ASSERT_EQ(6.0, aggregates.sum);
+        ASSERT_EQ(6.0, aggregates.product);
+        ASSERT_EQ(1.0, aggregates.min);
+
+        Computation large(ComputationType::D, 2000);
+        std::fill(large.data->begin(), large.data->end(), 1e300);
+        large.aggregates = Aggregate::Product | Aggregate::Min;
+        cm->requestComputation(std::move(large));
+        result = cm->getNextResult();
+        ASSERT_EQ(ResultStatus::Overflow, result.getStatus());
+        ASSERT_EQ(1e300, result.getAggregates()->min);
+
+        Computation none(ComputationType::D, {1.0});
+        none.aggregates = AggregateSet();
+        ASSERT_THROW(cm->requestComputation(std::move(none)), std::invalid_argument);
+        ASSERT_THROW(cm->setShardingPolicy(ComputationType::D, ShardingPolicy{ShardReduction::Sum, 4, 100}),
+                     std::invalid_argument);
+
+        // The results of the other types have no aggregates
+        ComputeEngineA a(cm);
+        a.startThread();
+        cm->requestComputation(Computation(ComputationType::A, {1.0, 2.0}));
+        ASSERT_FALSE(cm->getNextResult().getAggregates().has_value());
+
+        cm->stop();
+        d.join();
+        a.join();
+    })
+}
+
+/* A streamed D gives every aggregate of the elements appended in several chunks */
+TEST(Aggregates, StreamedComputationsShouldGiveEveryAggregate) {
+    ASSERT_DURATION_LE(2, {
+        auto cm = std::make_shared<ComputationManager>();
+        ComputeEngineD d(cm, Granularity::byElements(256));
+        d.startThread();
+
+        auto const stream = cm->openComputation(ComputationType::D, 2000);
+        for (int i = 0; i < 10; ++i) {
+            ASSERT_TRUE(stream->append(std::vector<double>(1000, i % 2 ? 3.0 : -1.0)));
+        }
+        stream->close();
+
+        auto const result = cm->getNextResult();
+        ASSERT_EQ(stream->getId(), result.getId());
+        ASSERT_TRUE(result.getAggregates().has_value());
+        auto const aggregates = *result.getAggregates();
+        for (auto aggregate : {Aggregate::Sum, Aggregate::Product, Aggregate::Min, Aggregate::Max, Aggregate::Count}) {
+            ASSERT_TRUE(aggregates.computed.contains(aggregate));
+        }
+        ASSERT_EQ(10000.0, aggregates.sum);
+        ASSERT_EQ(ResultStatus::Overflow, result.getStatus()) << "3^5000 is out of range";
+        ASSERT_EQ(-1.0, aggregates.min);
+        ASSERT_EQ(3.0, aggregates.max);
+        ASSERT_EQ(10000u, aggregates.count);
+
+        cm->stop();
+        d.join();
+    })
+}
+
 int main(int argc, char **argv) {
     testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
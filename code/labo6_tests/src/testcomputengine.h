@@ -11,8 +11,8 @@ public:
 protected:
     ComputationType myType() const override {return type;}
 
-    void startComputation(const Request& r) override {
-        ComputeEngineCommon::startComputation(r);
+    void startComputation(Request r) override {
+        ComputeEngineCommon::startComputation(std::move(r));
         computationDone = false;
         result = getCurrentRequestId();
         stepCounter = steps;
@@ -0,0 +1,203 @@
+//     ____  __________     ___   ____ ___  _____ //
+//    / __ \/ ____/ __ \   |__ \ / __ \__ \|__  / //
+//   / /_/ / /   / / / /   __/ // / / /_/ / /_ <  //
+//  / ____/ /___/ /_/ /   / __// /_/ / __/___/ /  //
+// /_/    \____/\____/   /____/\____/____/____/   //
+// Auteurs : Timothée Van Hove, Aubry Mangold
+
+#ifndef AUTOSCALER_H
+#define AUTOSCALER_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "computationmanager.h"
+#include "launchable.h"
+
+/**
+ * @brief The ScalingPolicy struct sets the limits and the thresholds of the autoscaling of a computation type.
+ * An engine is added when requests wait for too long or when there are too many requests per engine, and one
+ * is retired once the type has been idle for a while. The cooldown between two changes and the idle delay
+ * give the hysteresis that keeps the pool from oscillating.
+ */
+struct ScalingPolicy
+{
+    unsigned minEngines = 1;
+    unsigned maxEngines = 4;
+
+    /**
+     * @brief scaleUpQueueLength The number of queued requests per engine above which an engine is added
+     */
+    std::size_t scaleUpQueueLength = 4;
+
+    /**
+     * @brief scaleUpWait The wait of the oldest queued request above which an engine is added
+     */
+    std::chrono::milliseconds scaleUpWait{50};
+
+    /**
+     * @brief scaleDownIdle For how long engines must have been waiting for work before one of them is retired
+     */
+    std::chrono::milliseconds scaleDownIdle{500};
+
+    /**
+     * @brief cooldown The minimum delay between two changes of the number of engines of the type
+     */
+    std::chrono::milliseconds cooldown{100};
+};
+
+/**
+ * @brief The Autoscaler class adjusts the number of compute engines of each type to the pressure on the
+ * buffer of the type. It samples the buffers periodically, starts engines when a type backs up and retires
+ * idle ones through ComputationManager::retireEngine().
+ * It stops once the computation manager is stopped, joining all of its engines.
+ * @note The autoscaler must own all the engines of the types it controls, a retirement may otherwise hit
+ * an engine that it does not know about.
+ */
+class Autoscaler : public Launchable
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief EngineFactory Creates a compute engine of a type, the autoscaler starts and joins it
+     */
+    using EngineFactory = std::function<std::shared_ptr<Launchable>()>;
+
+    explicit Autoscaler(std::shared_ptr<ComputationManager> computationManager,
+                        std::chrono::milliseconds period = std::chrono::milliseconds(10))
+        : computationManager(std::move(computationManager)), period(period) {}
+
+    /**
+     * @brief addType Puts the engines of a type under the control of the autoscaler
+     * @note Must be called before the autoscaler is started
+     * @param type the type of computation
+     * @param factory creates the engines of the type
+     * @param policy the limits and thresholds of the type
+     */
+    void addType(ComputationType type, EngineFactory factory, ScalingPolicy policy = {}) {
+        pools.push_back(std::make_unique<Pool>(type, std::move(factory), policy));
+    }
+
+    /**
+     * @brief engineCount Returns the number of running engines of a type that are not being retired
+     */
+    [[nodiscard]] unsigned engineCount(ComputationType type) const {
+        for (auto const& pool : pools) {
+            if (pool->type == type) {
+                return pool->active;
+            }
+        }
+        return 0;
+    }
+
+protected:
+    void run() override {
+        for (auto& pool : pools) {
+            while (pool->active < pool->policy.minEngines) {
+                startEngine(*pool, Clock::now());
+            }
+        }
+
+        try {
+            for (;;) {
+                auto const now = Clock::now();
+                for (auto& pool : pools) {
+                    reap(*pool);
+                    scale(*pool, computationManager->getQueueStats(pool->type), now);
+                }
+                PcoThread::usleep(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(period).count()));
+            }
+        } catch (ComputationManager::StopException& e) {
+            for (auto& pool : pools) {
+                for (auto& engine : pool->engines) {
+                    engine->join();
+                }
+                pool->engines.clear();
+                pool->active = 0;
+            }
+        }
+    }
+
+    void printStartMessage() const override {qDebug() << "[START] Autoscaler launched";}
+    void printCompletionMessage() const override {qDebug() << "[STOP] Autoscaler";}
+
+private:
+    /**
+     * @brief The Pool struct holds the engines of a type
+     */
+    struct Pool {
+        Pool(ComputationType type, EngineFactory factory, ScalingPolicy policy)
+            : type(type), factory(std::move(factory)), policy(policy) {}
+
+        const ComputationType type;
+        const EngineFactory factory;
+        const ScalingPolicy policy;
+        std::vector<std::shared_ptr<Launchable>> engines;
+        std::atomic<unsigned> active = 0;
+        unsigned retiring = 0;
+        Clock::time_point lastChange{};
+        std::optional<Clock::time_point> idleSince;
+    };
+
+    void startEngine(Pool& pool, Clock::time_point now) {
+        pool.engines.push_back(pool.factory());
+        pool.engines.back()->startThread();
+        ++pool.active;
+        pool.lastChange = now;
+    }
+
+    /**
+     * @brief reap Joins the engines of a pool that were retired
+     */
+    void reap(Pool& pool) {
+        for (auto it = pool.engines.begin(); it != pool.engines.end();) {
+            if ((*it)->isFinished()) {
+                (*it)->join();
+                it = pool.engines.erase(it);
+                --pool.retiring;
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void scale(Pool& pool, const QueueStats& stats, Clock::time_point now) {
+        auto const& policy = pool.policy;
+        auto const active = pool.active.load();
+        auto const cooledDown = now - pool.lastChange >= policy.cooldown;
+
+        auto const backedUp = stats.queuedRequests > policy.scaleUpQueueLength * active || stats.oldestWait > policy.scaleUpWait;
+        if (active < policy.maxEngines && backedUp && cooledDown) {
+            startEngine(pool, now);
+            pool.idleSince.reset();
+            return;
+        }
+
+        // Idle time is counted from the first sample where engines wait for work and nothing is queued
+        if (stats.queuedRequests > 0 || stats.idleEngines == 0) {
+            pool.idleSince.reset();
+            return;
+        }
+        if (!pool.idleSince) {
+            pool.idleSince = now;
+        }
+        if (active > policy.minEngines && cooledDown && now - *pool.idleSince >= policy.scaleDownIdle) {
+            computationManager->retireEngine(pool.type);
+            --pool.active;
+            ++pool.retiring;
+            pool.lastChange = now;
+            pool.idleSince = now;
+        }
+    }
+
+    const std::shared_ptr<ComputationManager> computationManager;
+    const std::chrono::milliseconds period;
+    std::vector<std::unique_ptr<Pool>> pools;
+};
+
+#endif // AUTOSCALER_H
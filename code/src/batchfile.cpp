@@ -0,0 +1,171 @@
+//     ____  __________     ___   ____ ___  _____ //
+//    / __ \/ ____/ __ \   |__ \ / __ \__ \|__  / //
+//   / /_/ / /   / / / /   __/ // / / /_/ / /_ <  //
+//  / ____/ /___/ /_/ /   / __// /_/ / __/___/ /  //
+// /_/    \____/\____/   /____/\____/____/____/   //
+// Auteurs : Timothée Van Hove, Aubry Mangold
+
+#include "batchfile.h"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+constexpr char REQUEST_MAGIC[4] = {'P', 'C', 'O', 'Q'};
+constexpr char RESULT_MAGIC[4] = {'P', 'C', 'O', 'R'};
+constexpr std::uint32_t VERSION = 1;
+
+struct FileHeader
+{
+    char magic[4];
+    std::uint32_t version;
+};
+
+struct RequestHeader
+{
+    std::uint8_t type;
+    std::uint8_t elementType;
+    std::uint8_t padding[6];
+    std::uint64_t count;
+};
+
+struct ResultRecord
+{
+    std::int32_t id;
+    std::uint8_t status;
+    std::uint8_t hasExact;
+    std::uint8_t padding[2];
+    double result;
+    std::int64_t exact;
+};
+
+static_assert(sizeof(FileHeader) == 8 && sizeof(RequestHeader) == 16 && sizeof(ResultRecord) == 24,
+              "The records must match the file format");
+
+void readBytes(std::istream& in, void* bytes, std::size_t size, const char* what) {
+    in.read(static_cast<char*>(bytes), static_cast<std::streamsize>(size));
+    if (static_cast<std::size_t>(in.gcount()) != size) {
+        throw std::runtime_error(std::string("Truncated ") + what);
+    }
+}
+
+void writeBytes(std::ostream& out, const void* bytes, std::size_t size) {
+    out.write(static_cast<const char*>(bytes), static_cast<std::streamsize>(size));
+    if (!out) {
+        throw std::runtime_error("Could not write the batch file");
+    }
+}
+
+void readHeader(std::istream& in, const char (&magic)[4], const char* what) {
+    FileHeader header{};
+    readBytes(in, &header, sizeof(header), what);
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != VERSION) {
+        throw std::runtime_error(std::string("Not a ") + what + " (or not of version " + std::to_string(VERSION) + ")");
+    }
+}
+
+void writeHeader(std::ostream& out, const char (&magic)[4]) {
+    FileHeader header{};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = VERSION;
+    writeBytes(out, &header, sizeof(header));
+}
+
+bool atEnd(std::istream& in) {
+    return in.peek() == std::istream::traits_type::eof();
+}
+
+template <typename T>
+Computation readTyped(std::istream& in, ComputationType type, std::size_t count) {
+    std::vector<T> elements(count);
+    readBytes(in, elements.data(), count * sizeof(T), "request file");
+    return Computation(type, std::move(elements));
+}
+
+std::size_t elementSize(ElementType type) {
+    switch (type) {
+    case ElementType::Float32:
+    case ElementType::Int32: return 4;
+    default:                 return 8;
+    }
+}
+
+} // namespace
+
+BatchRequestReader::BatchRequestReader(std::istream& in): in(in) {
+    readHeader(in, REQUEST_MAGIC, "request file");
+}
+
+std::optional<Computation> BatchRequestReader::next() {
+    if (atEnd(in)) {
+        return std::nullopt;
+    }
+
+    RequestHeader header{};
+    readBytes(in, &header, sizeof(header), "request file");
+    if (header.type >= static_cast<std::uint8_t>(ComputationType::COUNT) ||
+        header.elementType > static_cast<std::uint8_t>(ElementType::Int64)) {
+        throw std::runtime_error("Malformed request in the request file");
+    }
+
+    auto const type = static_cast<ComputationType>(header.type);
+    auto const count = static_cast<std::size_t>(header.count);
+    switch (static_cast<ElementType>(header.elementType)) {
+    case ElementType::Float32: return readTyped<float>(in, type, count);
+    case ElementType::Int32:   return readTyped<std::int32_t>(in, type, count);
+    case ElementType::Int64:   return readTyped<std::int64_t>(in, type, count);
+    default: {
+        // The doubles are read into the pooled payload, they are not copied afterwards
+        Computation c(type, count);
+        readBytes(in, c.data->data(), count * sizeof(double), "request file");
+        return c;
+    }
+    }
+}
+
+BatchRequestWriter::BatchRequestWriter(std::ostream& out): out(out) {
+    writeHeader(out, REQUEST_MAGIC);
+}
+
+void BatchRequestWriter::write(const Computation& c) {
+    RequestHeader header{};
+    header.type = static_cast<std::uint8_t>(c.computationType);
+    header.elementType = static_cast<std::uint8_t>(c.getElementType());
+    header.count = c.size();
+    writeBytes(out, &header, sizeof(header));
+    writeBytes(out, c.elements(), c.size() * elementSize(c.getElementType()));
+}
+
+BatchResultReader::BatchResultReader(std::istream& in): in(in) {
+    readHeader(in, RESULT_MAGIC, "result file");
+}
+
+std::optional<Result> BatchResultReader::next() {
+    if (atEnd(in)) {
+        return std::nullopt;
+    }
+
+    ResultRecord record{};
+    readBytes(in, &record, sizeof(record), "result file");
+    Result result(record.id, record.result, static_cast<ResultStatus>(record.status));
+    if (record.hasExact != 0) {
+        result.setExactResult(record.exact);
+    }
+    return result;
+}
+
+BatchResultWriter::BatchResultWriter(std::ostream& out): out(out) {
+    writeHeader(out, RESULT_MAGIC);
+}
+
+void BatchResultWriter::write(const Result& result) {
+    ResultRecord record{};
+    record.id = result.getId();
+    record.status = static_cast<std::uint8_t>(result.getStatus());
+    record.hasExact = result.getExactResult().has_value() ? 1 : 0;
+    record.result = result.getResult();
+    record.exact = result.getExactResult().value_or(0);
+    writeBytes(out, &record, sizeof(record));
+}
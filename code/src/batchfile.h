@@ -0,0 +1,115 @@
+//     ____  __________     ___   ____ ___  _____ //
+//    / __ \/ ____/ __ \   |__ \ / __ \__ \|__  / //
+//   / /_/ / /   / / / /   __/ // / / /_/ / /_ <  //
+//  / ____/ /___/ /_/ /   / __// /_/ / __/___/ /  //
+// /_/    \____/\____/   /____/\____/____/____/   //
+// Auteurs : Timothée Van Hove, Aubry Mangold
+
+// Binary files of requests and results, used by the batch runner (labo6_batch).
+//
+// Both files start with a header of 8 bytes: a magic of 4 characters ("PCOQ" for requests, "PCOR" for
+// results) and a version on 4 bytes. All the numbers are stored in the native byte order.
+//
+// A request record is a header of 16 bytes followed by its elements:
+//   type (1 byte: 0 = A, 1 = B, 2 = C, 3 = D), element type (1 byte, see ElementType), 6 bytes of padding,
+//   number of elements (8 bytes), then the elements (8 bytes per double or int64, 4 per float or int32)
+// A computation of type D gives every aggregate, only its value (the sum) is stored in the result file.
+//
+// A result record has 24 bytes:
+//   id (4 bytes), status (1 byte, see ResultStatus), 1 if the exact result is set (1 byte), 2 bytes of
+//   padding, result (8 bytes double), exact result (8 bytes, 0 if not set)
+
+#ifndef BATCHFILE_H
+#define BATCHFILE_H
+
+#include <istream>
+#include <optional>
+#include <ostream>
+
+#include "computationmanager.h"
+
+/**
+ * @brief The BatchRequestReader class reads the computations of a request file one by one, the elements of
+ * a computation are read directly into its payload
+ */
+class BatchRequestReader
+{
+public:
+    /**
+     * @brief BatchRequestReader Reads the header of the file, throws std::runtime_error if it is not a request file
+     */
+    explicit BatchRequestReader(std::istream& in);
+
+    /**
+     * @brief next Reads the next computation
+     * @return the computation, empty at the end of the file. Throws std::runtime_error if the record is
+     * malformed or truncated.
+     */
+    std::optional<Computation> next();
+
+private:
+    std::istream& in;
+};
+
+/**
+ * @brief The BatchRequestWriter class writes computations to a request file
+ */
+class BatchRequestWriter
+{
+public:
+    /**
+     * @brief BatchRequestWriter Writes the header of the file
+     */
+    explicit BatchRequestWriter(std::ostream& out);
+
+    /**
+     * @brief write Appends a computation, throws std::runtime_error if the stream fails
+     */
+    void write(const Computation& c);
+
+private:
+    std::ostream& out;
+};
+
+/**
+ * @brief The BatchResultReader class reads the results of a result file one by one
+ */
+class BatchResultReader
+{
+public:
+    /**
+     * @brief BatchResultReader Reads the header of the file, throws std::runtime_error if it is not a result file
+     */
+    explicit BatchResultReader(std::istream& in);
+
+    /**
+     * @brief next Reads the next result
+     * @return the result, empty at the end of the file. Throws std::runtime_error if the record is truncated.
+     */
+    std::optional<Result> next();
+
+private:
+    std::istream& in;
+};
+
+/**
+ * @brief The BatchResultWriter class writes results to a result file
+ */
+class BatchResultWriter
+{
+public:
+    /**
+     * @brief BatchResultWriter Writes the header of the file
+     */
+    explicit BatchResultWriter(std::ostream& out);
+
+    /**
+     * @brief write Appends a result, throws std::runtime_error if the stream fails
+     */
+    void write(const Result& result);
+
+private:
+    std::ostream& out;
+};
+
+#endif // BATCHFILE_H
@@ -14,10 +14,151 @@
 #include "computationmanager.h"
 
 #include <algorithm>
+#include <stdexcept>
+
+#include "fiber.h"
+#include "kernels.h"
+
+namespace {
+
+/**
+ * @brief toProduct Returns the product accumulator holding the value of a partial product
+ */
+ProductAccumulator toProduct(const Result& partial) {
+    ProductAccumulator product;
+    auto const value = partial.getResult();
+    accumulateProduct(product, &value, 1, SimdLevel::Scalar);
+    product.exponent += partial.getExponent();
+    return product;
+}
+
+/**
+ * @brief combinePartials Combines the partial results of two neighbouring shards
+ */
+Result combinePartials(ShardReduction reduction, const Result& left, const Result& right) {
+    auto const status = left.getStatus() != ResultStatus::Ok ? left.getStatus() : right.getStatus();
+    auto const a = left.getResult();
+    auto const b = right.getResult();
+    switch (reduction) {
+    case ShardReduction::Sum: {
+        auto sum = Result::partial(left.getId(), left.getShard(), a + b, 0, status);
+        // The exact sums of integer shards stay exact unless they overflow together
+        std::int64_t exact = 0;
+        if (left.getExactResult() && right.getExactResult()) {
+            if (__builtin_add_overflow(*left.getExactResult(), *right.getExactResult(), &exact)) {
+                auto const infinity = std::copysign(std::numeric_limits<double>::infinity(), a + b);
+                return Result::partial(left.getId(), left.getShard(), infinity, 0, ResultStatus::Overflow);
+            }
+            sum.setExactResult(exact);
+        }
+        return sum;
+    }
+    case ShardReduction::Min: return Result::partial(left.getId(), left.getShard(), b < a ? b : a, 0, status);
+    case ShardReduction::Max: return Result::partial(left.getId(), left.getShard(), b > a ? b : a, 0, status);
+    default: break;
+    }
+
+    auto product = toProduct(left);
+    accumulateProduct(product, &b, 1, SimdLevel::Scalar);
+    product.exponent += right.getExponent();
+
+    // Zeros, NaNs and infinities are final, their exponent is meaningless
+    if (product.isFinal() || product.infinite || product.mantissa == 0.0) {
+        return Result::partial(left.getId(), left.getShard(), product.value(), 0, status);
+    }
+    return Result::partial(left.getId(), left.getShard(), product.mantissa, product.exponent, status);
+}
+
+/**
+ * @brief combineShards Combines the partial results of all the shards of a computation. The partial results
+ * are combined pairwise in a binary tree over the shard indices, the result is thus always the same.
+ */
+Result combineShards(ShardReduction reduction, std::vector<Result> partials) {
+    while (partials.size() > 1) {
+        std::vector<Result> combined;
+        combined.reserve((partials.size() + 1) / 2);
+        for (std::size_t i = 0; i + 1 < partials.size(); i += 2) {
+            combined.push_back(combinePartials(reduction, partials[i], partials[i + 1]));
+        }
+        if (partials.size() % 2 != 0) {
+            combined.push_back(partials.back());
+        }
+        partials = std::move(combined);
+    }
+
+    auto const& partial = partials.front();
+    if (reduction != ShardReduction::Product) {
+        Result result(partial.getId(), partial.getResult(), partial.getStatus());
+        result.setExactResult(partial.getExactResult());
+        return result;
+    }
+
+    auto const product = toProduct(partial);
+    auto const status = partial.getStatus() != ResultStatus::Ok ? partial.getStatus()
+                      : product.overflows()                    ? ResultStatus::Overflow
+                      : product.underflows()                   ? ResultStatus::Underflow
+                                                               : ResultStatus::Ok;
+    return Result(partial.getId(), product.value(), status);
+}
+
+} // namespace
 
-ComputationManager::ComputationManager(int maxQueueSize) : MAX_TOLERATED_QUEUE_SIZE(maxQueueSize) {}
+ComputationManager::ComputationManager(int maxQueueSize, WaitStrategy waitStrategy)
+    : MAX_TOLERATED_QUEUE_SIZE(maxQueueSize), waitStrategy(waitStrategy) {
+    typeWeights.fill(1.0);
+}
 
 int ComputationManager::requestComputation(Computation c) {
+    checkComputation(c);
+
+    monitorIn();
+
+    if (!c.inputs.empty()) {
+        if (stopped) {
+            monitorOut();
+            throwStopException();
+        }
+
+        // The results of the inputs must still be known, they are gone once consumed by the client.
+        for (auto const input : c.inputs) {
+            if (findResult(input) == resultsQueue.end()) {
+                monitorOut();
+                throw std::invalid_argument("The input " + std::to_string(input) + " is unknown, aborted or its result was consumed");
+            }
+        }
+
+        // A dependent computation takes no slot of the buffer until it is released.
+        auto const id = nextId++;
+        resultsQueue.emplace_front(id);
+        updateNextResultReady();
+        auto inputs = std::move(c.inputs);
+        addDependent(std::move(c), id, inputs);
+
+        monitorOut();
+        return id;
+    }
+
+    waitForSlot(c.computationType);
+
+    auto const id = nextId++;
+    resultsQueue.emplace_front(id);
+    updateNextResultReady();
+    enqueue(std::move(c), id);
+
+    monitorOut();
+    return id;
+}
+
+std::vector<int> ComputationManager::requestGraph(std::vector<Computation> graph) {
+    for (std::size_t i = 0; i < graph.size(); ++i) {
+        checkComputation(graph[i]);
+        for (auto const input : graph[i].inputs) {
+            if (input < 0 || static_cast<std::size_t>(input) >= i) {
+                throw std::invalid_argument("The inputs of a node of a graph must be earlier nodes of the graph");
+            }
+        }
+    }
+
     monitorIn();
 
     if (stopped) {
@@ -25,28 +166,71 @@ int ComputationManager::requestComputation(Computation c) {
         throwStopException();
     }
 
-    // Check if the queue is full and if so, wait for it to be not full.
-    if (requestsBuffer[c.computationType].size() >= MAX_TOLERATED_QUEUE_SIZE) {
-        wait(notFullConditions[c.computationType]);
+    // Every node is known before the first one is queued, the result of a node can thus not be consumed
+    // before the nodes depending on it are waiting for it.
+    auto const first = nextId;
+    nextId += static_cast<int>(graph.size());
+    std::vector<int> ids;
+    for (std::size_t i = 0; i < graph.size(); ++i) {
+        ids.push_back(first + static_cast<int>(i));
+        resultsQueue.emplace_front(ids.back());
+    }
+    updateNextResultReady();
 
-        // Re-checking is mandatory here since the condition may have been signaled by the stop() method.
-        if (stopped) {
-            signal(notFullConditions[c.computationType]);
-            monitorOut();
-            throwStopException();
+    std::vector<bool> roots;
+    for (auto const& c : graph) {
+        roots.push_back(c.inputs.empty());
+    }
+    for (std::size_t i = 0; i < graph.size(); ++i) {
+        if (!roots[i]) {
+            std::vector<int> inputs;
+            for (auto const input : graph[i].inputs) {
+                inputs.push_back(ids[static_cast<std::size_t>(input)]);
+            }
+            addDependent(std::move(graph[i]), ids[i], inputs);
+        }
+    }
+
+    // The nodes without inputs wait for their slot like any request, they may be aborted meanwhile.
+    for (std::size_t i = 0; i < graph.size(); ++i) {
+        if (roots[i]) {
+            waitForSlot(graph[i].computationType);
+            auto const id = ids[i];
+            if (findResult(id) != resultsQueue.end()) {
+                enqueue(std::move(graph[i]), id);
+            }
         }
     }
 
-    // Insert the request in the queue and prepare a result for it.
+    monitorOut();
+    return ids;
+}
+
+std::shared_ptr<ComputationStream> ComputationManager::openComputation(ComputationType computationType, std::size_t capacity) {
+    if (computationType == ComputationType::C) {
+        throw std::invalid_argument("Only the computations reduced by the engines can be streamed");
+    }
+
+    monitorIn();
+
+    waitForSlot(computationType);
+
+    // The request is queued right away, the engine that takes it waits for the chunks of the client.
     auto const id = nextId++;
-    requestsBuffer[c.computationType].emplace_back(c, id);
+    auto stream = std::make_shared<ComputationStream>(id, capacity);
+    openStreams.emplace(id, stream);
+    auto& queue = requestsBuffer[computationType];
+    queue.emplace_back(stream, computationType);
+    queue.back().setEnqueueTime(std::chrono::steady_clock::now());
+    ++queuedComputations[computationType];
     resultsQueue.emplace_front(id);
-
-    // Signal that the queue is not empty.
-    signal(notEmptyConditions[c.computationType]);
+    updatePendingRequests(computationType);
+    updateNextResultReady();
+    requestSpinners[computationType].recordArrival();
+    wakeEngines(computationType, 1);
 
     monitorOut();
-    return id;
+    return stream;
 }
 
 void ComputationManager::abortComputation(int id) {
@@ -58,17 +242,49 @@ void ComputationManager::abortComputation(int id) {
         return;
     }
 
+    // The computations depending on an aborted computation will never get their inputs, they are aborted too.
+    std::vector<int> toAbort{id};
+    while (!toAbort.empty()) {
+        auto const next = toAbort.back();
+        toAbort.pop_back();
+        if (!removeComputation(next)) {
+            continue;
+        }
+        if (auto const waiting = waitingOn.find(next); waiting != waitingOn.end()) {
+            for (auto const& [dependent, position] : waiting->second) {
+                toAbort.push_back(dependent);
+            }
+            waitingOn.erase(waiting);
+        }
+    }
+
+    monitorOut();
+}
+
+bool ComputationManager::removeComputation(int id) {
     // Remove the result from the results queue. By design, all known identifiers are in the results queue.
-    auto const resultToRemove =
-        std::remove_if(resultsQueue.begin(), resultsQueue.end(), [id](auto const& r) { return r.id == id; });
+    auto const resultToRemove = findResult(id);
 
     // Avoid unnecessary work if the id wasn't found i.e. if it is incorrect.
     if (resultToRemove == resultsQueue.end()) {
-        monitorOut();
-        return;
+        return false;
+    }
+
+    resultsQueue.erase(resultToRemove);
+    shardsInProgress.erase(id);
+    preemptionRequests.erase(id);
+    dependents.erase(id);
+    for (auto& released : releasedDependents) {
+        released.erase(std::remove_if(released.begin(), released.end(), [id](auto const& d) { return d.first == id; }),
+                       released.end());
     }
 
-    resultsQueue.erase(resultToRemove, resultsQueue.end());
+    // The client and the engine of a streamed computation may be waiting on its stream.
+    if (auto const stream = openStreams.find(id); stream != openStreams.end()) {
+        stream->second->cancel();
+        openStreams.erase(stream);
+    }
+    updateNextResultReady();
 
     // Look in each buffer for the request with the given id. If found, remove it and signal the notFull condition.
     for (std::size_t i = 0; i < TYPE_COUNT; ++i) {
@@ -76,19 +292,29 @@ void ComputationManager::abortComputation(int id) {
         auto const requestToRemove =
             std::remove_if(queue.begin(), queue.end(), [id](auto const& r) { return r.getId() == id; });
         
-        // Erase the request and signal if it was found in the current queue.
+        // Erase the request (all its remaining shards) and signal if it was found in the current queue. The
+        // computation only frees its slot if its last shard was still queued.
         if (requestToRemove != queue.end()) {
+            auto const freesSlot = std::any_of(requestToRemove, queue.end(), [](auto const& r) { return r.isLastShard(); });
             queue.erase(requestToRemove, queue.end());
-            signal(notFullConditions[i]);
+            updatePendingRequests(static_cast<ComputationType>(i));
+            if (freesSlot) {
+                freeSlot(static_cast<ComputationType>(i));
+            }
 
             break; // No need to continue if the request was found.
         }
     }
 
-    monitorOut();
+    return true;
 }
 
 Result ComputationManager::getNextResult() {
+    // Spin outside of the monitor for a short while, results of short computations often arrive right after.
+    if (waitStrategy == WaitStrategy::SpinThenPark) {
+        resultSpinner.spinUntil([this] { return nextResultReady.load(std::memory_order_acquire) || stopped; });
+    }
+
     monitorIn();
 
     if (stopped) {
@@ -110,42 +336,67 @@ Result ComputationManager::getNextResult() {
         }
     }
 
-    const auto& result = resultsQueue.back().value;
+    auto const result = resultsQueue.back().value;
     resultsQueue.pop_back();
+    updateNextResultReady();
 
     monitorOut();
     return result.value();
 }
 
 Request ComputationManager::getWork(ComputationType computationType) {
+    spinForWork(computationType);
+
     monitorIn();
 
-    if (stopped) {
-        monitorOut();
-        throwStopException();
-    }
+    waitForWork(computationType);
 
-    // Check whether the buffer is empty and if so, wait for it to be not empty.
-    if (requestsBuffer[computationType].empty()) {
-        wait(notEmptyConditions[computationType]);
+    auto request = takeRequest(computationType);
 
-        // Re-checking is mandatory here since the condition may have been signaled by the stop() method.
-        if (stopped) {
-            signal(notEmptyConditions[computationType]);
-            monitorOut();
-            throwStopException();
-        }
-    }
+    monitorOut();
+    return request;
+}
 
-    // Extract the request from the queue and signal that the queue is not full.
-    auto const request = requestsBuffer[computationType].front();
-    requestsBuffer[computationType].pop_front();
-    signal(notFullConditions[computationType]);
+Request ComputationManager::getWork(TypeMask computationTypes) {
+    spinForWork(computationTypes);
+
+    monitorIn();
+
+    waitForWork(computationTypes);
+
+    auto request = takeRequest(selectType(computationTypes));
 
     monitorOut();
     return request;
 }
 
+std::vector<Request> ComputationManager::getWorkBatch(ComputationType computationType, std::size_t maxCount) {
+    spinForWork(computationType);
+
+    monitorIn();
+
+    waitForWork(computationType);
+
+    // Extract as many requests as allowed at once.
+    auto& queue = requestsBuffer[computationType];
+    auto const count = std::min(std::max<std::size_t>(maxCount, 1), queue.size());
+    std::vector<Request> requests(std::make_move_iterator(queue.begin()),
+                                  std::make_move_iterator(queue.begin() + static_cast<std::ptrdiff_t>(count)));
+    queue.erase(queue.begin(), queue.begin() + static_cast<std::ptrdiff_t>(count));
+    updatePendingRequests(computationType);
+    auto const freed =
+        static_cast<std::size_t>(std::count_if(requests.begin(), requests.end(), [](auto const& r) { return r.isLastShard(); }));
+
+    // Each freed slot may release a waiting client. The slots are freed once all requests are extracted, a
+    // released client can thus never fill the queue beyond its capacity.
+    for (std::size_t i = 0; i < freed; ++i) {
+        freeSlot(computationType);
+    }
+
+    monitorOut();
+    return requests;
+}
+
 bool ComputationManager::continueWork(int id) {
     monitorIn();
 
@@ -156,24 +407,78 @@ bool ComputationManager::continueWork(int id) {
     }
 
     // Check whether the result for the work request is already available.
-    auto const inProgress =
-        std::any_of(resultsQueue.begin(), resultsQueue.end(), [id](auto const& r) { return r.id == id; });
+    auto const inProgress = findResult(id) != resultsQueue.end();
 
     monitorOut();
     return inProgress;
 }
 
+WorkDirective ComputationManager::workDirective(int id) {
+    monitorIn();
+
+    if (stopped) {
+        monitorOut();
+        return WorkDirective::Abort;
+    }
+
+    // The computation was aborted if it has no result entry anymore.
+    if (findResult(id) == resultsQueue.end()) {
+        monitorOut();
+        return WorkDirective::Abort;
+    }
+
+    // A preemption is handed to the first engine asking for the computation.
+    auto const yield = preemptionRequests.erase(id) > 0;
+
+    monitorOut();
+    return yield ? WorkDirective::Yield : WorkDirective::Continue;
+}
+
+void ComputationManager::yieldWork(Request request) {
+    monitorIn();
+
+    // The computation may have been aborted (or the buffer stopped) while it was being saved.
+    auto const id = request.getId();
+    if (stopped || findResult(id) == resultsQueue.end()) {
+        monitorOut();
+        return;
+    }
+
+    // The request goes to the end of the buffer so that the requests that were waiting behind it are served
+    // first. It never waits for a free slot, the engine giving it back must not block.
+    auto const type = request.getType();
+    if (request.isLastShard()) {
+        ++queuedComputations[type];
+    }
+    request.setEnqueueTime(std::chrono::steady_clock::now());
+    requestsBuffer[type].push_back(std::move(request));
+    updatePendingRequests(type);
+    wakeEngines(type, 1);
+
+    monitorOut();
+}
+
 void ComputationManager::provideResult(Result result) {
     monitorIn();
 
-    // Find the result based on its id.
-    auto const it = std::find_if(
-        resultsQueue.begin(), resultsQueue.end(), [result](auto const& r) { return r.id == result.getId(); });
+    if (result.isPartial()) {
+        storePartialResult(result);
+    } else {
+        storeResult(result);
+    }
 
-    // If the result was found, update the optional value.
-    if (it != resultsQueue.end()) {
-        it->value = result;
-        signal(resultAvailable);
+    monitorOut();
+}
+
+void ComputationManager::provideResults(std::vector<Result> results) {
+    monitorIn();
+
+    for (auto const& result : results) {
+        if (result.isPartial()) {
+            storePartialResult(result);
+        } else {
+            storeResult(result);
+        }
     }
 
     monitorOut();
@@ -187,8 +492,521 @@ void ComputationManager::stop() {
     // Start to cascade wake-up calls to all conditions so that threads may exit.
     auto const signalThread = [this](auto& c) { signal(c); };
     std::for_each(notEmptyConditions.begin(), notEmptyConditions.end(), signalThread);
+    std::for_each(anyNotEmptyConditions.begin(), anyNotEmptyConditions.end(), signalThread);
     std::for_each(notFullConditions.begin(), notFullConditions.end(), signalThread);
     signal(resultAvailable);
 
+    // Parked fibers are not waiting on a condition, they are all woken.
+    for (auto const& parked : parkedFibers) {
+        parked.fiber->unpark();
+    }
+    parkedFibers.clear();
+
+    for (auto const& [id, stream] : openStreams) {
+        stream->cancel();
+    }
+    openStreams.clear();
+
+    monitorOut();
+}
+
+void ComputationManager::setShardingPolicy(ComputationType computationType, ShardingPolicy policy) {
+    // Only the reductions of A and B have a ShardReduction combining their partial results: the two operands
+    // of a C would be split apart, and the partial result of a D only holds one value
+    auto const shardable = computationType == ComputationType::A || computationType == ComputationType::B;
+    if (!shardable && policy.maxShards > 1) {
+        throw std::invalid_argument("Only the computations of type A and B can be sharded");
+    }
+    // Min and Max suit the engines running other reductions, but a sum is never a product (and conversely)
+    auto const mismatched = (computationType == ComputationType::A && policy.reduction == ShardReduction::Product) ||
+                            (computationType == ComputationType::B && policy.reduction == ShardReduction::Sum);
+    if (mismatched && policy.maxShards > 1) {
+        throw std::invalid_argument("The shards of an A are combined by a sum (or min, max), those of a B by a product");
+    }
+
+    monitorIn();
+
+    shardingPolicies[computationType] = policy;
+
+    monitorOut();
+}
+
+void ComputationManager::setSelectionPolicy(SelectionPolicy policy) {
+    monitorIn();
+
+    selectionPolicy = policy;
+
     monitorOut();
 }
+
+void ComputationManager::setTypeWeight(ComputationType computationType, double weight) {
+    monitorIn();
+
+    typeWeights[computationType] = weight;
+
+    monitorOut();
+}
+
+QueueStats ComputationManager::getQueueStats(ComputationType computationType) {
+    monitorIn();
+
+    if (stopped) {
+        monitorOut();
+        throwStopException();
+    }
+
+    auto const& queue = requestsBuffer[computationType];
+    QueueStats stats;
+    stats.queuedRequests = queue.size();
+    stats.idleEngines = notEmptyWaiters[computationType] +
+        static_cast<std::size_t>(std::count_if(parkedFibers.begin(), parkedFibers.end(), [computationType](auto const& p) {
+            return p.types.getBits() == TypeMask(computationType).getBits();
+        }));
+    if (!queue.empty()) {
+        stats.oldestWait = std::chrono::steady_clock::now() - queue.front().getEnqueueTime();
+    }
+
+    monitorOut();
+    return stats;
+}
+
+void ComputationManager::retireEngine(ComputationType computationType) {
+    monitorIn();
+
+    if (stopped) {
+        monitorOut();
+        return;
+    }
+
+    // An idle engine is woken right away, otherwise the next engine to find the buffer empty retires.
+    ++pendingRetirements[computationType];
+    if (requestsBuffer[computationType].empty()) {
+        if (notEmptyWaiters[computationType] > 0) {
+            signal(notEmptyConditions[computationType]);
+        } else {
+            auto const it = std::find_if(parkedFibers.begin(), parkedFibers.end(), [computationType](auto const& p) {
+                return p.types.getBits() == TypeMask(computationType).getBits();
+            });
+            if (it != parkedFibers.end()) {
+                auto const fiber = it->fiber;
+                parkedFibers.erase(it);
+                fiber->unpark();
+            }
+        }
+    }
+
+    monitorOut();
+}
+
+void ComputationManager::preemptComputation(int id) {
+    monitorIn();
+
+    // Only a computation that is still waiting for its result can be preempted.
+    auto const it = findResult(id);
+    if (!stopped && it != resultsQueue.end() && !it->value.has_value()) {
+        preemptionRequests.insert(id);
+    }
+
+    monitorOut();
+}
+
+void ComputationManager::updatePendingRequests(ComputationType type) {
+    pendingRequests[type].store(requestsBuffer[type].size(), std::memory_order_release);
+}
+
+void ComputationManager::updateNextResultReady() {
+    nextResultReady.store(!resultsQueue.empty() && resultsQueue.back().value.has_value(), std::memory_order_release);
+}
+
+void ComputationManager::spinForWork(ComputationType computationType) {
+    // Spin outside of the monitor for a short while, this avoids a full park/wake-up handoff when
+    // requests arrive in quick succession.
+    // A fiber parks right away, spinning would hold its worker thread.
+    if (waitStrategy == WaitStrategy::SpinThenPark && Fiber::current() == nullptr) {
+        requestSpinners[computationType].spinUntil([this, computationType] {
+            return pendingRequests[computationType].load(std::memory_order_acquire) > 0 || stopped;
+        });
+    }
+}
+
+void ComputationManager::spinForWork(TypeMask computationTypes) {
+    if (waitStrategy != WaitStrategy::SpinThenPark || Fiber::current() != nullptr) {
+        return;
+    }
+
+    // The spin budget is estimated from the arrivals of the first type of the mask.
+    for (std::size_t i = 0; i < TYPE_COUNT; ++i) {
+        if (computationTypes.contains(static_cast<ComputationType>(i))) {
+            requestSpinners[i].spinUntil([this, computationTypes] {
+                for (std::size_t j = 0; j < TYPE_COUNT; ++j) {
+                    if (computationTypes.contains(static_cast<ComputationType>(j)) &&
+                        pendingRequests[j].load(std::memory_order_acquire) > 0) {
+                        return true;
+                    }
+                }
+                return stopped.load();
+            });
+            return;
+        }
+    }
+}
+
+void ComputationManager::waitForWork(ComputationType computationType) {
+    if (stopped) {
+        monitorOut();
+        throwStopException();
+    }
+
+    // A fiber is not handed the monitor when it is woken, the buffer may have been emptied again meanwhile.
+    if (auto const fiber = Fiber::current()) {
+        while (requestsBuffer[computationType].empty()) {
+            retireIfRequested(computationType);
+            parkFiber(fiber, computationType);
+        }
+        return;
+    }
+
+    // Check whether the buffer is empty and if so, wait for it to be not empty.
+    if (requestsBuffer[computationType].empty()) {
+        retireIfRequested(computationType);
+
+        ++notEmptyWaiters[computationType];
+        wait(notEmptyConditions[computationType]);
+        --notEmptyWaiters[computationType];
+
+        // Re-checking is mandatory here since the condition may have been signaled by the stop() method.
+        if (stopped) {
+            signal(notEmptyConditions[computationType]);
+            monitorOut();
+            throwStopException();
+        }
+
+        // The condition is also signaled to retire an engine, the buffer is then still empty.
+        retireIfRequested(computationType);
+    }
+}
+
+void ComputationManager::retireIfRequested(ComputationType computationType) {
+    if (pendingRetirements[computationType] > 0 && requestsBuffer[computationType].empty()) {
+        --pendingRetirements[computationType];
+        monitorOut();
+        throw RetireException();
+    }
+}
+
+void ComputationManager::waitForWork(TypeMask computationTypes) {
+    if (stopped) {
+        monitorOut();
+        throwStopException();
+    }
+
+    if (auto const fiber = Fiber::current()) {
+        while (!hasWork(computationTypes)) {
+            parkFiber(fiber, computationTypes);
+        }
+        return;
+    }
+
+    // Wait on the condition of the mask, it is only signaled for a type of the mask that has work.
+    if (!hasWork(computationTypes)) {
+        auto const mask = computationTypes.getBits();
+        ++anyNotEmptyWaiters[mask];
+        wait(anyNotEmptyConditions[mask]);
+        --anyNotEmptyWaiters[mask];
+
+        // Re-checking is mandatory here since the condition may have been signaled by the stop() method.
+        if (stopped) {
+            signal(anyNotEmptyConditions[mask]);
+            monitorOut();
+            throwStopException();
+        }
+    }
+}
+
+void ComputationManager::parkFiber(Fiber* fiber, TypeMask computationTypes) {
+    parkedFibers.push_back({computationTypes, fiber});
+    monitorOut();
+
+    // The fiber is removed from the parked fibers by the one that wakes it up.
+    Fiber::park();
+
+    monitorIn();
+    if (stopped) {
+        monitorOut();
+        throwStopException();
+    }
+}
+
+std::size_t ComputationManager::wakeFibers(ComputationType computationType, std::size_t count) {
+    std::size_t woken = 0;
+    for (auto it = parkedFibers.begin(); it != parkedFibers.end() && woken < count;) {
+        if (it->types.contains(computationType)) {
+            it->fiber->unpark();
+            it = parkedFibers.erase(it);
+            ++woken;
+        } else {
+            ++it;
+        }
+    }
+    return woken;
+}
+
+bool ComputationManager::hasWork(TypeMask computationTypes) {
+    for (std::size_t i = 0; i < TYPE_COUNT; ++i) {
+        if (computationTypes.contains(static_cast<ComputationType>(i)) && !requestsBuffer[i].empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ComputationType ComputationManager::selectType(TypeMask computationTypes) {
+    auto best = ComputationType::COUNT;
+    auto bestScore = 0.0;
+
+    for (std::size_t i = 0; i < TYPE_COUNT; ++i) {
+        auto const type = static_cast<ComputationType>(i);
+        auto const& queue = requestsBuffer[i];
+        if (!computationTypes.contains(type) || queue.empty()) {
+            continue;
+        }
+
+        // The larger the score, the sooner the type is served. Ids grow with the requests, so the oldest
+        // request is the one with the smallest id.
+        auto const length = static_cast<double>(queue.size());
+        auto const score = selectionPolicy == SelectionPolicy::OldestRequest ? -static_cast<double>(queue.front().getId())
+                         : selectionPolicy == SelectionPolicy::Weighted      ? length * typeWeights[i]
+                                                                              : length;
+        if (best == ComputationType::COUNT || score > bestScore) {
+            best = type;
+            bestScore = score;
+        }
+    }
+    return best;
+}
+
+Request ComputationManager::takeRequest(ComputationType computationType) {
+    // Extract the request from the queue and signal that the queue is not full. A sharded computation
+    // only leaves the queue with its last shard.
+    auto request = std::move(requestsBuffer[computationType].front());
+    requestsBuffer[computationType].pop_front();
+    updatePendingRequests(computationType);
+    if (request.isLastShard()) {
+        freeSlot(computationType);
+    }
+    return request;
+}
+
+std::deque<ComputationManager::result_t>::iterator ComputationManager::findResult(int id) {
+    return std::find_if(resultsQueue.begin(), resultsQueue.end(),
+                        [id](auto const& r) { return r.id == static_cast<std::size_t>(id); });
+}
+
+void ComputationManager::checkComputation(const Computation& c) {
+    if (c.computationType == ComputationType::C && c.getElementType() != ElementType::Float64) {
+        throw std::invalid_argument("Only the computations reduced by the engines can have other elements than doubles");
+    }
+    if (c.computationType == ComputationType::D && c.aggregates.empty()) {
+        throw std::invalid_argument("A computation of type D must ask for at least one aggregate");
+    }
+    if (c.computationType == ComputationType::C && !c.map.empty()) {
+        throw std::invalid_argument("Only the computations reduced by the engines can have an element map");
+    }
+    if (!c.inputs.empty() && (c.getElementType() != ElementType::Float64 || c.mapped)) {
+        throw std::invalid_argument("The results of the inputs can only be appended to doubles held in memory");
+    }
+}
+
+void ComputationManager::enqueue(Computation&& c, int id) {
+    auto const type = c.computationType;
+    auto& queue = requestsBuffer[type];
+    auto const& policy = shardingPolicies[type];
+    auto const size = c.size();
+    auto const shardCount = std::min(policy.maxShards, size / std::max<std::size_t>(policy.minShardSize, 1));
+
+    // Split large computations into shards of (almost) equal size, each one may be taken by another engine.
+    if (shardCount > 1) {
+        for (std::size_t shard = 0; shard < shardCount; ++shard) {
+            auto const first = size * shard / shardCount;
+            auto const last = size * (shard + 1) / shardCount;
+            queue.emplace_back(c, id, static_cast<int>(shard), static_cast<int>(shardCount), first, last - first);
+        }
+        shardsInProgress.emplace(id, shards_t(policy.reduction, shardCount));
+    } else {
+        // The request takes over the payload of the computation, it is not copied (nor its reference count touched)
+        queue.emplace_back(std::move(c), id);
+    }
+    auto const now = std::chrono::steady_clock::now();
+    for (auto it = queue.end() - static_cast<std::ptrdiff_t>(std::max<std::size_t>(shardCount, 1)); it != queue.end(); ++it) {
+        it->setEnqueueTime(now);
+    }
+    ++queuedComputations[type];
+    updatePendingRequests(type);
+    requestSpinners[type].recordArrival();
+
+    // Signal that the queue is not empty, once per shard so that as many engines may start working.
+    wakeEngines(type, std::max<std::size_t>(shardCount, 1));
+}
+
+void ComputationManager::addDependent(Computation&& c, int id, const std::vector<int>& inputs) {
+    dependent_t dependent{std::move(c), std::vector<double>(inputs.size()), 0};
+
+    // The inputs whose result is already there are read right away, the others are waited for.
+    for (std::size_t position = 0; position < inputs.size(); ++position) {
+        auto const input = inputs[position];
+        auto const it = findResult(input);
+        if (it != resultsQueue.end() && it->value.has_value()) {
+            dependent.operands[position] = it->value->getResult();
+        } else {
+            waitingOn[input].emplace_back(id, position);
+            ++dependent.missing;
+        }
+    }
+
+    if (dependent.missing == 0) {
+        releaseDependent(id, std::move(dependent));
+    } else {
+        dependents.emplace(id, std::move(dependent));
+    }
+}
+
+void ComputationManager::releaseDependent(int id, dependent_t&& dependent) {
+    auto const& c = dependent.computation;
+    std::vector<double> values(c.values(), c.values() + c.size());
+    values.insert(values.end(), dependent.operands.begin(), dependent.operands.end());
+
+    // It is released by a compute engine, which must not wait for a slot: if the buffer is full the
+    // computation waits for the next freed slot instead, before the clients.
+    Computation released(c.computationType, values.data(), values.size());
+    released.map = c.map;
+    released.aggregates = c.aggregates;
+    if (queuedComputations[released.computationType] >= MAX_TOLERATED_QUEUE_SIZE) {
+        releasedDependents[released.computationType].emplace_back(id, std::move(released));
+        return;
+    }
+    enqueue(std::move(released), id);
+}
+
+void ComputationManager::resolveDependents(const Result& result) {
+    auto const waiting = waitingOn.find(result.getId());
+    if (waiting == waitingOn.end()) {
+        return;
+    }
+
+    auto const ready = std::move(waiting->second);
+    waitingOn.erase(waiting);
+    for (auto const& [id, position] : ready) {
+        auto const it = dependents.find(id);
+        if (it == dependents.end()) {
+            continue;
+        }
+        it->second.operands[position] = result.getResult();
+        if (--it->second.missing == 0) {
+            auto dependent = std::move(it->second);
+            dependents.erase(it);
+            releaseDependent(id, std::move(dependent));
+        }
+    }
+}
+
+void ComputationManager::waitForSlot(ComputationType computationType) {
+    if (stopped) {
+        monitorOut();
+        throwStopException();
+    }
+
+    // Check if the queue is full and if so, wait for it to be not full.
+    if (queuedComputations[computationType] >= MAX_TOLERATED_QUEUE_SIZE) {
+        wait(notFullConditions[computationType]);
+
+        // Re-checking is mandatory here since the condition may have been signaled by the stop() method.
+        if (stopped) {
+            signal(notFullConditions[computationType]);
+            monitorOut();
+            throwStopException();
+        }
+    }
+}
+
+void ComputationManager::freeSlot(ComputationType computationType) {
+    --queuedComputations[computationType];
+    if (queuedComputations[computationType] >= MAX_TOLERATED_QUEUE_SIZE) {
+        return;
+    }
+    auto& released = releasedDependents[computationType];
+    if (!released.empty()) {
+        auto [id, c] = std::move(released.front());
+        released.pop_front();
+        enqueue(std::move(c), id);
+    } else {
+        signal(notFullConditions[computationType]);
+    }
+}
+
+void ComputationManager::wakeEngines(ComputationType computationType, std::size_t count) {
+    // Engines waiting on the type alone are preferred, then the ones waiting on a mask containing the type.
+    // With Hoare semantics a woken engine takes its request right away, the queue is checked again before
+    // each signal since an engine may take several requests at once.
+    for (std::size_t i = 0; i < count && !requestsBuffer[computationType].empty(); ++i) {
+        if (notEmptyWaiters[computationType] > 0) {
+            signal(notEmptyConditions[computationType]);
+            continue;
+        }
+
+        auto woken = false;
+        for (std::size_t mask = 1; mask < MASK_COUNT && !woken; ++mask) {
+            if (anyNotEmptyWaiters[mask] > 0 && TypeMask::fromBits(static_cast<unsigned>(mask)).contains(computationType)) {
+                signal(anyNotEmptyConditions[mask]);
+                woken = true;
+            }
+        }
+        // The engines running on fibers are woken last, they check the buffer again once they run.
+        if (!woken) {
+            wakeFibers(computationType, count - i);
+            return;
+        }
+    }
+}
+
+void ComputationManager::storeResult(const Result& result) {
+    // Find the result based on its id.
+    auto const it = findResult(result.getId());
+
+    // If the result was found, update the optional value.
+    if (it != resultsQueue.end()) {
+        preemptionRequests.erase(result.getId());
+        openStreams.erase(result.getId());
+        it->value = result;
+        updateNextResultReady();
+        resultSpinner.recordArrival();
+        resolveDependents(result);
+        signal(resultAvailable);
+    }
+}
+
+void ComputationManager::storePartialResult(const Result& result) {
+    // The computation is unknown if it was aborted, the partial result is then dropped.
+    auto const it = shardsInProgress.find(result.getId());
+    if (it == shardsInProgress.end()) {
+        return;
+    }
+
+    auto& shards = it->second;
+    auto const shard = static_cast<std::size_t>(result.getShard());
+    if (shard >= shards.partials.size() || shards.partials[shard].has_value()) {
+        return;
+    }
+    shards.partials[shard] = result;
+
+    // Once every shard is done, combine the partial results into the result of the computation.
+    if (--shards.missing == 0) {
+        std::vector<Result> partials;
+        partials.reserve(shards.partials.size());
+        for (auto const& partial : shards.partials) {
+            partials.push_back(*partial);
+        }
+        auto const reduction = shards.reduction;
+        shardsInProgress.erase(it);
+        storeResult(combineShards(reduction, std::move(partials)));
+    }
+}
@@ -14,19 +14,94 @@
 #ifndef COMPUTATIONMANAGER_H
 #define COMPUTATIONMANAGER_H
 
+#include <algorithm>
+#include <any>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <optional>
+#include <set>
+#include <type_traits>
+#include <variant>
 #include <forward_list>
+#include <initializer_list>
+#include <limits>
 #include <deque>
+#include <vector>
 
 #include "pcosynchro/pcohoaremonitor.h"
+#include "computationstream.h"
+#include "elementmap.h"
+#include "mappedpayload.h"
+#include "payloadpool.h"
+#include "waitstrategy.h"
+
+class Fiber;
+
+/**
+ * @brief The ComputationType enum represents the abstract computation types that are available. A computation
+ * of type D gives several aggregates of its elements at once, see Aggregates.
+ */
+enum class ComputationType {A, B, C, D, COUNT};
+
+/**
+ * @brief The ElementType enum lists the types of the elements of a computation. The payloads of the other
+ * types than Float64 take less memory and bandwidth, the sums of integers are exact.
+ */
+enum class ElementType {Float64, Float32, Int32, Int64};
+
+/**
+ * @brief isInteger Returns true for the integer element types
+ */
+constexpr bool isInteger(ElementType type) {return type == ElementType::Int32 || type == ElementType::Int64;}
+
+/**
+ * @brief The Aggregate enum lists the aggregates a computation of type D can ask for
+ */
+enum class Aggregate {Sum, Product, Min, Max, Count};
+
+/**
+ * @brief The AggregateSet class is a set of aggregates
+ */
+class AggregateSet
+{
+public:
+    constexpr AggregateSet() = default;
+    constexpr AggregateSet(Aggregate aggregate): bits(1u << static_cast<unsigned>(aggregate)) {}
+
+    /**
+     * @brief all Returns the set of every aggregate
+     */
+    static constexpr AggregateSet all() {return AggregateSet((1u << (static_cast<unsigned>(Aggregate::Count) + 1)) - 1);}
+
+    [[nodiscard]] constexpr AggregateSet operator|(AggregateSet other) const {return AggregateSet(bits | other.bits);}
+    [[nodiscard]] constexpr bool contains(Aggregate aggregate) const {return (bits & AggregateSet(aggregate).bits) != 0;}
+    [[nodiscard]] constexpr bool empty() const {return bits == 0;}
+
+private:
+    constexpr explicit AggregateSet(unsigned bits): bits(bits) {}
+
+    unsigned bits = 0;
+};
+
+constexpr AggregateSet operator|(Aggregate a, Aggregate b) {return AggregateSet(a) | b;}
 
 /**
- * @brief The ComputationType enum represents the abstract computation types that are available
+ * @brief The Aggregates struct holds the aggregates of the elements of a computation of type D. Those that were
+ * not asked for keep their value over no element.
  */
-enum class ComputationType {A, B, C, COUNT};
+struct Aggregates
+{
+    AggregateSet computed;
+    double sum = 0.0;
+    double product = 1.0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    std::uint64_t count = 0;
+};
 
 /**
  * @brief The EnumIndexedArray class is a wrapper around std::array that allows
@@ -51,11 +126,119 @@ class EnumIndexedArray : public std::array<T, U> {
 class Computation
 {
 public:
+    /**
+     * @brief INLINE_CAPACITY The number of doubles a computation holds inline, without allocating a payload
+     */
+    static constexpr std::size_t INLINE_CAPACITY = 4;
+
     /**
      * @brief Computation Constructs a computation of a given type
+     * @note The data comes from the PayloadPool, it goes back to the pool once the computation is done
+     * @param computationType
+     */
+    Computation(ComputationType computationType): computationType(computationType), data(PayloadPool::acquire(0)) {}
+
+    /**
+     * @brief Computation Constructs a computation of a given type with size (zeroed) elements, the data
+     * then needs no allocation once the pool holds payloads of this size
      * @param computationType
+     * @param size the number of elements
      */
-    Computation(ComputationType computationType): computationType(computationType) {data = std::make_shared<std::vector<double>>();}
+    Computation(ComputationType computationType, std::size_t size): computationType(computationType), data(PayloadPool::acquire(size)) {}
+
+    /**
+     * @brief Computation Constructs a computation of a given type over doubles mapped from a file, the engines
+     * read them in place (data is then null)
+     * @param computationType
+     * @param payload the mapped doubles, see MappedPayload::open()
+     */
+    Computation(ComputationType computationType, std::shared_ptr<const MappedPayload> payload)
+        : computationType(computationType), mapped(std::move(payload)) {}
+
+    /**
+     * @brief Computation Constructs a computation of a given type over a few operands, at most INLINE_CAPACITY
+     * operands are stored inline and cost no allocation (data is then null), more come from the PayloadPool
+     * @param computationType
+     * @param operands the elements
+     */
+    Computation(ComputationType computationType, std::initializer_list<double> operands)
+        : Computation(computationType, operands.begin(), operands.size()) {}
+
+    /**
+     * @brief Computation Constructs a computation of a given type over a copy of count doubles, stored inline
+     * like the operands above when there are at most INLINE_CAPACITY of them
+     */
+    Computation(ComputationType computationType, const double* values, std::size_t count)
+        : computationType(computationType) {
+        if (count <= INLINE_CAPACITY) {
+            std::copy(values, values + count, inlineValues.begin());
+            inlineSize = count;
+        } else {
+            data = PayloadPool::acquire(count);
+            std::copy(values, values + count, data->begin());
+        }
+    }
+
+    /**
+     * @brief Computation Constructs a computation of a given type over elements that are not doubles, the
+     * engines reduce them with the kernels of their type (data is then null)
+     * @note Only for the types computed by a reduction (A and B)
+     * @param computationType
+     * @param values the elements, float, int32_t or int64_t
+     */
+    template <typename T, typename = std::enable_if_t<std::is_same_v<T, float> || std::is_same_v<T, std::int32_t> ||
+                                                      std::is_same_v<T, std::int64_t>>>
+    Computation(ComputationType computationType, std::vector<T> values)
+        : computationType(computationType), typed(std::make_shared<const std::vector<T>>(std::move(values))) {}
+
+    /**
+     * @brief size Returns the number of elements of the computation
+     */
+    [[nodiscard]] std::size_t size() const {
+        return std::visit([this](auto const& elements) -> std::size_t {
+            if constexpr (std::is_same_v<std::decay_t<decltype(elements)>, std::monostate>) {
+                return mapped ? mapped->size() : (data ? data->size() : inlineSize);
+            } else {
+                return elements->size();
+            }
+        }, typed);
+    }
+
+    /**
+     * @brief values Returns the first element of the computation, nullptr if its elements are not doubles
+     */
+    [[nodiscard]] const double* values() const {
+        if (mapped) {
+            return mapped->values();
+        }
+        if (data) {
+            return data->data();
+        }
+        return inlineSize > 0 ? inlineValues.data() : nullptr;
+    }
+
+    /**
+     * @brief isInline Returns true if the operands are stored in the computation itself
+     */
+    [[nodiscard]] bool isInline() const {return inlineSize > 0;}
+
+    /**
+     * @brief elements Returns the first element of the computation, whatever its type
+     */
+    [[nodiscard]] const void* elements() const {
+        return std::visit([this](auto const& elements) -> const void* {
+            if constexpr (std::is_same_v<std::decay_t<decltype(elements)>, std::monostate>) {
+                return values();
+            } else {
+                return elements->data();
+            }
+        }, typed);
+    }
+
+    /**
+     * @brief getElementType Returns the type of the elements of the computation
+     */
+    [[nodiscard]] ElementType getElementType() const {return static_cast<ElementType>(typed.index());}
 
     /**
      * @brief computationType The given type
@@ -65,6 +248,34 @@ public:
      * @brief data The data for the computation
      */
     std::shared_ptr<std::vector<double>> data;
+    /**
+     * @brief mapped The read-only data mapped from a file, used instead of data when set
+     */
+    std::shared_ptr<const MappedPayload> mapped;
+    /**
+     * @brief typed The elements when they are not doubles, indexed like ElementType (empty for doubles)
+     */
+    std::variant<std::monostate, std::shared_ptr<const std::vector<float>>, std::shared_ptr<const std::vector<std::int32_t>>,
+                 std::shared_ptr<const std::vector<std::int64_t>>> typed;
+    /**
+     * @brief inputs The ids of earlier computations whose results are appended to the elements, in this order.
+     * The computation only goes to the engines once all of them are known, see ComputationManager.
+     */
+    std::vector<int> inputs;
+    /**
+     * @brief map The elementwise operations applied to the elements before they are reduced (A and B only)
+     */
+    ElementMap map;
+    /**
+     * @brief aggregates The aggregates given by a computation of type D
+     */
+    AggregateSet aggregates = AggregateSet::all();
+
+private:
+    std::array<double, INLINE_CAPACITY> inlineValues{};
+    std::size_t inlineSize{0};
+
+    friend class Request;
 };
 
 /**
@@ -74,18 +285,201 @@ class Request
 {
 public:
     Request(): data(nullptr) {}
-    Request(std::shared_ptr<std::vector<double>> data, int id): data(std::move(data)), id(id) {}
-    Request(const Computation& c, int id): data(c.data), id(id) {}
+    Request(std::shared_ptr<std::vector<double>> data, int id)
+        : data(std::move(data)), base(this->data ? this->data->data() : nullptr), id(id), length(this->data ? this->data->size() : 0) {}
+    Request(const Computation& c, int id)
+        : data(c.data), mapped(c.mapped), typed(c.typed), base(c.elements()),
+          inlineValues(c.inlineValues), inlined(c.isInline()), map(c.map), aggregates(c.aggregates), id(id), type(c.computationType),
+          elementType(c.getElementType()), length(c.size()) {}
+
+    /**
+     * @brief Request Takes over the payload of the computation, its reference counts are left untouched
+     */
+    Request(Computation&& c, int id): Request(std::move(c), id, c.elements(), c.size()) {}
+
+    /**
+     * @brief Request Constructs a shard of a computation, covering the elements [offset, offset + length)
+     * @note All the shards of a computation share its id
+     */
+    Request(const Computation& c, int id, int shard, int shardCount, std::size_t offset, std::size_t length)
+        : data(c.data), mapped(c.mapped), typed(c.typed), base(c.elements()),
+          inlineValues(c.inlineValues), inlined(c.isInline()), map(c.map), aggregates(c.aggregates), id(id), type(c.computationType),
+          elementType(c.getElementType()), shard(shard), shardCount(shardCount), offset(offset), length(length) {}
+
+    /**
+     * @brief Request Constructs the request of a streamed computation, its elements come from the stream
+     */
+    Request(std::shared_ptr<ComputationStream> stream, ComputationType type)
+        : data(nullptr), stream(std::move(stream)), id(this->stream->getId()), type(type) {}
 
     [[nodiscard]] int getId() const {return id;}
 
+    /**
+     * @brief getType Returns the type of the computation (COUNT if the request was not made from a Computation)
+     */
+    [[nodiscard]] ComputationType getType() const {return type;}
+
+    /**
+     * @brief values Returns the first element of the data to process (the data of the shard for a shard)
+     */
+    [[nodiscard]] const double* values() const {return elements<double>();}
+
+    /**
+     * @brief elements Returns the first element of the data to process, T must match getElementType()
+     */
+    template <typename T>
+    [[nodiscard]] const T* elements() const {
+        // Inline operands are copied with the request, base would point into the computation
+        return static_cast<const T*>(inlined ? static_cast<const void*>(inlineValues.data()) : base) + offset;
+    }
+
+    [[nodiscard]] ElementType getElementType() const {return elementType;}
+
+    /**
+     * @brief getMap Returns the elementwise operations applied to the elements before they are reduced
+     */
+    [[nodiscard]] const ElementMap& getMap() const {return map;}
+
+    /**
+     * @brief getAggregates Returns the aggregates asked for by a computation of type D (all of them for a stream)
+     */
+    [[nodiscard]] AggregateSet getAggregates() const {return aggregates;}
+
+    /**
+     * @brief willNeed Asks the kernel to load the elements that follow position when the data is mapped from a
+     * file, does nothing otherwise
+     */
+    void willNeed(std::size_t position) const {
+        if (mapped) {
+            mapped->willNeed(offset + position);
+        }
+    }
+
+    /**
+     * @brief size Returns the number of elements to process
+     */
+    [[nodiscard]] std::size_t size() const {return length;}
+
+    /**
+     * @brief getStream Returns the stream of a streamed computation (its size is then 0), nullptr otherwise
+     */
+    [[nodiscard]] ComputationStream* getStream() const {return stream.get();}
+
+    /**
+     * @brief isShard Returns true if the request is one part of a computation split across several engines
+     */
+    [[nodiscard]] bool isShard() const {return shard >= 0;}
+    [[nodiscard]] int getShard() const {return shard;}
+    [[nodiscard]] int getShardCount() const {return shardCount;}
+
+    /**
+     * @brief isLastShard Returns true for the last shard of a computation and for requests that are not shards
+     */
+    [[nodiscard]] bool isLastShard() const {return shard == shardCount - 1 || !isShard();}
+
+    /**
+     * @brief getEnqueueTime Returns when the request was put in the buffer
+     */
+    [[nodiscard]] std::chrono::steady_clock::time_point getEnqueueTime() const {return enqueueTime;}
+    void setEnqueueTime(std::chrono::steady_clock::time_point time) {enqueueTime = time;}
+
+    /**
+     * @brief getCheckpoint Returns the saved state of a computation that was preempted, empty if the computation
+     * has not been started yet. Only the engines of the type of the request know what it holds.
+     */
+    [[nodiscard]] const std::any& getCheckpoint() const {return checkpoint;}
+    [[nodiscard]] bool hasCheckpoint() const {return checkpoint.has_value();}
+    void setCheckpoint(std::any state) {checkpoint = std::move(state);}
+
     /**
      * @brief data The data for the computation
      */
     std::shared_ptr<const std::vector<double>> data;
 
 private:
+    // The elements are read before the payload is moved out of the computation
+    Request(Computation&& c, int id, const void* base, std::size_t length)
+        : data(std::move(c.data)), mapped(std::move(c.mapped)), typed(std::move(c.typed)), base(base),
+          inlineValues(c.inlineValues), inlined(c.isInline()), map(c.map), aggregates(c.aggregates), id(id),
+          type(c.computationType), elementType(static_cast<ElementType>(typed.index())),
+          length(length) {}
+
+    std::shared_ptr<const MappedPayload> mapped;
+    std::shared_ptr<ComputationStream> stream;
+    decltype(Computation::typed) typed;
+    const void* base{nullptr};
+    std::array<double, Computation::INLINE_CAPACITY> inlineValues{};
+    bool inlined{false};
+    ElementMap map;
+    AggregateSet aggregates{AggregateSet::all()};
     int id{0};
+    ComputationType type{ComputationType::COUNT};
+    ElementType elementType{ElementType::Float64};
+    int shard{-1};
+    int shardCount{1};
+    std::size_t offset{0};
+    std::size_t length{0};
+    std::chrono::steady_clock::time_point enqueueTime{};
+    std::any checkpoint;
+};
+
+/**
+ * @brief The TypeMask class is a set of computation types
+ */
+class TypeMask
+{
+public:
+    constexpr TypeMask() = default;
+    constexpr TypeMask(ComputationType type): bits(1u << static_cast<unsigned>(type)) {}
+
+    /**
+     * @brief all Returns the mask of every computation type
+     */
+    static constexpr TypeMask all() {return TypeMask((1u << static_cast<unsigned>(ComputationType::COUNT)) - 1);}
+
+    /**
+     * @brief fromBits Returns the mask whose bit i is set for the type i
+     */
+    static constexpr TypeMask fromBits(unsigned bits) {return TypeMask(bits);}
+
+    [[nodiscard]] constexpr TypeMask operator|(TypeMask other) const {return TypeMask(bits | other.bits);}
+    [[nodiscard]] constexpr bool contains(ComputationType type) const {return (bits & TypeMask(type).bits) != 0;}
+    [[nodiscard]] constexpr bool empty() const {return bits == 0;}
+    [[nodiscard]] constexpr unsigned getBits() const {return bits;}
+
+private:
+    constexpr explicit TypeMask(unsigned bits): bits(bits) {}
+
+    unsigned bits = 0;
+};
+
+constexpr TypeMask operator|(ComputationType a, ComputationType b) {return TypeMask(a) | b;}
+
+/**
+ * @brief The SelectionPolicy enum tells which queue getWork(TypeMask) serves when several types have work.
+ * LongestQueue takes the queue with the most requests, OldestRequest the request that was made first and
+ * Weighted the queue with the largest number of requests times the weight of its type.
+ */
+enum class SelectionPolicy {LongestQueue, OldestRequest, Weighted};
+
+/**
+ * @brief The QueueStats struct is a snapshot of the state of the buffer of a computation type
+ */
+struct QueueStats
+{
+    std::size_t queuedRequests = 0;         ///< The number of requests in the buffer (each shard counts)
+    std::size_t idleEngines = 0;            ///< The number of engines of the type waiting for work
+    std::chrono::nanoseconds oldestWait{0}; ///< For how long the first request of the buffer has been waiting
+};
+
+/**
+ * @brief The ResultStatus enum tells whether a result can be trusted
+ */
+enum class ResultStatus {
+    Ok,              ///< The result is the value of the computation
+    Overflow,        ///< The true result is finite but too large for a double, the result is +/-infinity
+    Underflow,       ///< The true result is not zero but too small for a double, the result is +/-0
+    InvalidOperands  ///< The data of the request does not fit the computation, the result is NaN
 };
 
 /**
@@ -94,14 +488,82 @@ private:
 class Result
 {
 public:
-    Result(int id, double result): id(id), result(result) {}
+    Result(int id, double result, ResultStatus status = ResultStatus::Ok): id(id), result(result), status(status) {}
+
+    /**
+     * @brief partial Constructs the result of one shard of a computation, its value is result * 2^exponent
+     * @note The exponent allows partial products to go beyond the range of a double
+     */
+    static Result partial(int id, int shard, double result, std::int64_t exponent = 0, ResultStatus status = ResultStatus::Ok) {
+        Result r(id, result, status);
+        r.shard = shard;
+        r.exponent = exponent;
+        return r;
+    }
 
     [[nodiscard]] int getId() const {return id;}
     [[nodiscard]] double getResult() const {return result;}
+    [[nodiscard]] ResultStatus getStatus() const {return status;}
+    [[nodiscard]] bool isPartial() const {return shard >= 0;}
+    [[nodiscard]] int getShard() const {return shard;}
+    [[nodiscard]] std::int64_t getExponent() const {return exponent;}
+
+    /**
+     * @brief getExactResult Returns the exact integer result of the sum of integer elements, empty otherwise
+     * (and if the sum overflowed), getResult() is then rounded beyond 2^53
+     */
+    [[nodiscard]] std::optional<std::int64_t> getExactResult() const {return exact;}
+    void setExactResult(std::optional<std::int64_t> value) {exact = value;}
+
+    /**
+     * @brief getAggregates Returns the aggregates of a computation of type D, empty for the other types.
+     * getResult() is then the first aggregate asked for, in the order of Aggregate.
+     */
+    [[nodiscard]] const std::optional<Aggregates>& getAggregates() const {return aggregates;}
+    void setAggregates(std::optional<Aggregates> value) {aggregates = value;}
 
 private:
     int id;
     double result;
+    ResultStatus status;
+    int shard = -1;
+    std::int64_t exponent = 0;
+    std::optional<std::int64_t> exact;
+    std::optional<Aggregates> aggregates;
+};
+
+/**
+ * @brief The WorkDirective enum tells a compute engine what to do with the request it is working on
+ */
+enum class WorkDirective {
+    Continue,  ///< Go on with the computation
+    Yield,     ///< Save the state of the computation and give the request back with yieldWork()
+    Abort      ///< Drop the computation, it was aborted or the buffer is stopped
+};
+
+/**
+ * @brief The ShardReduction enum tells how the partial results of the shards of a computation are combined
+ */
+enum class ShardReduction {Sum, Product, Min, Max};
+
+/**
+ * @brief The ShardingPolicy struct sets how large computations of a type are split into shards that
+ * several compute engines process in parallel. A computation is split into as many shards of at least
+ * minShardSize elements as possible, up to maxShards.
+ */
+struct ShardingPolicy
+{
+    ShardReduction reduction = ShardReduction::Sum;
+
+    /**
+     * @brief maxShards The maximum number of shards per computation, 1 disables sharding
+     */
+    std::size_t maxShards = 1;
+
+    /**
+     * @brief minShardSize The minimum number of elements of a shard
+     */
+    std::size_t minShardSize = std::size_t{1} << 20;
 };
 
 /**
@@ -149,6 +611,22 @@ public:
      */
     virtual Request getWork(ComputationType computationType) = 0;
 
+    /**
+     * @brief getWork is used to ask for work of any of several types, blocks until one of them has work
+     * @param computationTypes the types of work that are wanted
+     * @return a request to be fulfilled, its type tells which computation to do
+     */
+    virtual Request getWork(TypeMask computationTypes) = 0;
+
+    /**
+     * @brief getWorkBatch is used to ask for several requests of a given type at once, blocks until at least
+     * one request is available
+     * @param computationType the type of work that is wanted
+     * @param maxCount the maximum number of requests to take
+     * @return between 1 and maxCount requests to be fulfilled, in the order of the requests
+     */
+    virtual std::vector<Request> getWorkBatch(ComputationType computationType, std::size_t maxCount) = 0;
+
     /**
      * @brief continueWork Allows a compute engine to ask if it must continue working on a request
      * @param id the id of the request the compute engine is currently working on
@@ -156,16 +634,39 @@ public:
      */
     virtual bool continueWork(int id) = 0;
 
+    /**
+     * @brief workDirective Allows a compute engine to ask whether it must continue, yield or abort its work on
+     * a request, it is asked between two steps of the computation
+     * @param id the id of the request the compute engine is currently working on
+     * @return what the compute engine must do with the request with id id
+     */
+    virtual WorkDirective workDirective(int id) = 0;
+
+    /**
+     * @brief yieldWork Allows a compute engine to give back a request it was asked to yield, any engine of the
+     * type may then resume it
+     * @param request the request, with the state of the computation saved in its checkpoint
+     */
+    virtual void yieldWork(Request request) = 0;
+
     /**
      * @brief provideResult Allows a compute engine to prove a result to the buffer
      * @param result the result that has been computed
      */
     virtual void provideResult(Result result) = 0;
+
+    /**
+     * @brief provideResults Allows a compute engine to provide several results at once
+     * @param results the results that have been computed
+     */
+    virtual void provideResults(std::vector<Result> results) = 0;
 };
 
 /**
  * @brief The ComputationManager class is the implementation of the shared buffer between client and compute engines.
  * It is to be implemented as a Hoare monitor.
+ * @note Compute engines running on fibers (see fiber.h) park their fiber while they wait for work instead of
+ * blocking the worker thread. The other calls do not wait and may block the worker thread for a short while.
  */
 class ComputationManager : public ClientInterface, public ComputeEngineInterface, protected PcoHoareMonitor
 {
@@ -176,11 +677,18 @@ public:
      */
     class StopException : public std::exception {};
 
+    /**
+     * @brief The RetireException class is thrown to a single compute engine that must stop, see retireEngine().
+     * It is a StopException so that the engines handle it the same way, but the buffer keeps running.
+     */
+    class RetireException : public StopException {};
+
     /**
      * @brief ComputationManager Allows to create a buffer with a maximum queue size
      * @param maxQueueSize the maximum queue size allowed to store pending requests
+     * @param waitStrategy how compute engines and clients wait for requests and results
      */
-    ComputationManager(int maxQueueSize = 10);
+    ComputationManager(int maxQueueSize = 10, WaitStrategy waitStrategy = WaitStrategy::Park);
 
     // Client Interface
     // Documentation above
@@ -191,8 +699,13 @@ public:
     // Compute Engine Interface
     // Documentation above
     Request getWork(ComputationType computationType) override;
+    Request getWork(TypeMask computationTypes) override;
+    std::vector<Request> getWorkBatch(ComputationType computationType, std::size_t maxCount) override;
     bool continueWork(int id) override;
+    WorkDirective workDirective(int id) override;
+    void yieldWork(Request request) override;
     void provideResult(Result result) override;
+    void provideResults(std::vector<Result> results) override;
 
     // Control Interface
     /**
@@ -200,6 +713,78 @@ public:
      */
     void stop();
 
+    /**
+     * @brief setShardingPolicy Sets how the computations of a type are split across compute engines
+     * @note Only applies to the computations requested afterwards. The partial results are combined in a
+     * fixed tree order over the shards, the result does thus not depend on which engine finishes first.
+     * Only the computations of type A and B are sharded, std::invalid_argument is thrown for the other types
+     * and for a Product reduction of an A or a Sum reduction of a B.
+     * @param computationType the type of computation
+     * @param policy the sharding policy
+     */
+    void setShardingPolicy(ComputationType computationType, ShardingPolicy policy);
+
+    /**
+     * @brief setSelectionPolicy Sets how getWork(TypeMask) chooses among the types that have work
+     * @param policy the selection policy
+     */
+    void setSelectionPolicy(SelectionPolicy policy);
+
+    /**
+     * @brief setTypeWeight Sets the weight of a type for the Weighted selection policy (1 by default)
+     * @param computationType the type of computation
+     * @param weight the weight, larger weights are served first
+     */
+    void setTypeWeight(ComputationType computationType, double weight);
+
+    /**
+     * @brief getQueueStats Returns the state of the buffer of a type, throws a StopException if stopped
+     * @param computationType the type of computation
+     * @return the statistics of the buffer
+     */
+    QueueStats getQueueStats(ComputationType computationType);
+
+    /**
+     * @brief retireEngine Makes one compute engine of a type stop. The first engine of the type that waits
+     * for work while the buffer is empty gets a RetireException (engines waiting on a TypeMask are not retired).
+     * @param computationType the type of computation
+     */
+    void retireEngine(ComputationType computationType);
+
+    /**
+     * @brief openComputation Requests a computation whose elements are appended while it runs. The engine
+     * starts reducing as soon as the first chunk is appended, the result is ready once the stream is closed
+     * and consumed. It takes a slot of the buffer like requestComputation() until an engine takes it.
+     * @note Only for the types computed by a reduction (A, B and D with every aggregate), throws
+     * std::invalid_argument for C
+     * @param computationType the type of computation
+     * @param capacity the number of elements that may wait in the stream before append() blocks
+     * @return the stream, its id is the id of the computation
+     */
+    std::shared_ptr<ComputationStream> openComputation(ComputationType computationType,
+                                                       std::size_t capacity = ComputationStream::DEFAULT_CAPACITY);
+
+    /**
+     * @brief preemptComputation Asks the compute engine working on a computation to yield it at its next step.
+     * The computation goes back to the end of the buffer of its type with its progress and is resumed later by
+     * any engine of the type, which frees the engine for the requests queued behind it.
+     * @note Does nothing if the computation is unknown or done. For a sharded computation, one of the shards
+     * being worked on yields.
+     * @param id the id of the computation to preempt
+     */
+    void preemptComputation(int id);
+
+    /**
+     * @brief requestGraph Requests computations depending on each other in a single call. The inputs of each
+     * computation are the positions of earlier computations of the graph (instead of ids), whose results are
+     * appended to its elements. A computation goes to the engines as soon as the results of its inputs are
+     * known, without the client, and aborting a computation aborts the computations depending on it.
+     * @note Throws std::invalid_argument if an input is not an earlier computation of the graph
+     * @param graph the computations, in an order where the inputs come first
+     * @return the ids of the computations, in the order of the graph
+     */
+    std::vector<int> requestGraph(std::vector<Computation> graph);
+
 protected:
     /**
      * @brief The maximum number of elements in a computation request queue.
@@ -222,6 +807,67 @@ protected:
      */
     EnumIndexedArray<std::deque<Request>, TYPE_COUNT> requestsBuffer;
 
+    /**
+     * @brief The number of computations in the buffers per type, a sharded computation only counts once.
+     * @note This is what the capacity of the buffers applies to.
+     */
+    EnumIndexedArray<std::size_t, TYPE_COUNT> queuedComputations{};
+
+    /**
+     * @brief The sharding policies per computation type.
+     */
+    EnumIndexedArray<ShardingPolicy, TYPE_COUNT> shardingPolicies{};
+
+    /**
+     * @brief The storage structure for the partial results of a sharded computation.
+     */
+    struct shards_t {
+        ShardReduction                     reduction;
+        std::vector<std::optional<Result>> partials;
+        std::size_t                        missing;
+        shards_t(ShardReduction reduction, std::size_t count) : reduction(reduction), partials(count), missing(count) {}
+    };
+
+    /**
+     * @brief The sharded computations in progress, by id.
+     */
+    std::map<int, shards_t> shardsInProgress;
+
+    /**
+     * @brief The streams of the streamed computations in progress, by id, cancelled if they are aborted.
+     */
+    std::map<int, std::shared_ptr<ComputationStream>> openStreams;
+
+    /**
+     * @brief The storage structure for a computation waiting for the results of its inputs.
+     */
+    struct dependent_t {
+        Computation         computation;
+        std::vector<double> operands;
+        std::size_t         missing;
+    };
+
+    /**
+     * @brief The computations waiting for the results of their inputs, by id.
+     */
+    std::map<int, dependent_t> dependents;
+
+    /**
+     * @brief The computations waiting for the result of each computation, with the position of the result
+     * among their operands.
+     */
+    std::map<int, std::vector<std::pair<int, std::size_t>>> waitingOn;
+
+    /**
+     * @brief The released computations waiting for a slot of the buffer of their type, with their id.
+     */
+    EnumIndexedArray<std::deque<std::pair<int, Computation>>, TYPE_COUNT> releasedDependents;
+
+    /**
+     * @brief The ids of the computations whose engine must yield at its next step.
+     */
+    std::set<int> preemptionRequests;
+
     /**
      * @brief The conditions for the buffers per type not to be empty.
      */
@@ -232,6 +878,46 @@ protected:
      */
     EnumIndexedArray<Condition, TYPE_COUNT> notFullConditions;
 
+    /**
+     * @brief The number of compute engines waiting on each notEmpty condition.
+     */
+    EnumIndexedArray<std::size_t, TYPE_COUNT> notEmptyWaiters{};
+
+    /**
+     * @brief The number of engines per type that must still be retired.
+     */
+    EnumIndexedArray<std::size_t, TYPE_COUNT> pendingRetirements{};
+
+    /**
+     * @brief The number of type masks, one condition per mask for the engines waiting on several types.
+     */
+    static auto constexpr MASK_COUNT = std::size_t{1} << TYPE_COUNT;
+
+    /**
+     * @brief The conditions for any of the buffers of a mask not to be empty, indexed by the bits of the mask.
+     */
+    std::array<Condition, MASK_COUNT> anyNotEmptyConditions;
+
+    /**
+     * @brief The number of compute engines waiting on each anyNotEmpty condition.
+     */
+    std::array<std::size_t, MASK_COUNT> anyNotEmptyWaiters{};
+
+    /**
+     * @brief The fibers parked while waiting for work, with the types of work they wait for, in order of arrival.
+     */
+    struct parked_fiber_t {
+        TypeMask types;
+        Fiber*   fiber;
+    };
+    std::deque<parked_fiber_t> parkedFibers;
+
+    /**
+     * @brief The policy used by getWork(TypeMask) and the weights of the types for the Weighted policy.
+     */
+    SelectionPolicy selectionPolicy = SelectionPolicy::LongestQueue;
+    EnumIndexedArray<double, TYPE_COUNT> typeWeights;
+
     /**
      * @brief The storage structure for the computation results and their associated ids.
      */
@@ -249,8 +935,34 @@ protected:
 
     /**
      * @brief Flag indicating whether the program is stopped.
+     * @note Atomic because spinning waiters read it outside of the monitor.
+     */
+    std::atomic<bool> stopped = false;
+
+    /**
+     * @brief The way threads wait for requests (in getWork) and results (in getNextResult).
+     */
+    const WaitStrategy waitStrategy;
+
+    /**
+     * @brief Mirror of the sizes of the requests buffers, readable outside of the monitor by spinning engines.
+     */
+    EnumIndexedArray<std::atomic<std::size_t>, TYPE_COUNT> pendingRequests{};
+
+    /**
+     * @brief Mirror of whether the next result is available, readable outside of the monitor by spinning clients.
+     */
+    std::atomic<bool> nextResultReady = false;
+
+    /**
+     * @brief The spin estimators for the arrival of requests per type.
+     */
+    EnumIndexedArray<AdaptiveSpinner, TYPE_COUNT> requestSpinners;
+
+    /**
+     * @brief The spin estimator for the arrival of results.
      */
-    bool stopped = false;
+    AdaptiveSpinner resultSpinner;
 
 private:
     /**
@@ -258,6 +970,162 @@ private:
      */
     inline void throwStopException() {throw StopException();}
 
+    /**
+     * @brief updatePendingRequests Publishes the size of a requests buffer to the spinning engines
+     * @param type the type of the buffer that changed
+     */
+    void updatePendingRequests(ComputationType type);
+
+    /**
+     * @brief updateNextResultReady Publishes whether the next result is available to the spinning clients
+     */
+    void updateNextResultReady();
+
+    /**
+     * @brief spinForWork Spins outside of the monitor for a short while if the wait strategy asks for it
+     * @param computationType the type of work that is wanted
+     */
+    void spinForWork(ComputationType computationType);
+
+    /**
+     * @brief spinForWork Spins outside of the monitor for a short while if the wait strategy asks for it
+     * @param computationTypes the types of work that are wanted
+     */
+    void spinForWork(TypeMask computationTypes);
+
+    /**
+     * @brief waitForWork Waits until a request of the given type is available
+     * @note Must be called from inside the monitor, throws a StopException (after leaving it) if stopped
+     * @param computationType the type of work that is wanted
+     */
+    void waitForWork(ComputationType computationType);
+
+    /**
+     * @brief retireIfRequested Throws a RetireException (after leaving the monitor) if an engine of the type
+     * must retire and the buffer of the type is empty
+     * @note Must be called from inside the monitor
+     */
+    void retireIfRequested(ComputationType computationType);
+
+    /**
+     * @brief waitForWork Waits until a request of any type of the mask is available
+     * @note Must be called from inside the monitor, throws a StopException (after leaving it) if stopped
+     * @param computationTypes the types of work that are wanted
+     */
+    void waitForWork(TypeMask computationTypes);
+
+    /**
+     * @brief parkFiber Parks the calling fiber until it is woken for work of a type of the mask (or a
+     * retirement), throws a StopException (after leaving the monitor) if stopped
+     * @note Must be called from inside the monitor, the monitor is left while the fiber is parked
+     */
+    void parkFiber(Fiber* fiber, TypeMask computationTypes);
+
+    /**
+     * @brief wakeFibers Wakes up to count fibers parked for work of a type
+     * @note Must be called from inside the monitor
+     * @return the number of fibers woken
+     */
+    std::size_t wakeFibers(ComputationType computationType, std::size_t count);
+
+    /**
+     * @brief hasWork Returns true if a request of any type of the mask is available
+     */
+    bool hasWork(TypeMask computationTypes);
+
+    /**
+     * @brief selectType Chooses the type to serve among the types of the mask that have work
+     * @note Must be called from inside the monitor, at least one type of the mask must have work
+     */
+    ComputationType selectType(TypeMask computationTypes);
+
+    /**
+     * @brief findResult Returns the entry of a computation in the results queue, its end if there is none
+     * @note Must be called from inside the monitor
+     */
+    std::deque<result_t>::iterator findResult(int id);
+
+    /**
+     * @brief checkComputation Throws std::invalid_argument if a computation can not be requested
+     */
+    static void checkComputation(const Computation& c);
+
+    /**
+     * @brief enqueue Puts a computation in the buffer of its type (split in shards if it is large) and wakes
+     * the engines, its result entry must already be in the results queue
+     * @note Must be called from inside the monitor, the computation takes a slot without waiting for it
+     */
+    void enqueue(Computation&& c, int id);
+
+    /**
+     * @brief removeComputation Removes a computation from the results queue and from the buffers
+     * @note Must be called from inside the monitor
+     * @return false if the computation is unknown
+     */
+    bool removeComputation(int id);
+
+    /**
+     * @brief addDependent Registers a computation waiting for the results of its inputs, it is released right
+     * away if they are all known
+     * @note Must be called from inside the monitor
+     */
+    void addDependent(Computation&& c, int id, const std::vector<int>& inputs);
+
+    /**
+     * @brief releaseDependent Appends the results of the inputs to the elements of a computation and puts it
+     * in the buffer of its type, or aside until a slot is freed if the buffer is full
+     * @note Must be called from inside the monitor
+     */
+    void releaseDependent(int id, dependent_t&& dependent);
+
+    /**
+     * @brief resolveDependents Hands a result to the computations waiting for it
+     * @note Must be called from inside the monitor
+     */
+    void resolveDependents(const Result& result);
+
+    /**
+     * @brief waitForSlot Waits until the buffer of a type has room for a computation
+     * @note Must be called from inside the monitor, throws a StopException (after leaving it) if stopped
+     */
+    void waitForSlot(ComputationType computationType);
+
+    /**
+     * @brief freeSlot Frees the slot of a computation in a buffer and gives it to a released dependent
+     * computation, or signals a waiting client
+     * @note Must be called from inside the monitor. A yielded computation may take a slot beyond the capacity,
+     * no client is released until the buffer is below its capacity again.
+     */
+    void freeSlot(ComputationType computationType);
+
+    /**
+     * @brief takeRequest Removes the first request of a buffer, signals a waiting client if a slot is freed
+     * @note Must be called from inside the monitor, the buffer must not be empty
+     */
+    Request takeRequest(ComputationType computationType);
+
+    /**
+     * @brief wakeEngines Wakes up to count engines waiting for work of a type, either on the type alone or on
+     * a mask containing it. Every woken engine takes its request before the next one is woken.
+     * @note Must be called from inside the monitor
+     */
+    void wakeEngines(ComputationType computationType, std::size_t count);
+
+    /**
+     * @brief storeResult Stores a result for the client if its request was not aborted
+     * @note Must be called from inside the monitor
+     * @param result the result that has been computed
+     */
+    void storeResult(const Result& result);
+
+    /**
+     * @brief storePartialResult Stores the result of a shard, the result of the computation is stored once
+     * all its shards are done
+     * @note Must be called from inside the monitor
+     * @param result the partial result that has been computed
+     */
+    void storePartialResult(const Result& result);
+
     int nextId = 0;
 };
 
@@ -0,0 +1,121 @@
+//     ____  __________     ___   ____ ___  _____ //
+//    / __ \/ ____/ __ \   |__ \ / __ \__ \|__  / //
+//   / /_/ / /   / / / /   __/ // / / /_/ / /_ <  //
+//  / ____/ /___/ /_/ /   / __// /_/ / __/___/ /  //
+// /_/    \____/\____/   /____/\____/____/____/   //
+// Auteurs : Timothée Van Hove, Aubry Mangold
+
+#include "computationstream.h"
+
+#include "fiber.h"
+
+bool ComputationStream::append(std::vector<double> chunk) {
+    monitorIn();
+
+    // An empty stream takes any chunk, otherwise a chunk larger than the capacity would never fit.
+    while (!cancelled && buffered > 0 && buffered + chunk.size() > capacity) {
+        wait(notFull);
+    }
+
+    if (cancelled) {
+        monitorOut();
+        return false;
+    }
+
+    if (!chunk.empty()) {
+        buffered += chunk.size();
+        chunks.push_back(std::move(chunk));
+        wakeReader();
+    }
+
+    monitorOut();
+    return true;
+}
+
+void ComputationStream::close() {
+    monitorIn();
+
+    closed = true;
+    wakeReader();
+
+    monitorOut();
+}
+
+ComputationStream::Span ComputationStream::next() {
+    monitorIn();
+
+    while (!cancelled && chunks.empty() && !closed) {
+        // A fiber must not block its worker thread, it parks until the client wakes it.
+        if (auto const fiber = Fiber::current()) {
+            parkedReader = fiber;
+            monitorOut();
+            Fiber::park();
+            monitorIn();
+        } else {
+            wait(notEmpty);
+        }
+    }
+
+    Span span;
+    if (!cancelled && !chunks.empty()) {
+        span.values = chunks.front().data() + consumedInFront;
+        span.size = chunks.front().size() - consumedInFront;
+        lent = true;
+    }
+
+    monitorOut();
+    return span;
+}
+
+void ComputationStream::consume(std::size_t count) {
+    monitorIn();
+
+    lent = false;
+    if (cancelled) {
+        // The front chunk was kept for the engine until it was done reading it
+        chunks.clear();
+        monitorOut();
+        return;
+    }
+    if (count == 0) {
+        monitorOut();
+        return;
+    }
+
+    // Only the front chunk is ever handed out, the chunk is released once it is entirely consumed.
+    consumedInFront += count;
+    buffered -= count;
+    if (consumedInFront == chunks.front().size()) {
+        chunks.pop_front();
+        consumedInFront = 0;
+    }
+    signal(notFull);
+
+    monitorOut();
+}
+
+void ComputationStream::cancel() {
+    monitorIn();
+
+    cancelled = true;
+    // The engine may be reading the front chunk outside the monitor, consume() releases it
+    if (lent) {
+        chunks.erase(chunks.begin() + 1, chunks.end());
+    } else {
+        chunks.clear();
+    }
+    buffered = 0;
+    signal(notFull);
+    wakeReader();
+
+    monitorOut();
+}
+
+void ComputationStream::wakeReader() {
+    if (parkedReader != nullptr) {
+        parkedReader->unpark();
+        parkedReader = nullptr;
+    } else {
+        signal(notEmpty);
+    }
+}
@@ -0,0 +1,101 @@
+//     ____  __________     ___   ____ ___  _____ //
+//    / __ \/ ____/ __ \   |__ \ / __ \__ \|__  / //
+//   / /_/ / /   / / / /   __/ // / / /_/ / /_ <  //
+//  / ____/ /___/ /_/ /   / __// /_/ / __/___/ /  //
+// /_/    \____/\____/   /____/\____/____/____/   //
+// Auteurs : Timothée Van Hove, Aubry Mangold
+
+#ifndef COMPUTATIONSTREAM_H
+#define COMPUTATIONSTREAM_H
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+#include "pcosynchro/pcohoaremonitor.h"
+
+class Fiber;
+
+/**
+ * @brief The ComputationStream class carries the data of a computation that is still being produced, see
+ * ComputationManager::openComputation(). The client appends chunks of elements and closes the stream, the
+ * compute engine reduces each chunk as soon as it is appended. At most capacity elements wait in the stream,
+ * the client blocks beyond that until the engine has consumed them.
+ * It is implemented as a Hoare monitor, with a single client appending and a single engine consuming.
+ */
+class ComputationStream : protected PcoHoareMonitor
+{
+public:
+    /**
+     * @brief DEFAULT_CAPACITY The default number of elements buffered between the client and the engine
+     */
+    static constexpr std::size_t DEFAULT_CAPACITY = std::size_t{1} << 20;
+
+    /**
+     * @brief The Span struct is the part of a chunk that is ready to be consumed
+     */
+    struct Span
+    {
+        const double* values = nullptr;
+        std::size_t size = 0;
+    };
+
+    ComputationStream(int id, std::size_t capacity): id(id), capacity(capacity) {}
+
+    [[nodiscard]] int getId() const {return id;}
+
+    /**
+     * @brief append Appends a chunk of elements to the stream, waits while the stream is full. A chunk larger
+     * than the capacity is taken once the stream is empty.
+     * @param chunk the elements, moved into the stream
+     * @return false if the computation was aborted (or the manager stopped), the chunk is then dropped
+     */
+    bool append(std::vector<double> chunk);
+
+    /**
+     * @brief close Tells that the last chunk was appended, the engine then completes the computation
+     */
+    void close();
+
+    /**
+     * @brief next Waits until elements are ready to be consumed
+     * @note Called by the engine, a fiber parks while it waits
+     * @return the next elements, empty once the stream is closed and consumed or once it is cancelled
+     */
+    Span next();
+
+    /**
+     * @brief consume Releases the first count elements returned by next(), this frees room for the client.
+     * Must follow every non-empty next(), the span stays readable until then even if the stream is cancelled.
+     */
+    void consume(std::size_t count);
+
+    /**
+     * @brief cancel Drops the buffered chunks and releases both sides, the next calls do nothing
+     * @note Called by the manager when the computation is aborted or the manager stopped
+     */
+    void cancel();
+
+private:
+    const int id;
+    const std::size_t capacity;
+
+    std::deque<std::vector<double>> chunks;
+    std::size_t consumedInFront = 0;
+    std::size_t buffered = 0;
+    bool closed = false;
+    bool cancelled = false;
+    bool lent = false;  ///< True while the engine holds a span of the front chunk
+
+    Condition notFull;
+    Condition notEmpty;
+    Fiber* parkedReader = nullptr;
+
+    /**
+     * @brief wakeReader Wakes the engine waiting for elements
+     * @note Must be called from inside the monitor
+     */
+    void wakeReader();
+};
+
+#endif // COMPUTATIONSTREAM_H
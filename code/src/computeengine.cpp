@@ -1,5 +1,5 @@
 #include "computeengine.h"
 
-int ComputeEngineA::nextId = 0;
-int ComputeEngineB::nextId = 0;
 int ComputeEngineC::nextId = 0;
+int BatchedComputeEngineC::nextId = 0;
+int PolymorphicComputeEngine::nextId = 0;
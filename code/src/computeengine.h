@@ -9,10 +9,77 @@
 #ifndef COMPUTEENGINE_H
 #define COMPUTEENGINE_H
 
+#include <algorithm>
+#include <any>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <limits>
 #include <memory>
 #include <cmath>
 #include "computationmanager.h"
+#include "kernels.h"
 #include "launchable.h"
+#include "reductions.h"
+#include "utilization.h"
+
+/**
+ * @brief The Granularity struct sets how much work a compute engine does in one advanceComputation() step.
+ * A step stops after a given number of elements or, when a time budget is given, once the budget is spent.
+ * Cancellation and preemption (workDirective) are only checked between steps, a coarser granularity thus means
+ * fewer monitor round trips but a longer delay before an aborted or preempted computation actually stops.
+ */
+struct Granularity
+{
+    /**
+     * @brief DEFAULT_ELEMENTS The elements processed per step by default, enough for the kernels to run on whole
+     * vectors while a cancellation is still seen within a few microseconds
+     */
+    static constexpr std::size_t DEFAULT_ELEMENTS = 4096;
+
+    /**
+     * @brief elements The maximum number of elements processed per step, byElements(1) steps element by element
+     */
+    std::size_t elements = DEFAULT_ELEMENTS;
+
+    /**
+     * @brief timeBudget The time after which a step stops, zero if the step is only bounded by elements
+     */
+    std::chrono::nanoseconds timeBudget{0};
+
+    static Granularity byElements(std::size_t elements) {return {std::max<std::size_t>(elements, 1), {}};}
+    static Granularity byTime(std::chrono::nanoseconds budget) {return {std::numeric_limits<std::size_t>::max(), budget};}
+
+    /**
+     * @brief TIME_SLICE Number of elements processed between two clock reads when the step is bounded by time
+     */
+    static constexpr std::size_t TIME_SLICE = 4096;
+
+    /**
+     * @brief advance Processes the next chunk of [position, size) according to the granularity
+     * @param position the position of the next element, updated to the end of the processed chunk
+     * @param size the number of elements to process in total
+     * @param kernel called with consecutive [first, last) index ranges to process
+     */
+    template <typename Kernel>
+    void advance(std::size_t& position, std::size_t size, Kernel kernel) const {
+        auto remaining = std::min(elements, size - position);
+
+        if (timeBudget.count() == 0) {
+            kernel(position, position + remaining);
+            position += remaining;
+            return;
+        }
+
+        auto const deadline = std::chrono::steady_clock::now() + timeBudget;
+        do {
+            auto const slice = std::min(TIME_SLICE, remaining);
+            kernel(position, position + slice);
+            position += slice;
+            remaining -= slice;
+        } while (remaining > 0 && std::chrono::steady_clock::now() < deadline);
+    }
+};
 
 /**
  * @brief The AbstractComputeEngine class specifies the base functions that all compute engines
@@ -33,9 +100,9 @@ protected:
 
     /**
      * @brief startComputation Starts a computation for a given request
-     * @param r the computation request
+     * @param r the computation request, moved into the engine
      */
-    virtual void startComputation(const Request& r) = 0;
+    virtual void startComputation(Request r) = 0;
 
     /**
      * @brief advanceComputation Advances the current computation
@@ -54,12 +121,30 @@ protected:
      */
     [[nodiscard]] virtual double getResult() const = 0;
 
+    /**
+     * @brief getResultStatus returns whether the result of the computation is valid
+     * @return the status of the result
+     */
+    [[nodiscard]] virtual ResultStatus getResultStatus() const = 0;
+
+    /**
+     * @brief makeResult Builds the result of the computation to be provided to the manager
+     * @return the result, a partial result if the current request is a shard
+     */
+    [[nodiscard]] virtual Result makeResult() const = 0;
+
     /**
      * @brief getCurrentRequestId Returns the id of the current request
      * @return the id of the current request
      */
     [[nodiscard]] virtual int getCurrentRequestId() const = 0;
 
+    /**
+     * @brief saveComputation Saves the progress of the current computation so that it can be resumed later
+     * @return the current request, with the state of the computation in its checkpoint if it can be resumed
+     */
+    [[nodiscard]] virtual Request saveComputation() const = 0;
+
     /**
      * @brief stopComputation Stops the current omputation
      */
@@ -76,40 +161,77 @@ protected:
     const int id;
 };
 
+/**
+ * @brief runComputation Runs the computation an engine has just started: advances it a step at a time and
+ * provides its result once it is done, between two steps yields or drops it as the manager directs. This is
+ * the step loop of every compute engine below.
+ * @param computation gives advance(), isDone(), makeResult(), save(), stop() and getId() of the computation
+ */
+template <typename Computation>
+void runComputation(ComputeEngineInterface& manager, UtilizationCounters& utilization, Computation computation) {
+    for (;;) {
+        // Continue with computation (do partial computation)
+        computation.advance();
+
+        // If done provide the result to the manager
+        if (computation.isDone()) {
+            computation.stop();
+            utilization.work();
+            utilization.complete();
+            manager.provideResult(computation.makeResult());
+            utilization.blocked();
+            return;
+        }
+        // else if I should yield, give the request back with my progress
+        auto const directive = manager.workDirective(computation.getId());
+        // The check for cancellation is charged to the step, this takes a single clock read per step
+        utilization.work();
+        if (directive == WorkDirective::Yield) {
+            auto saved = computation.save();
+            auto const resumable = saved.hasCheckpoint();
+            manager.yieldWork(std::move(saved));
+            utilization.yield(resumable);
+            utilization.blocked();
+        } else if (directive == WorkDirective::Abort) {
+            utilization.abort();
+        }
+        // and if I should not continue, stop
+        if (directive != WorkDirective::Continue) {
+            computation.stop();
+            return;
+        }
+    }
+}
+
 /**
  * @brief The ComputeEngineBehavior class describes the behavior of all compute engines
  * given the abstract class above. This allows to describe the behavior without any
  * knowledge of the specific internal implementations of specific compute engines.
  */
-class ComputeEngineBehavior : private virtual AbstractComputeEngine, public Launchable
+class ComputeEngineBehavior : private virtual AbstractComputeEngine, public Launchable, public UtilizationReporter
 {
+public:
+    [[nodiscard]] EngineUtilization getUtilization() const override {
+        auto u = utilization.snapshot();
+        u.type = myType();
+        u.id = id;
+        return u;
+    }
+
 protected:
 
     /**
      * @brief run The behavior of a compute engine
      */
     void run() override {
+        utilization.start();
         try {
             for(;;) {
                 // Get a request from my type
-                startComputation(computationManager->getWork(myType()));
-
-                for(;;) {
-                    // Continue with computation (do partial computation)
-                    advanceComputation();
-
-                    // If done provide the result to the manager
-                    if (isComputationDone()) {
-                        stopComputation();
-                        computationManager->provideResult(Result(getCurrentRequestId(), getResult()));
-                        break;
-                    }
-                    // else if I should not continue, stop
-                    if (!computationManager->continueWork(getCurrentRequestId())) {
-                        stopComputation();
-                        break;
-                    }
-                }
+                auto request = computationManager->getWork(myType());
+                utilization.idle();
+                startComputation(std::move(request));
+                runComputation(*computationManager, utilization, Current{*this});
             }
         // I got interrupted
         } catch (ComputationManager::StopException& e) {
@@ -118,6 +240,97 @@ protected:
             return;
         }
     }
+
+    /**
+     * @brief utilization Where the engine spends its time, only written by the thread of the engine
+     */
+    UtilizationCounters utilization;
+
+private:
+    /**
+     * @brief The Current struct gives the current computation of the engine to runComputation()
+     */
+    struct Current
+    {
+        ComputeEngineBehavior& engine;
+
+        void advance() {engine.advanceComputation();}
+        [[nodiscard]] bool isDone() const {return engine.isComputationDone();}
+        [[nodiscard]] Result makeResult() const {return engine.makeResult();}
+        [[nodiscard]] Request save() const {return engine.saveComputation();}
+        void stop() {engine.stopComputation();}
+        [[nodiscard]] int getId() const {return engine.getCurrentRequestId();}
+    };
+};
+
+/**
+ * @brief The StaticComputeEngineBehavior class describes the same behavior as ComputeEngineBehavior for
+ * engines that give their functions statically (CRTP): none of the calls made per step is virtual, the
+ * compiler can thus inline the whole step loop.
+ * @tparam Derived the engine class, it gives the static TYPE member and the non-virtual functions
+ * startComputation(), advanceComputation(), isComputationDone(), makeResult(), getCurrentRequestId(),
+ * saveComputation() and stopComputation() (see AbstractComputeEngine for their documentation)
+ */
+template <typename Derived>
+class StaticComputeEngineBehavior : public Launchable, public UtilizationReporter
+{
+public:
+    explicit StaticComputeEngineBehavior(std::shared_ptr<ComputeEngineInterface> computationManager)
+        : computationManager(std::move(computationManager)) {}
+
+    [[nodiscard]] EngineUtilization getUtilization() const override {
+        auto u = utilization.snapshot();
+        u.type = Derived::TYPE;
+        u.id = static_cast<const Derived&>(*this).id;
+        return u;
+    }
+
+protected:
+    /**
+     * @brief run The behavior of a compute engine
+     */
+    void run() override {
+        auto& engine = static_cast<Derived&>(*this);
+        utilization.start();
+        try {
+            for (;;) {
+                auto request = computationManager->getWork(Derived::TYPE);
+                utilization.idle();
+                engine.startComputation(std::move(request));
+                runComputation(*computationManager, utilization, Current{engine});
+            }
+        } catch (ComputationManager::StopException& e) {
+            engine.stopComputation();
+            return;
+        }
+    }
+
+    /**
+     * @brief computationManager Pointer
+     */
+    const std::shared_ptr<ComputeEngineInterface> computationManager;
+
+    /**
+     * @brief utilization Where the engine spends its time, only written by the thread of the engine
+     */
+    UtilizationCounters utilization;
+
+private:
+    /**
+     * @brief The Current struct gives the current computation of the engine to runComputation(), the calls
+     * are resolved statically
+     */
+    struct Current
+    {
+        Derived& engine;
+
+        void advance() {engine.advanceComputation();}
+        [[nodiscard]] bool isDone() const {return engine.isComputationDone();}
+        [[nodiscard]] Result makeResult() const {return engine.makeResult();}
+        [[nodiscard]] Request save() const {return engine.saveComputation();}
+        void stop() {engine.stopComputation();}
+        [[nodiscard]] int getId() const {return engine.getCurrentRequestId();}
+    };
 };
 
 /**
@@ -125,19 +338,38 @@ protected:
  */
 class ComputeEngineCommon : public virtual AbstractComputeEngine, public ComputeEngineBehavior
 {
+public:
+    explicit ComputeEngineCommon(Granularity granularity = {}): granularity(granularity) {}
+
+    /**
+     * @brief setGranularity Sets how much work is done per advanceComputation() step
+     * @note Must not be called while the engine is running
+     */
+    void setGranularity(Granularity g) {granularity = g;}
+
 protected:
+    Granularity granularity;
     Request currentRequest;
-    std::shared_ptr<const std::vector<double>> data;
     bool computationDone = false;
     double result = 0.0;
+    ResultStatus resultStatus = ResultStatus::Ok;
     bool started = false;
 
     // Overriden functions, documentation is given in the AbstractComputeEngine class
-    void startComputation(const Request& r) override {currentRequest = r; data = r.data; computationDone = false;}
+    void startComputation(Request r) override {currentRequest = std::move(r); computationDone = false; resultStatus = ResultStatus::Ok;}
     [[nodiscard]] bool isComputationDone() const override {return computationDone;}
     [[nodiscard]] double getResult() const override {return result;}
+    [[nodiscard]] ResultStatus getResultStatus() const override {return resultStatus;}
     [[nodiscard]] int getCurrentRequestId() const override {return currentRequest.getId();}
+    // Engines that do not save their progress start the computation over when it is resumed
+    [[nodiscard]] Request saveComputation() const override {return currentRequest;}
     void stopComputation() override {started = false;}
+    [[nodiscard]] Result makeResult() const override {
+        if (currentRequest.isShard()) {
+            return Result::partial(getCurrentRequestId(), currentRequest.getShard(), getResult(), 0, getResultStatus());
+        }
+        return Result(getCurrentRequestId(), getResult(), getResultStatus());
+    }
 
     // Allows the ComputeEngineGUI class to have access (to display events)
     friend class ComputeEngineGUI;
@@ -145,92 +377,284 @@ protected:
 
 // The compute engines below are just examples and could do any type of operation
 
-// Computation engine A will be an accumulator
-class ComputeEngineA : public ComputeEngineCommon
+/**
+ * @brief typeLetter Returns the letter of a computation type, used in the messages of the engines
+ */
+constexpr char typeLetter(ComputationType type) {return static_cast<char>('A' + static_cast<int>(type));}
+
+/**
+ * @brief The ReductionState class holds the progress of a reduction over the data of a request, it is
+ * shared by the reduction engines below
+ * @tparam Op the reduction operation (see reductions.h)
+ */
+template <typename Op>
+class ReductionState
 {
 public:
-    ComputeEngineA(std::shared_ptr<ComputationManager> computationManager): AbstractComputeEngine(std::move(computationManager), nextId++) {}
-
-protected:
-    [[nodiscard]] ComputationType myType() const override {return ComputationType::A;}
+    template <typename... OpArgs>
+    explicit ReductionState(OpArgs&&... opArgs): op(std::forward<OpArgs>(opArgs)...) {}
 
-    void startComputation(const Request& r) override {
-        ComputeEngineCommon::startComputation(r);
-        computationDone = false;
-        started = true;
-        result = 0.0;
+    /**
+     * @brief start Starts the reduction of a request, or resumes it if the request holds a checkpoint of it
+     */
+    void start(Request r) {
+        request = std::move(r);
+        if constexpr (StartsFromRequest<Op>::value) {
+            acc = op.identity(request);
+        } else {
+            acc = op.identity();
+        }
         position = 0;
+        streamDone = false;
+
+        if (auto const checkpoint = std::any_cast<Checkpoint>(&request.getCheckpoint())) {
+            acc = checkpoint->acc;
+            position = checkpoint->position;
+        }
+        request.setCheckpoint({});
+        // A shard or a resumed request starts away from where the kernel reads ahead
+        request.willNeed(position);
     }
 
-    void advanceComputation() override {
-        if (position < data->size()) {
-            result += data->at(position++);
-        } else {
-            computationDone = true;
+    /**
+     * @brief save Returns the request with the progress of the reduction in its checkpoint
+     */
+    [[nodiscard]] Request save() const {
+        auto saved = request;
+        saved.setCheckpoint(Checkpoint{acc, position});
+        return saved;
+    }
+
+    /**
+     * @brief advance Reduces the next chunk of the data
+     */
+    void advance(const Granularity& granularity) {
+        if (auto const stream = request.getStream()) {
+            advanceStream(*stream, granularity);
+            return;
+        }
+
+        switch (request.getElementType()) {
+        case ElementType::Float32: reduce(request.elements<float>(), granularity); break;
+        case ElementType::Int32:   reduce(request.elements<std::int32_t>(), granularity); break;
+        case ElementType::Int64:   reduce(request.elements<std::int64_t>(), granularity); break;
+        default:                   reduce(request.values(), granularity); break;
+        }
+
+        // Skip the rest of the data once it can not change the result
+        if (op.isFinal(acc)) {
+            position = request.size();
         }
     }
 
-    void printStartMessage() const override {qDebug() << "[START] Compute Engine A -" << id << "launched";}
-    void printCompletionMessage() const override {qDebug() << "[STOP] Compute Engine A -" << id;}
+    [[nodiscard]] bool isDone() const {return request.getStream() ? streamDone : position == request.size();}
+    [[nodiscard]] double value() const {return op.value(acc);}
+    [[nodiscard]] ResultStatus status() const {return op.status(acc);}
+    [[nodiscard]] int getRequestId() const {return request.getId();}
+
+    // The status of a partial result is only known once the partial results are combined, except for the
+    // overflow of an integer sum which can not be undone
+    [[nodiscard]] Result makeResult() const {
+        // Mapped elements are reduced as doubles, there is no exact result
+        auto const integer = isInteger(request.getElementType()) && request.getMap().empty();
+        auto result = Result(request.getId(), value(), status());
+        if (request.isShard()) {
+            auto const [partial, exponent] = op.partial(acc);
+            result = Result::partial(request.getId(), request.getShard(), partial, exponent,
+                                     integer ? status() : ResultStatus::Ok);
+        }
+        if constexpr (HasExactResult<Op>::value) {
+            if (integer) {
+                result.setExactResult(op.exact(acc));
+            }
+        }
+        if constexpr (HasAggregates<Op>::value) {
+            result.setAggregates(op.aggregates(acc));
+        }
+        return result;
+    }
+
 private:
-    size_t position = 0;
+    /**
+     * @brief The Checkpoint struct is the state saved with a preempted request
+     */
+    struct Checkpoint {
+        typename Op::Accumulator acc;
+        std::size_t position;
+    };
 
-    static int nextId;
+    /**
+     * @brief reduce Reduces the next chunk of the elements of the request, with the kernel of their type or
+     * fused with the element map of the request
+     */
+    template <typename T>
+    void reduce(const T* values, const Granularity& granularity) {
+        granularity.advance(position, request.size(), [this, values](std::size_t first, std::size_t last) {
+            if (request.getMap().empty()) {
+                accumulateElements(op, acc, values + first, last - first);
+            } else {
+                accumulateMapped(op, acc, request.getMap(), values + first, last - first);
+            }
+        });
+    }
+
+    /**
+     * @brief advanceStream Reduces the next chunk of the elements appended to a stream, waits for the client
+     * if none is ready. The progress is kept by the stream, a yielded request resumes where it stopped.
+     */
+    void advanceStream(ComputationStream& stream, const Granularity& granularity) {
+        auto const span = stream.next();
+        if (span.size == 0) {
+            streamDone = true;
+            return;
+        }
+
+        std::size_t consumed = 0;
+        granularity.advance(consumed, span.size, [this, &span](std::size_t first, std::size_t last) {
+            op.accumulate(acc, span.values + first, last - first);
+        });
+        stream.consume(consumed);
+        position += consumed;
+    }
+
+    const Op op;
+    Request request;
+    typename Op::Accumulator acc{};
+    std::size_t position = 0;
+    bool streamDone = false;
 };
 
-// Computation engine B will be a multiplier
-class ComputeEngineB : public ComputeEngineCommon
+/**
+ * @brief The ReductionEngine class reduces the data of the requests of a type with a reduction operation
+ * (see reductions.h). The operation is a template parameter so that its kernel is inlined in the engine.
+ * @tparam Type the type of computation the engine does
+ * @tparam Op the reduction operation
+ */
+template <ComputationType Type, typename Op>
+class ReductionEngine : public ComputeEngineCommon
 {
 public:
-    ComputeEngineB(std::shared_ptr<ComputationManager> computationManager): AbstractComputeEngine(std::move(computationManager), nextId++) {}
+    static constexpr ComputationType TYPE = Type;
+
+    /**
+     * @brief ReductionEngine Constructs the engine, the arguments after the granularity construct the operation
+     */
+    template <typename... OpArgs>
+    explicit ReductionEngine(std::shared_ptr<ComputationManager> computationManager, Granularity granularity = {},
+                             OpArgs&&... opArgs)
+        : AbstractComputeEngine(std::move(computationManager), nextId++), ComputeEngineCommon(granularity),
+          reduction(std::forward<OpArgs>(opArgs)...) {}
 
 protected:
-    [[nodiscard]] ComputationType myType() const override {return ComputationType::B;}
+    [[nodiscard]] ComputationType myType() const override {return Type;}
 
-    void startComputation(const Request& r) override {
+    // The reduction computes on its own copy of the request, currentRequest is kept for the GUI
+    void startComputation(Request r) override {
         ComputeEngineCommon::startComputation(r);
-        computationDone = false;
         started = true;
-        result = 1.0;
-        position = 0;
+        reduction.start(std::move(r));
+        result = reduction.value();
     }
 
     void advanceComputation() override {
-        if (position < data->size()) {
-            result *= data->at(position++);
-        } else {
-            computationDone = true;
-        }
+        reduction.advance(granularity);
+        result = reduction.value();
+        resultStatus = reduction.status();
+        computationDone = reduction.isDone();
     }
 
-    void printStartMessage() const override {qDebug() << "[START] Compute Engine B -" << id << "launched";}
-    void printCompletionMessage() const override {qDebug() << "[STOP] Compute Engine B -" << id;}
+    [[nodiscard]] Result makeResult() const override {return reduction.makeResult();}
+    [[nodiscard]] int getCurrentRequestId() const override {return reduction.getRequestId();}
+    [[nodiscard]] Request saveComputation() const override {return reduction.save();}
+
+    void printStartMessage() const override {qDebug() << "[START] Compute Engine" << typeLetter(Type) << "-" << id << "launched";}
+    void printCompletionMessage() const override {qDebug() << "[STOP] Compute Engine" << typeLetter(Type) << "-" << id;}
 private:
-    size_t position = 0;
+    ReductionState<Op> reduction;
 
     static int nextId;
 };
 
+template <ComputationType Type, typename Op>
+int ReductionEngine<Type, Op>::nextId = 0;
+
+/**
+ * @brief The StaticReductionEngine class is the ReductionEngine without virtual calls in its step loop.
+ * It can not be displayed by the GUI, which needs a ComputeEngineCommon.
+ * @tparam Type the type of computation the engine does
+ * @tparam Op the reduction operation
+ */
+template <ComputationType Type, typename Op>
+class StaticReductionEngine : public StaticComputeEngineBehavior<StaticReductionEngine<Type, Op>>
+{
+public:
+    static constexpr ComputationType TYPE = Type;
+
+    /**
+     * @brief StaticReductionEngine Constructs the engine, the arguments after the granularity construct the operation
+     */
+    template <typename... OpArgs>
+    explicit StaticReductionEngine(std::shared_ptr<ComputeEngineInterface> computationManager, Granularity granularity = {},
+                                   OpArgs&&... opArgs)
+        : StaticComputeEngineBehavior<StaticReductionEngine>(std::move(computationManager)), granularity(granularity),
+          reduction(std::forward<OpArgs>(opArgs)...), id(nextId++) {}
+
+protected:
+    void startComputation(Request r) {reduction.start(std::move(r));}
+    void advanceComputation() {reduction.advance(granularity);}
+    [[nodiscard]] bool isComputationDone() const {return reduction.isDone();}
+    [[nodiscard]] Result makeResult() const {return reduction.makeResult();}
+    [[nodiscard]] int getCurrentRequestId() const {return reduction.getRequestId();}
+    [[nodiscard]] Request saveComputation() const {return reduction.save();}
+    void stopComputation() {}
+
+    void printStartMessage() const override {qDebug() << "[START] Static Compute Engine" << typeLetter(Type) << "-" << id << "launched";}
+    void printCompletionMessage() const override {qDebug() << "[STOP] Static Compute Engine" << typeLetter(Type) << "-" << id;}
+
+    friend class StaticComputeEngineBehavior<StaticReductionEngine>;
+private:
+    const Granularity granularity;
+    ReductionState<Op> reduction;
+    const int id;
+
+    static int nextId;
+};
+
+template <ComputationType Type, typename Op>
+int StaticReductionEngine<Type, Op>::nextId = 0;
+
+// Computation engine A will be an accumulator
+using ComputeEngineA = ReductionEngine<ComputationType::A, SumReduction>;
+
+// Computation engine B will be a multiplier
+using ComputeEngineB = ReductionEngine<ComputationType::B, ProductReduction>;
+
+// Computation engine D gives several aggregates at once
+using ComputeEngineD = ReductionEngine<ComputationType::D, AggregateReduction>;
+
 // Computation engine C will be a simple divider
 class ComputeEngineC : public ComputeEngineCommon
 {
 public:
+    static constexpr ComputationType TYPE = ComputationType::C;
+
     ComputeEngineC(std::shared_ptr<ComputationManager> computationManager): AbstractComputeEngine(std::move(computationManager), nextId++) {}
 protected:
     [[nodiscard]] ComputationType myType() const override {return ComputationType::C;}
 
-    void startComputation(const Request& r) override {
-        ComputeEngineCommon::startComputation(r);
+    void startComputation(Request r) override {
+        ComputeEngineCommon::startComputation(std::move(r));
         computationDone = false;
         started = true;
     }
 
     void advanceComputation() override {
-        if (data->size() != 2) {
+        // Division requires exactly two operands
+        if (currentRequest.size() != 2) {
             result = NAN;
-            qDebug() << "Division requires exactly two operands";
+            resultStatus = ResultStatus::InvalidOperands;
         } else {
-            result = data->at(0) / data->at(1);
+            result = currentRequest.values()[0] / currentRequest.values()[1];
         }
         computationDone = true;
     }
@@ -241,4 +665,297 @@ private:
     static int nextId;
 };
 
+// Batched computation engine C takes many division requests at once and divides them with a vector kernel
+class BatchedComputeEngineC : public Launchable, public UtilizationReporter
+{
+public:
+    static constexpr ComputationType TYPE = ComputationType::C;
+
+    /**
+     * @brief DEFAULT_BATCH_SIZE The default maximum number of requests taken per getWorkBatch()
+     */
+    static constexpr std::size_t DEFAULT_BATCH_SIZE = 256;
+
+    BatchedComputeEngineC(std::shared_ptr<ComputeEngineInterface> computationManager, std::size_t batchSize = DEFAULT_BATCH_SIZE)
+        : computationManager(std::move(computationManager)), batchSize(batchSize), id(nextId++) {}
+
+    [[nodiscard]] EngineUtilization getUtilization() const override {
+        auto u = utilization.snapshot();
+        u.type = TYPE;
+        u.id = id;
+        return u;
+    }
+
+protected:
+    void run() override {
+        utilization.start();
+        try {
+            for (;;) {
+                auto const requests = computationManager->getWorkBatch(ComputationType::C, batchSize);
+                utilization.idle();
+                auto results = compute(requests);
+                utilization.work();
+                utilization.complete(requests.size());
+                computationManager->provideResults(std::move(results));
+                utilization.blocked();
+            }
+        } catch (ComputationManager::StopException& e) {
+            return;
+        }
+    }
+
+    /**
+     * @brief compute Divides the operands of a batch of requests
+     * @param requests the requests of the batch
+     * @return the results, in the order of the requests
+     */
+    std::vector<Result> compute(const std::vector<Request>& requests) {
+        auto const n = requests.size();
+
+        // Pack the operands as structure of arrays so that the divisions vectorize. Malformed requests
+        // divide NaN by one, which gives the NaN they are expected to return.
+        numerators.resize(n);
+        denominators.resize(n);
+        quotients.resize(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            auto const operands = requests[i].values();
+            auto const valid = requests[i].size() == 2;
+            numerators[i] = valid ? operands[0] : NAN;
+            denominators[i] = valid ? operands[1] : 1.0;
+        }
+
+        divide(numerators.data(), denominators.data(), quotients.data(), n);
+
+        std::vector<Result> results;
+        results.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            auto const status = requests[i].size() == 2 ? ResultStatus::Ok : ResultStatus::InvalidOperands;
+            results.emplace_back(requests[i].getId(), quotients[i], status);
+        }
+        return results;
+    }
+
+    void printStartMessage() const override {qDebug() << "[START] Batched Compute Engine C -" << id << "launched";}
+    void printCompletionMessage() const override {qDebug() << "[STOP] Batched Compute Engine C -" << id;}
+
+private:
+    const std::shared_ptr<ComputeEngineInterface> computationManager;
+    const std::size_t batchSize;
+    const int id;
+    UtilizationCounters utilization;
+
+    // Reused between batches to avoid allocating at every batch
+    std::vector<double> numerators;
+    std::vector<double> denominators;
+    std::vector<double> quotients;
+
+    static int nextId;
+};
+
+/**
+ * @brief The ComputeKernel class is a computation that a PolymorphicComputeEngine runs on the requests of a type
+ */
+class ComputeKernel
+{
+public:
+    virtual ~ComputeKernel() = default;
+
+    /**
+     * @brief start Starts the computation of a request
+     */
+    virtual void start(Request r) = 0;
+
+    /**
+     * @brief advance Does the next part of the computation
+     */
+    virtual void advance(const Granularity& granularity) = 0;
+
+    [[nodiscard]] virtual bool isDone() const = 0;
+    [[nodiscard]] virtual Result makeResult() const = 0;
+
+    /**
+     * @brief save Returns the current request with the progress of the computation, see AbstractComputeEngine::saveComputation()
+     */
+    [[nodiscard]] virtual Request save() const = 0;
+};
+
+// Kernel running a reduction operation (see reductions.h)
+template <typename Op>
+class ReductionKernel : public ComputeKernel
+{
+public:
+    template <typename... OpArgs>
+    explicit ReductionKernel(OpArgs&&... opArgs): reduction(std::forward<OpArgs>(opArgs)...) {}
+
+    void start(Request r) override {reduction.start(std::move(r));}
+    void advance(const Granularity& granularity) override {reduction.advance(granularity);}
+    [[nodiscard]] bool isDone() const override {return reduction.isDone();}
+    [[nodiscard]] Result makeResult() const override {return reduction.makeResult();}
+    [[nodiscard]] Request save() const override {return reduction.save();}
+
+private:
+    ReductionState<Op> reduction;
+};
+
+// Kernel dividing the two operands of a request, like ComputeEngineC
+class DivisionKernel : public ComputeKernel
+{
+public:
+    void start(Request r) override {request = std::move(r); done = false;}
+
+    void advance(const Granularity&) override {
+        if (request.size() != 2) {
+            result = NAN;
+            status = ResultStatus::InvalidOperands;
+        } else {
+            result = request.values()[0] / request.values()[1];
+            status = ResultStatus::Ok;
+        }
+        done = true;
+    }
+
+    [[nodiscard]] bool isDone() const override {return done;}
+    [[nodiscard]] Result makeResult() const override {return Result(request.getId(), result, status);}
+    [[nodiscard]] Request save() const override {return request;}
+
+private:
+    Request request;
+    double result = 0.0;
+    ResultStatus status = ResultStatus::Ok;
+    bool done = false;
+};
+
+/**
+ * @brief The KernelRegistry class tells which kernel computes each computation type
+ */
+class KernelRegistry
+{
+public:
+    using Factory = std::function<std::unique_ptr<ComputeKernel>()>;
+
+    /**
+     * @brief add Registers the kernel of a type, replacing the previous one
+     * @param factory creates the kernel, each engine has its own kernels
+     */
+    void add(ComputationType type, Factory factory) {factories[type] = std::move(factory);}
+
+    /**
+     * @brief add Registers a kernel class for a type, its instances are constructed with the given arguments
+     */
+    template <typename Kernel, typename... Args>
+    void add(ComputationType type, Args... args) {
+        add(type, [args...] {return std::make_unique<Kernel>(args...);});
+    }
+
+    /**
+     * @brief types Returns the types that have a kernel
+     */
+    [[nodiscard]] TypeMask types() const {
+        TypeMask mask;
+        for (std::size_t i = 0; i < TYPE_COUNT; ++i) {
+            if (factories[i]) {
+                mask = mask | static_cast<ComputationType>(i);
+            }
+        }
+        return mask;
+    }
+
+    /**
+     * @brief create Creates the kernel of a type, nullptr if the type has none
+     */
+    [[nodiscard]] std::unique_ptr<ComputeKernel> create(ComputationType type) const {
+        auto const& factory = factories[static_cast<std::size_t>(type)];
+        return factory ? factory() : nullptr;
+    }
+
+    /**
+     * @brief defaults Returns the registry of the kernels of the A, B and C engines
+     */
+    static KernelRegistry defaults() {
+        KernelRegistry registry;
+        registry.add<ReductionKernel<SumReduction>>(ComputationType::A);
+        registry.add<ReductionKernel<ProductReduction>>(ComputationType::B);
+        registry.add<DivisionKernel>(ComputationType::C);
+        registry.add<ReductionKernel<AggregateReduction>>(ComputationType::D);
+        return registry;
+    }
+
+private:
+    static constexpr auto TYPE_COUNT = static_cast<std::size_t>(ComputationType::COUNT);
+
+    EnumIndexedArray<Factory, TYPE_COUNT> factories;
+};
+
+// Polymorphic computation engine serves the requests of every type it has a kernel for, taking the work
+// where there is some so that a single pool of engines keeps busy whatever the mix of requests
+class PolymorphicComputeEngine : public Launchable, public UtilizationReporter
+{
+public:
+    explicit PolymorphicComputeEngine(std::shared_ptr<ComputeEngineInterface> computationManager,
+                                      const KernelRegistry& registry = KernelRegistry::defaults(),
+                                      Granularity granularity = {})
+        : computationManager(std::move(computationManager)), types(registry.types()), granularity(granularity),
+          id(nextId++), currentType(ComputationType::COUNT) {
+        for (std::size_t i = 0; i < kernels.size(); ++i) {
+            kernels[i] = registry.create(static_cast<ComputationType>(i));
+        }
+    }
+
+    [[nodiscard]] EngineUtilization getUtilization() const override {
+        auto u = utilization.snapshot();
+        u.type = currentType.load(std::memory_order_relaxed);
+        u.id = id;
+        return u;
+    }
+
+protected:
+    void run() override {
+        utilization.start();
+        try {
+            for (;;) {
+                auto request = computationManager->getWork(types);
+                utilization.idle();
+                auto const id = request.getId();
+                currentType.store(request.getType(), std::memory_order_relaxed);
+                auto& kernel = *kernels[request.getType()];
+                kernel.start(std::move(request));
+                runComputation(*computationManager, utilization, Current{kernel, granularity, id});
+            }
+        } catch (ComputationManager::StopException& e) {
+            return;
+        }
+    }
+
+    void printStartMessage() const override {qDebug() << "[START] Polymorphic Compute Engine -" << id << "launched";}
+    void printCompletionMessage() const override {qDebug() << "[STOP] Polymorphic Compute Engine -" << id;}
+
+private:
+    /**
+     * @brief The Current struct gives the computation of a kernel to runComputation()
+     */
+    struct Current
+    {
+        ComputeKernel& kernel;
+        const Granularity& granularity;
+        const int id;
+
+        void advance() {kernel.advance(granularity);}
+        [[nodiscard]] bool isDone() const {return kernel.isDone();}
+        [[nodiscard]] Result makeResult() const {return kernel.makeResult();}
+        [[nodiscard]] Request save() const {return kernel.save();}
+        void stop() {}
+        [[nodiscard]] int getId() const {return id;}
+    };
+
+    const std::shared_ptr<ComputeEngineInterface> computationManager;
+    const TypeMask types;
+    const Granularity granularity;
+    const int id;
+    UtilizationCounters utilization;
+    std::atomic<ComputationType> currentType;  ///< The type of the kernel run last, COUNT before the first one
+    EnumIndexedArray<std::unique_ptr<ComputeKernel>, static_cast<std::size_t>(ComputationType::COUNT)> kernels;
+
+    static int nextId;
+};
+
 #endif // COMPUTEENGINE_H
@@ -11,8 +11,65 @@
 #ifndef COMPUTEENVIRONMENT_H
 #define COMPUTEENVIRONMENT_H
 
+#include <array>
+#include <atomic>
+#include <type_traits>
+
+#include "autoscaler.h"
 #include "computationmanager.h"
 #include "computeengine.h"
+#include "fiber.h"
+#include "placement.h"
+#include "utilization.h"
+
+/**
+ * @brief The EngineList struct lists the compute engine classes of an environment, one per computation type.
+ * Each engine class gives the type it computes in its static TYPE member.
+ */
+template <typename... Engines>
+struct EngineList
+{
+    /**
+     * @brief The Tag struct carries an engine class to a generic lambda
+     */
+    template <typename Engine>
+    struct Tag {using type = Engine;};
+
+    /**
+     * @brief forType Calls f with the Tag of the engine class registered for a computation type
+     * @return false if no engine class is registered for the type
+     */
+    template <typename F>
+    static bool forType(ComputationType type, F&& f) {
+        return ((Engines::TYPE == type ? (f(Tag<Engines>{}), true) : false) || ...);
+    }
+};
+
+/**
+ * @brief The ExecutionMode enum tells whether each compute engine has its own thread or the engines run on
+ * fibers multiplexed over a few worker threads
+ */
+enum class ExecutionMode {Threads, Fibers};
+
+/**
+ * @brief The Execution struct sets how the compute engines of an environment are run. With fibers, an engine
+ * costs a small stack instead of a thread and an engine waiting for work parks its fiber, many more engines
+ * than processors can thus be started.
+ */
+struct Execution
+{
+    ExecutionMode mode = ExecutionMode::Threads;
+
+    /**
+     * @brief workers The number of worker threads running the fibers
+     */
+    unsigned workers = 1;
+
+    /**
+     * @brief stackSize The stack size of each fiber
+     */
+    std::size_t stackSize = Fiber::DEFAULT_STACK_SIZE;
+};
 
 /**
  * @brief The ComputeEnvironment class represents a compute environment with compute engines and allows to launch them
@@ -20,28 +77,123 @@
 class ComputeEnvironment
 {
 public:
+    /**
+     * @brief Engines The compute engines created for each computation type
+     * @note In place of ComputeEngineA, B and C: the static engines give the same results without a virtual
+     * call per step, and the batched C engine takes its divisions a batch at a time.
+     */
+    using Engines = EngineList<StaticReductionEngine<ComputationType::A, SumReduction>,
+                               StaticReductionEngine<ComputationType::B, ProductReduction>,
+                               BatchedComputeEngineC,
+                               StaticReductionEngine<ComputationType::D, AggregateReduction>>;
+
     /**
      * @brief ComputeEnvironment Constructs the compute environment that is attached to a given buffer
      * @param computationManager
+     * @param granularity the amount of work the A and B engines do between two checks for cancellation
+     * @param placement where the threads of the engines run (not applied to engines running on fibers)
+     * @param execution whether the engines run on threads or on fibers
      */
-    ComputeEnvironment(std::shared_ptr<ComputationManager> computationManager): computationManager(std::move(computationManager)) {}
+    ComputeEnvironment(std::shared_ptr<ComputationManager> computationManager, Granularity granularity = {},
+                       Placement placement = {}, Execution execution = {})
+        : computationManager(std::move(computationManager)), granularity(granularity), placement(placement),
+          execution(execution) {}
 
     /**
-     * @brief populateComputeEnvironment adds compute engines to the environment
+     * @brief allocatePayload Allocates the (zeroed) data of a computation, on the NUMA node of the engines of
+     * its type if the placement asks for first touch (from the PayloadPool otherwise)
+     * @param type the type of the computation
+     * @param size the number of elements
+     */
+    std::shared_ptr<std::vector<double>> allocatePayload(ComputationType type, std::size_t size) const {
+        if (!placement.firstTouch || !placement.groupByType) {
+            return PayloadPool::acquire(size);
+        }
+        auto const& topology = CpuTopology::system();
+        return allocateOnCpus(size, topology.cpusOfNode(static_cast<std::size_t>(type) % topology.nodeCount()));
+    }
+
+    /**
+     * @brief populateComputeEnvironment adds compute engines to the environment (none of type D)
      */
     void populateComputeEnvironment() {
-        addComputeEngine(ComputationType::A, 2);
-        addComputeEngine(ComputationType::B);
-        addComputeEngine(ComputationType::C);
+        populateComputeEnvironment(2, 1, 1);
+    }
+
+    /**
+     * @brief populateComputeEnvironment adds the given number of compute engines of each type to the environment
+     */
+    void populateComputeEnvironment(unsigned a, unsigned b, unsigned c, unsigned d = 0) {
+        addComputeEngine(ComputationType::A, a);
+        addComputeEngine(ComputationType::B, b);
+        addComputeEngine(ComputationType::C, c);
+        addComputeEngine(ComputationType::D, d);
+    }
+
+    /**
+     * @brief populateAutoscaledComputeEnvironment adds an autoscaler that starts and retires the engines of
+     * every type according to the pressure on their buffers, in place of a fixed number of engines
+     * @note The autoscaler and its engines always run on threads
+     * @param policy the limits and thresholds of every type
+     */
+    void populateAutoscaledComputeEnvironment(ScalingPolicy policy = {}) {
+        auto autoscaler = std::make_shared<Autoscaler>(computationManager);
+        for (auto type : {ComputationType::A, ComputationType::B, ComputationType::C, ComputationType::D}) {
+            Engines::forType(type, [&](auto tag) {
+                autoscaler->addType(type, [this] {return makeEngine<typename decltype(tag)::type>();}, policy);
+            });
+        }
+        threads.push_back(autoscaler);
+    }
+
+    /**
+     * @brief addPolymorphicComputeEngines adds compute engines that serve every registered type
+     * @param quantity the number of engines, typically the number of cores
+     * @param registry the kernels of the types
+     */
+    void addPolymorphicComputeEngines(unsigned quantity, const KernelRegistry& registry = KernelRegistry::defaults()) {
+        for (unsigned i = 0; i < quantity; ++i) {
+            auto engine = std::make_shared<PolymorphicComputeEngine>(computationManager, registry, granularity);
+            place(*engine, -1);
+            threads.push_back(engine);
+        }
+    }
+
+    /**
+     * @brief getUtilization Returns a snapshot of the utilization of every engine of the environment (the
+     * engines of the autoscaler are not included), may be called while the engines run
+     */
+    std::vector<EngineUtilization> getUtilization() const {
+        std::vector<EngineUtilization> utilization;
+        for (auto const& t : threads) {
+            if (auto const reporter = dynamic_cast<const UtilizationReporter*>(t.get())) {
+                utilization.push_back(reporter->getUtilization());
+            }
+        }
+        return utilization;
     }
 
     /**
      * @brief startComputeEnvironment starts the compute engines in the environment
      */
     void startComputeEnvironment() {
+        if (execution.mode == ExecutionMode::Threads) {
+            for (auto& t : threads) {
+                t->startThread();
+            }
+            return;
+        }
+
+        // The autoscaler sleeps between two samples, it would hold a worker thread
+        scheduler = std::make_unique<FiberScheduler>(execution.workers, execution.stackSize);
         for (auto& t : threads) {
-            t->startThread();
+            if (std::dynamic_pointer_cast<Autoscaler>(t)) {
+                t->startThread();
+            } else {
+                t->startFiber(*scheduler);
+            }
         }
+        scheduler->start();
     }
 
     /**
@@ -51,6 +203,10 @@ public:
         for (auto& t : threads) {
             t->join();
         }
+        if (scheduler) {
+            scheduler->join();
+            scheduler = nullptr;
+        }
     }
 
 protected:
@@ -61,24 +217,51 @@ protected:
      */
     virtual void addComputeEngine(ComputationType type, unsigned quantity = 1) {
         for (unsigned i = 0; i < quantity; ++i) {
-            switch(type) {
-            case ComputationType::A :
-                threads.push_back(std::make_shared<ComputeEngineA>(computationManager));
-                break;
-            case ComputationType::B :
-                threads.push_back(std::make_shared<ComputeEngineB>(computationManager));
-                break;
-            case ComputationType::C :
-                threads.push_back(std::make_shared<ComputeEngineC>(computationManager));
-                break;
-            default:
-                break;
-            }
+            Engines::forType(type, [this](auto tag) {
+                threads.push_back(makeEngine<typename decltype(tag)::type>());
+            });
+        }
+    }
+
+    /**
+     * @brief makeEngine Creates an engine of the given class for the computation manager of the environment
+     */
+    template <typename Engine>
+    std::shared_ptr<Launchable> makeEngine() {
+        std::shared_ptr<Launchable> engine;
+        if constexpr (std::is_constructible_v<Engine, std::shared_ptr<ComputationManager>, Granularity>) {
+            engine = std::make_shared<Engine>(computationManager, granularity);
+        } else {
+            engine = std::make_shared<Engine>(computationManager);
         }
+        place(*engine, static_cast<int>(Engine::TYPE));
+        return engine;
+    }
+
+    /**
+     * @brief place Applies the placement to a new engine
+     * @param engine the engine, not started yet
+     * @param node the NUMA node of the type of the engine, negative if the engine serves several types
+     */
+    void place(Launchable& engine, int node) {
+        // Engines grouped on a node are spread over the node, the others over the whole machine
+        auto const index = placement.groupByType && node >= 0 ? placedPerNode[static_cast<std::size_t>(node)]++ : placed++;
+        engine.setPlacement(placement.cpusFor(node, index));
     }
 
     std::vector<std::shared_ptr<Launchable>> threads;
     std::shared_ptr<ComputationManager> computationManager;
+    const Granularity granularity;
+    const Placement placement;
+    const Execution execution;
+    std::unique_ptr<FiberScheduler> scheduler;
+
+    /**
+     * @brief The number of engines placed so far, per type when the engines are grouped by type.
+     * @note Atomic because the autoscaler creates engines from its own thread.
+     */
+    std::atomic<std::size_t> placed = 0;
+    std::array<std::atomic<std::size_t>, static_cast<std::size_t>(ComputationType::COUNT)> placedPerNode{};
 };
 
 #endif // COMPUTEENVIRONMENT_H
@@ -0,0 +1,103 @@
+//     ____  __________     ___   ____ ___  _____ //
+//    / __ \/ ____/ __ \   |__ \ / __ \__ \|__  / //
+//   / /_/ / /   / / / /   __/ // / / /_/ / /_ <  //
+//  / ____/ /___/ /_/ /   / __// /_/ / __/___/ /  //
+// /_/    \____/\____/   /____/\____/____/____/   //
+// Auteurs : Timothée Van Hove, Aubry Mangold
+
+#ifndef ELEMENTMAP_H
+#define ELEMENTMAP_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+/**
+ * @brief The MapOp enum lists the elementwise operations of an ElementMap
+ */
+enum class MapOp : std::uint8_t {
+    Scale,   ///< x * operand
+    Offset,  ///< x + operand
+    Square,  ///< x * x
+    Abs      ///< |x|
+};
+
+/**
+ * @brief The ElementMap class is a short list of elementwise operations applied, in order, to the elements of
+ * a computation before they are reduced, e.g. ElementMap().square() for a sum of squares or
+ * ElementMap().offset(-mean).square() for a variance. The reduction engines apply it a block at a time, fused
+ * with their kernel, so that the elements are read once and never copied.
+ * @note At most MAX_OPS operations, held inline: the map is copied with every request.
+ */
+class ElementMap
+{
+public:
+    static constexpr std::size_t MAX_OPS = 4;
+
+    [[nodiscard]] ElementMap scale(double factor) const {return with(MapOp::Scale, factor);}
+    [[nodiscard]] ElementMap offset(double term) const {return with(MapOp::Offset, term);}
+    [[nodiscard]] ElementMap square() const {return with(MapOp::Square, 0.0);}
+    [[nodiscard]] ElementMap abs() const {return with(MapOp::Abs, 0.0);}
+
+    [[nodiscard]] bool empty() const {return count == 0;}
+    [[nodiscard]] std::size_t size() const {return count;}
+
+    /**
+     * @brief operator() Maps a single element
+     */
+    [[nodiscard]] double operator()(double x) const {
+        apply(&x, &x, 1);
+        return x;
+    }
+
+    /**
+     * @brief apply Writes the n mapped elements of in to out, in and out may be the same array
+     * @note One pass over the elements per operation, each pass is a plain loop that vectorizes: out is meant
+     * to be a block that stays in the L1 cache
+     */
+    void apply(const double* in, double* out, std::size_t n) const {
+        if (count == 0 && in != out) {
+            std::copy(in, in + n, out);
+        }
+        for (std::size_t op = 0; op < count; ++op) {
+            auto const source = op == 0 ? in : out;
+            auto const operand = operands[op];
+            switch (ops[op]) {
+            case MapOp::Scale:
+                for (std::size_t i = 0; i < n; ++i) out[i] = source[i] * operand;
+                break;
+            case MapOp::Offset:
+                for (std::size_t i = 0; i < n; ++i) out[i] = source[i] + operand;
+                break;
+            case MapOp::Square:
+                for (std::size_t i = 0; i < n; ++i) out[i] = source[i] * source[i];
+                break;
+            case MapOp::Abs:
+                for (std::size_t i = 0; i < n; ++i) out[i] = std::fabs(source[i]);
+                break;
+            }
+        }
+    }
+
+private:
+    [[nodiscard]] ElementMap with(MapOp op, double operand) const {
+        if (count == MAX_OPS) {
+            throw std::length_error("An element map holds at most " + std::to_string(MAX_OPS) + " operations");
+        }
+        auto map = *this;
+        map.ops[count] = op;
+        map.operands[count] = operand;
+        ++map.count;
+        return map;
+    }
+
+    std::array<MapOp, MAX_OPS> ops{};
+    std::array<double, MAX_OPS> operands{};
+    std::size_t count{0};
+};
+
+#endif // ELEMENTMAP_H
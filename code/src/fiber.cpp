@@ -0,0 +1,197 @@
+//     ____  __________     ___   ____ ___  _____ //
+//    / __ \/ ____/ __ \   |__ \ / __ \__ \|__  / //
+//   / /_/ / /   / / / /   __/ // / / /_/ / /_ <  //
+//  / ____/ /___/ /_/ /   / __// /_/ / __/___/ /  //
+// /_/    \____/\____/   /____/\____/____/____/   //
+// Auteurs : Timothée Van Hove, Aubry Mangold
+
+#include "fiber.h"
+
+#include <new>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+// The fiber running on the thread and the context of the worker to switch back to. A fiber may move from
+// one worker to another when it is resumed, these must thus be read again after each switch: they are only
+// accessed from functions that are not inlined, so that the compiler does not reuse a thread-local address
+// computed before the switch.
+thread_local Fiber* runningFiber = nullptr;
+thread_local ucontext_t workerContext;
+
+std::size_t pageSize() {
+    static auto const size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+} // namespace
+
+Fiber::Fiber(FiberScheduler& scheduler, std::function<void()> entry, std::size_t stackSize, std::shared_ptr<PcoSemaphore> done)
+    : scheduler(scheduler), entry(std::move(entry)), done(std::move(done)) {
+    // The stack is mapped with an inaccessible guard page below it, an overflow then faults instead of
+    // silently overwriting another stack.
+    auto const page = pageSize();
+    auto const size = (stackSize + page - 1) / page * page;
+    mappedSize = size + page;
+    stack = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (stack == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    mprotect(stack, page, PROT_NONE);
+
+    getcontext(&context);
+    context.uc_stack.ss_sp = static_cast<char*>(stack) + page;
+    context.uc_stack.ss_size = size;
+    context.uc_link = nullptr;
+    makecontext(&context, &Fiber::trampoline, 0);
+}
+
+Fiber::~Fiber() {
+    munmap(stack, mappedSize);
+}
+
+[[gnu::noinline]] Fiber* Fiber::current() {
+    return runningFiber;
+}
+
+void Fiber::yield() {
+    switchOut(Action::Yield);
+}
+
+void Fiber::park() {
+    switchOut(Action::Park);
+}
+
+void Fiber::unpark() {
+    scheduler.unpark(this);
+}
+
+[[gnu::noinline]] void Fiber::switchOut(Action action) {
+    auto const self = runningFiber;
+    self->action = action;
+    swapcontext(&self->context, &workerContext);
+}
+
+void Fiber::trampoline() {
+    current()->entry();
+    switchOut(Action::Finish);
+}
+
+FiberScheduler::FiberScheduler(unsigned workers, std::size_t stackSize)
+    : workerCount(workers > 0 ? workers : 1), stackSize(stackSize) {}
+
+FiberScheduler::~FiberScheduler() {
+    if (!workers.empty()) {
+        join();
+    }
+    for (auto fiber : ready) {
+        delete fiber;
+    }
+}
+
+FiberScheduler::Handle FiberScheduler::spawn(std::function<void()> entry) {
+    auto done = std::make_shared<PcoSemaphore>(0);
+    auto const fiber = new Fiber(*this, std::move(entry), stackSize, done);
+
+    monitorIn();
+    ++live;
+    makeReady(fiber);
+    monitorOut();
+
+    return Handle(std::move(done));
+}
+
+void FiberScheduler::start() {
+    for (unsigned i = 0; i < workerCount; ++i) {
+        workers.push_back(std::make_unique<PcoThread>(&FiberScheduler::runWorker, this));
+    }
+}
+
+void FiberScheduler::join() {
+    monitorIn();
+    joining = true;
+    if (live == 0) {
+        signal(readyAvailable);
+    }
+    monitorOut();
+
+    for (auto& worker : workers) {
+        worker->join();
+    }
+    workers.clear();
+}
+
+void FiberScheduler::runWorker() {
+    for (;;) {
+        monitorIn();
+
+        while (ready.empty() && !(joining && live == 0)) {
+            wait(readyAvailable);
+        }
+
+        // Nothing left to run, the other idle workers are released in cascade.
+        if (ready.empty()) {
+            signal(readyAvailable);
+            monitorOut();
+            return;
+        }
+
+        auto const fiber = ready.front();
+        ready.pop_front();
+        monitorOut();
+
+        runningFiber = fiber;
+        swapcontext(&workerContext, &fiber->context);
+        runningFiber = nullptr;
+
+        resumed(fiber);
+    }
+}
+
+void FiberScheduler::makeReady(Fiber* fiber) {
+    ready.push_back(fiber);
+    signal(readyAvailable);
+}
+
+void FiberScheduler::resumed(Fiber* fiber) {
+    monitorIn();
+
+    switch (fiber->action) {
+    case Fiber::Action::Yield:
+        makeReady(fiber);
+        break;
+    case Fiber::Action::Park:
+        // The fiber may have been unparked between the moment it decided to park and its switch back.
+        if (fiber->notified) {
+            fiber->notified = false;
+            makeReady(fiber);
+        } else {
+            fiber->parked = true;
+        }
+        break;
+    case Fiber::Action::Finish:
+        fiber->done->release();
+        delete fiber;
+        if (--live == 0 && joining) {
+            signal(readyAvailable);
+        }
+        break;
+    }
+
+    monitorOut();
+}
+
+void FiberScheduler::unpark(Fiber* fiber) {
+    monitorIn();
+
+    if (fiber->parked) {
+        fiber->parked = false;
+        makeReady(fiber);
+    } else {
+        fiber->notified = true;
+    }
+
+    monitorOut();
+}
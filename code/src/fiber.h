@@ -0,0 +1,188 @@
+//     ____  __________     ___   ____ ___  _____ //
+//    / __ \/ ____/ __ \   |__ \ / __ \__ \|__  / //
+//   / /_/ / /   / / / /   __/ // / / /_/ / /_ <  //
+//  / ____/ /___/ /_/ /   / __// /_/ / __/___/ /  //
+// /_/    \____/\____/   /____/\____/____/____/   //
+// Auteurs : Timothée Van Hove, Aubry Mangold
+
+// User-space fibers multiplexed over a fixed number of worker threads (M:N scheduling).
+
+#ifndef FIBER_H
+#define FIBER_H
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <ucontext.h>
+
+#include <pcosynchro/pcohoaremonitor.h>
+#include <pcosynchro/pcosemaphore.h>
+#include <pcosynchro/pcothread.h>
+
+class FiberScheduler;
+
+/**
+ * @brief The Fiber class is a function running on its own small stack, switched in and out of the worker
+ * threads of a FiberScheduler. A fiber only leaves its worker when it yields or parks, it may then be
+ * resumed by another worker.
+ * @note A fiber must never park while it holds a lock that another fiber may need.
+ */
+class Fiber
+{
+public:
+    /**
+     * @brief DEFAULT_STACK_SIZE The default stack size of a fiber (a guard page is added below it)
+     */
+    static constexpr std::size_t DEFAULT_STACK_SIZE = 64 * 1024;
+
+    Fiber(const Fiber&) = delete;
+    Fiber& operator=(const Fiber&) = delete;
+    ~Fiber();
+
+    /**
+     * @brief current Returns the fiber running on the calling thread, nullptr on a regular thread
+     */
+    static Fiber* current();
+
+    /**
+     * @brief yield Lets the other ready fibers run, the calling fiber is resumed afterwards
+     * @note Must be called from a fiber
+     */
+    static void yield();
+
+    /**
+     * @brief park Suspends the calling fiber until unpark() is called on it. An unpark() that comes before
+     * the park() is kept, the fiber then goes on right away: the condition waited for must thus be checked
+     * again after parking.
+     * @note Must be called from a fiber
+     */
+    static void park();
+
+    /**
+     * @brief unpark Makes a parked fiber ready again, may be called from any thread or fiber
+     */
+    void unpark();
+
+private:
+    friend class FiberScheduler;
+
+    /**
+     * @brief The Action enum tells the worker why the fiber switched back to it
+     */
+    enum class Action {Yield, Park, Finish};
+
+    Fiber(FiberScheduler& scheduler, std::function<void()> entry, std::size_t stackSize, std::shared_ptr<PcoSemaphore> done);
+
+    /**
+     * @brief switchOut Switches from the calling fiber back to its worker
+     */
+    static void switchOut(Action action);
+
+    /**
+     * @brief trampoline The first function run on the stack of a fiber
+     */
+    static void trampoline();
+
+    FiberScheduler& scheduler;
+    const std::function<void()> entry;
+    const std::shared_ptr<PcoSemaphore> done;
+    ucontext_t context{};
+    void* stack = nullptr;
+    std::size_t mappedSize = 0;
+    Action action = Action::Yield;
+
+    // Protected by the monitor of the scheduler
+    bool parked = false;
+    bool notified = false;
+};
+
+/**
+ * @brief The FiberScheduler class runs fibers over a fixed number of worker threads. The ready fibers are
+ * served in FIFO order by the first idle worker.
+ * It is implemented as a Hoare monitor.
+ */
+class FiberScheduler : protected PcoHoareMonitor
+{
+public:
+    /**
+     * @brief The Handle class allows to wait for the end of a fiber
+     */
+    class Handle
+    {
+    public:
+        explicit Handle(std::shared_ptr<PcoSemaphore> done): done(std::move(done)) {}
+
+        /**
+         * @brief join Waits until the fiber has returned, must not be called from a fiber of the same scheduler
+         */
+        void join() {done->acquire();}
+
+    private:
+        std::shared_ptr<PcoSemaphore> done;
+    };
+
+    /**
+     * @brief FiberScheduler Constructs the scheduler, its workers are launched by start()
+     * @param workers the number of worker threads
+     * @param stackSize the stack size of the fibers
+     */
+    explicit FiberScheduler(unsigned workers = 1, std::size_t stackSize = Fiber::DEFAULT_STACK_SIZE);
+    ~FiberScheduler();
+
+    FiberScheduler(const FiberScheduler&) = delete;
+    FiberScheduler& operator=(const FiberScheduler&) = delete;
+
+    /**
+     * @brief spawn Creates a fiber running entry, it runs once a worker is free (and the scheduler started)
+     * @return a handle to wait for the end of the fiber
+     */
+    Handle spawn(std::function<void()> entry);
+
+    /**
+     * @brief start Launches the worker threads
+     */
+    void start();
+
+    /**
+     * @brief join Waits until all the fibers have returned, then stops and joins the worker threads
+     */
+    void join();
+
+private:
+    friend class Fiber;
+
+    /**
+     * @brief runWorker The loop of a worker thread: runs the ready fibers until the scheduler is joined
+     */
+    void runWorker();
+
+    /**
+     * @brief makeReady Queues a fiber to be run and wakes an idle worker
+     * @note Must be called from inside the monitor
+     */
+    void makeReady(Fiber* fiber);
+
+    /**
+     * @brief resumed Handles a fiber that switched back to its worker
+     */
+    void resumed(Fiber* fiber);
+
+    /**
+     * @brief unpark Makes a parked fiber ready, or remembers the call if the fiber is not parked yet
+     */
+    void unpark(Fiber* fiber);
+
+    const unsigned workerCount;
+    const std::size_t stackSize;
+    std::vector<std::unique_ptr<PcoThread>> workers;
+
+    std::deque<Fiber*> ready;
+    Condition readyAvailable;
+    std::size_t live = 0;
+    bool joining = false;
+};
+
+#endif // FIBER_H
@@ -0,0 +1,834 @@
+//     ____  __________     ___   ____ ___  _____ //
+//    / __ \/ ____/ __ \   |__ \ / __ \__ \|__  / //
+//   / /_/ / /   / / / /   __/ // / / /_/ / /_ <  //
+//  / ____/ /___/ /_/ /   / __// /_/ / __/___/ /  //
+// /_/    \____/\____/   /____/\____/____/____/   //
+// Auteurs : Timothée Van Hove, Aubry Mangold
+
+#include "kernels.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNELS_X86 1
+#define TARGET(isa) __attribute__((target(isa)))
+#endif
+
+// GCC does not insert vzeroupper at the end of functions compiled for a wider target than the rest of the
+// file, the AVX kernels clear the upper halves themselves before returning to SSE code.
+
+namespace {
+
+/**
+ * @brief Below this number of elements the pairwise summation switches to the fast kernel.
+ */
+constexpr std::size_t PAIRWISE_BLOCK = 256;
+
+/**
+ * @brief The number of int32 values summed in an int64 before the sum is checked for overflow, their sum can
+ * not overflow on its own.
+ */
+constexpr std::size_t INT32_BLOCK = std::size_t{1} << 31;
+
+/**
+ * @brief The number of floats converted at once when a summation mode has no float kernel.
+ */
+constexpr std::size_t CONVERSION_BLOCK = 256;
+
+// The exact sum of int64 values, before it is checked for overflow
+__extension__ using Int128 = __int128;
+
+/**
+ * @brief neumaierAdd Adds x to the compensated sum (s, c)
+ */
+inline void neumaierAdd(double& s, double& c, double x) {
+    auto const t = s + x;
+    if (std::fabs(s) >= std::fabs(x)) {
+        c += (s - t) + x;
+    } else {
+        c += (x - t) + s;
+    }
+    s = t;
+}
+
+/**
+ * @brief mergeLanes Merges the per lane compensated sums of a vector kernel into the accumulator
+ */
+inline void mergeLanes(SumAccumulator& acc, const double* sums, const double* compensations, std::size_t lanes) {
+    for (std::size_t i = 0; i < lanes; ++i) {
+        neumaierAdd(acc.sum, acc.compensation, sums[i]);
+        acc.compensation += compensations[i];
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Scalar kernels
+// ---------------------------------------------------------------------------------------------------------------------
+
+double sumFastScalar(const double* v, std::size_t n) {
+    // Four accumulators break the dependency chain of a sequential sum
+    double a0 = 0.0, a1 = 0.0, a2 = 0.0, a3 = 0.0;
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        a0 += v[i];
+        a1 += v[i + 1];
+        a2 += v[i + 2];
+        a3 += v[i + 3];
+    }
+    for (; i < n; ++i) {
+        a0 += v[i];
+    }
+    return (a0 + a1) + (a2 + a3);
+}
+
+void sumCompensatedScalar(SumAccumulator& acc, const double* v, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+        neumaierAdd(acc.sum, acc.compensation, v[i]);
+    }
+}
+
+/**
+ * @brief multiplyFinite Multiplies the accumulator by mantissa * 2^exponent, mantissa being finite and not zero
+ */
+inline void multiplyFinite(ProductAccumulator& acc, double mantissa, std::int64_t exponent) {
+    int e = 0;
+    acc.mantissa *= std::frexp(mantissa, &e);
+    acc.exponent += exponent + e;
+    acc.mantissa = std::frexp(acc.mantissa, &e);
+    acc.exponent += e;
+}
+
+void productElementwise(ProductAccumulator& acc, const double* v, std::size_t n) {
+    for (std::size_t i = 0; i < n && !acc.isFinal(); ++i) {
+        auto const x = v[i];
+        if (std::isnan(x) || x == 0.0 || acc.mantissa == 0.0) {
+            // inf * 0 is the only case where a zero does not give a (signed) zero, in either order
+            acc.mantissa = acc.infinite && x == 0.0 ? std::numeric_limits<double>::quiet_NaN() : acc.mantissa * x;
+        } else if (std::isinf(x)) {
+            acc.infinite = true;
+            acc.mantissa = std::copysign(acc.mantissa, acc.mantissa * x);
+        } else {
+            multiplyFinite(acc, x, 0);
+        }
+    }
+}
+
+/**
+ * @brief Bits of a double apart from the exponent (sign and fraction).
+ */
+constexpr std::uint64_t SIGN_AND_FRACTION = 0x800fffffffffffffULL;
+
+/**
+ * @brief Exponent bits of 1.0, or-ed with the sign and fraction of a value they give its mantissa in [1, 2).
+ */
+constexpr std::uint64_t EXPONENT_OF_ONE = 0x3ff0000000000000ULL;
+
+/**
+ * @brief The blocked product kernels multiply this many values per lane before renormalizing the
+ * partial products. Mantissas are in [1, 2), so the partial products stay below 2^PRODUCT_ITERATIONS.
+ */
+constexpr std::size_t PRODUCT_ITERATIONS = 32;
+
+/* The blocked product kernels split each value into its mantissa in [1, 2) and its biased exponent with bit
+ * operations. Four (vectors of) partial mantissa products are multiplied and the exponents summed in integer
+ * lanes, the partial products being renormalized after each block. Zeros, subnormals, infinities and NaNs
+ * are detected per block: the block is then undone and handled element by element (which also stops on
+ * NaNs). */
+
+/**
+ * @brief splitScalar Splits x into its mantissa in [1, 2) (returned) and its biased exponent (added to e)
+ */
+inline double splitScalar(double x, std::uint64_t& e) {
+    std::uint64_t bits = 0;
+    std::memcpy(&bits, &x, sizeof(bits));
+    e += (bits >> 52) & 0x7ff;
+    bits = (bits & SIGN_AND_FRACTION) | EXPONENT_OF_ONE;
+    std::memcpy(&x, &bits, sizeof(bits));
+    return x;
+}
+
+void productScalar(ProductAccumulator& acc, const double* v, std::size_t n) {
+    constexpr std::size_t BLOCK = 4 * PRODUCT_ITERATIONS;
+
+    double m[4] = {1.0, 1.0, 1.0, 1.0};
+    std::uint64_t e = 0;
+    std::uint64_t biases = 0;
+
+    std::size_t i = 0;
+    for (; i + BLOCK <= n && !acc.isFinal(); i += BLOCK) {
+        double const savedM[4] = {m[0], m[1], m[2], m[3]};
+        auto const savedE = e;
+        bool special = false;
+
+        for (std::size_t j = i; j < i + BLOCK; j += 4) {
+            for (std::size_t k = 0; k < 4; ++k) {
+                auto const exponent = e;
+                m[k] *= splitScalar(v[j + k], e);
+                special |= e == exponent || e - exponent == 0x7ff;
+            }
+        }
+
+        if (special) {
+            std::copy(savedM, savedM + 4, m);
+            e = savedE;
+            productElementwise(acc, v + i, BLOCK);
+            continue;
+        }
+
+        for (auto& partial : m) {
+            partial = splitScalar(partial, e);
+        }
+        biases += (PRODUCT_ITERATIONS + 1) * 4;
+    }
+
+    if (!acc.isFinal()) {
+        multiplyFinite(acc, m[0] * m[1], static_cast<std::int64_t>(e - 1023 * biases));
+        multiplyFinite(acc, m[2] * m[3], 0);
+        productElementwise(acc, v + i, n - i);
+    }
+}
+
+void divideScalar(const double* a, const double* b, double* q, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+        q[i] = a[i] / b[i];
+    }
+}
+
+double sumFloatScalar(const float* v, std::size_t n) {
+    double a0 = 0.0, a1 = 0.0, a2 = 0.0, a3 = 0.0;
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        a0 += static_cast<double>(v[i]);
+        a1 += static_cast<double>(v[i + 1]);
+        a2 += static_cast<double>(v[i + 2]);
+        a3 += static_cast<double>(v[i + 3]);
+    }
+    for (; i < n; ++i) {
+        a0 += static_cast<double>(v[i]);
+    }
+    return (a0 + a1) + (a2 + a3);
+}
+
+// The sum of up to INT32_BLOCK int32 values can not overflow an int64
+std::int64_t sumInt32Scalar(const std::int32_t* v, std::size_t n) {
+    std::int64_t a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        a0 += v[i];
+        a1 += v[i + 1];
+        a2 += v[i + 2];
+        a3 += v[i + 3];
+    }
+    for (; i < n; ++i) {
+        a0 += v[i];
+    }
+    return (a0 + a1) + (a2 + a3);
+}
+
+// Two 128 bit lanes can not overflow on int64 values
+Int128 sumInt64Scalar(const std::int64_t* v, std::size_t n) {
+    Int128 a0 = 0, a1 = 0;
+    std::size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        a0 += v[i];
+        a1 += v[i + 1];
+    }
+    for (; i < n; ++i) {
+        a0 += v[i];
+    }
+    return a0 + a1;
+}
+
+#ifdef KERNELS_X86
+
+// ---------------------------------------------------------------------------------------------------------------------
+// SSE2 kernels
+// ---------------------------------------------------------------------------------------------------------------------
+
+TARGET("sse2") double sumFastSse2(const double* v, std::size_t n) {
+    __m128d a0 = _mm_setzero_pd(), a1 = _mm_setzero_pd(), a2 = _mm_setzero_pd(), a3 = _mm_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        a0 = _mm_add_pd(a0, _mm_loadu_pd(v + i));
+        a1 = _mm_add_pd(a1, _mm_loadu_pd(v + i + 2));
+        a2 = _mm_add_pd(a2, _mm_loadu_pd(v + i + 4));
+        a3 = _mm_add_pd(a3, _mm_loadu_pd(v + i + 6));
+    }
+    alignas(16) double lanes[2];
+    _mm_store_pd(lanes, _mm_add_pd(_mm_add_pd(a0, a1), _mm_add_pd(a2, a3)));
+    return (lanes[0] + lanes[1]) + sumFastScalar(v + i, n - i);
+}
+
+TARGET("sse2") void sumCompensatedSse2(SumAccumulator& acc, const double* v, std::size_t n) {
+    auto const signMask = _mm_set1_pd(-0.0);
+    __m128d s = _mm_setzero_pd(), c = _mm_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        auto const x = _mm_loadu_pd(v + i);
+        auto const t = _mm_add_pd(s, x);
+        // SSE2 has no blend, the larger and smaller magnitudes are selected with masks
+        auto const sIsBigger = _mm_cmpge_pd(_mm_andnot_pd(signMask, s), _mm_andnot_pd(signMask, x));
+        auto const big = _mm_or_pd(_mm_and_pd(sIsBigger, s), _mm_andnot_pd(sIsBigger, x));
+        auto const small = _mm_or_pd(_mm_and_pd(sIsBigger, x), _mm_andnot_pd(sIsBigger, s));
+        c = _mm_add_pd(c, _mm_add_pd(_mm_sub_pd(big, t), small));
+        s = t;
+    }
+    alignas(16) double sums[2], compensations[2];
+    _mm_store_pd(sums, s);
+    _mm_store_pd(compensations, c);
+    mergeLanes(acc, sums, compensations, 2);
+    sumCompensatedScalar(acc, v + i, n - i);
+}
+
+TARGET("sse2") double sumFloatSse2(const float* v, std::size_t n) {
+    __m128d a0 = _mm_setzero_pd(), a1 = _mm_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        auto const x = _mm_loadu_ps(v + i);
+        a0 = _mm_add_pd(a0, _mm_cvtps_pd(x));
+        a1 = _mm_add_pd(a1, _mm_cvtps_pd(_mm_movehl_ps(x, x)));
+    }
+    alignas(16) double lanes[2];
+    _mm_store_pd(lanes, _mm_add_pd(a0, a1));
+    return (lanes[0] + lanes[1]) + sumFloatScalar(v + i, n - i);
+}
+
+TARGET("sse2") void divideSse2(const double* a, const double* b, double* q, std::size_t n) {
+    std::size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        _mm_storeu_pd(q + i, _mm_div_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    }
+    divideScalar(a + i, b + i, q + i, n - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// AVX2 kernels
+// ---------------------------------------------------------------------------------------------------------------------
+
+TARGET("avx2") void divideAvx2(const double* a, const double* b, double* q, std::size_t n) {
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(q + i, _mm256_div_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    }
+    _mm256_zeroupper();
+    divideScalar(a + i, b + i, q + i, n - i);
+}
+
+TARGET("avx2") double sumFastAvx2(const double* v, std::size_t n) {
+    __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd(), a2 = _mm256_setzero_pd(), a3 = _mm256_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        a0 = _mm256_add_pd(a0, _mm256_loadu_pd(v + i));
+        a1 = _mm256_add_pd(a1, _mm256_loadu_pd(v + i + 4));
+        a2 = _mm256_add_pd(a2, _mm256_loadu_pd(v + i + 8));
+        a3 = _mm256_add_pd(a3, _mm256_loadu_pd(v + i + 12));
+    }
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, _mm256_add_pd(_mm256_add_pd(a0, a1), _mm256_add_pd(a2, a3)));
+    _mm256_zeroupper();
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + sumFastScalar(v + i, n - i);
+}
+
+TARGET("avx2") void sumCompensatedAvx2(SumAccumulator& acc, const double* v, std::size_t n) {
+    auto const signMask = _mm256_set1_pd(-0.0);
+    __m256d s = _mm256_setzero_pd(), c = _mm256_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        auto const x = _mm256_loadu_pd(v + i);
+        auto const t = _mm256_add_pd(s, x);
+        auto const sIsBigger = _mm256_cmp_pd(_mm256_andnot_pd(signMask, s), _mm256_andnot_pd(signMask, x), _CMP_GE_OQ);
+        auto const big = _mm256_blendv_pd(x, s, sIsBigger);
+        auto const small = _mm256_blendv_pd(s, x, sIsBigger);
+        c = _mm256_add_pd(c, _mm256_add_pd(_mm256_sub_pd(big, t), small));
+        s = t;
+    }
+    alignas(32) double sums[4], compensations[4];
+    _mm256_store_pd(sums, s);
+    _mm256_store_pd(compensations, c);
+    _mm256_zeroupper();
+    mergeLanes(acc, sums, compensations, 4);
+    sumCompensatedScalar(acc, v + i, n - i);
+}
+
+TARGET("avx2") double sumFloatAvx2(const float* v, std::size_t n) {
+    __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd(), a2 = _mm256_setzero_pd(), a3 = _mm256_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        a0 = _mm256_add_pd(a0, _mm256_cvtps_pd(_mm_loadu_ps(v + i)));
+        a1 = _mm256_add_pd(a1, _mm256_cvtps_pd(_mm_loadu_ps(v + i + 4)));
+        a2 = _mm256_add_pd(a2, _mm256_cvtps_pd(_mm_loadu_ps(v + i + 8)));
+        a3 = _mm256_add_pd(a3, _mm256_cvtps_pd(_mm_loadu_ps(v + i + 12)));
+    }
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, _mm256_add_pd(_mm256_add_pd(a0, a1), _mm256_add_pd(a2, a3)));
+    _mm256_zeroupper();
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + sumFloatScalar(v + i, n - i);
+}
+
+TARGET("avx2") std::int64_t sumInt32Avx2(const std::int32_t* v, std::size_t n) {
+    __m256i a0 = _mm256_setzero_si256(), a1 = _mm256_setzero_si256();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        auto const x0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i));
+        auto const x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i + 4));
+        a0 = _mm256_add_epi64(a0, _mm256_cvtepi32_epi64(x0));
+        a1 = _mm256_add_epi64(a1, _mm256_cvtepi32_epi64(x1));
+    }
+    alignas(32) std::int64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), _mm256_add_epi64(a0, a1));
+    _mm256_zeroupper();
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + sumInt32Scalar(v + i, n - i);
+}
+
+// The lanes add with wrap-around and count how many times they wrapped, a lane is exactly sum + carries * 2^64
+TARGET("avx2") Int128 sumInt64Avx2(const std::int64_t* v, std::size_t n) {
+    auto const zero = _mm256_setzero_si256();
+    auto const one = _mm256_set1_epi64x(1);
+    __m256i sums = zero, carries = zero;
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        auto const x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i));
+        auto const s = _mm256_add_epi64(sums, x);
+        // Signed overflow: the operands have the same sign and the sum the other one, the carry is +1 or -1
+        auto const wrapped = _mm256_cmpgt_epi64(zero, _mm256_and_si256(_mm256_xor_si256(s, sums), _mm256_xor_si256(s, x)));
+        auto const sign = _mm256_or_si256(_mm256_cmpgt_epi64(zero, x), one);
+        carries = _mm256_add_epi64(carries, _mm256_and_si256(wrapped, sign));
+        sums = s;
+    }
+    alignas(32) std::int64_t laneSums[4], laneCarries[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(laneSums), sums);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(laneCarries), carries);
+    _mm256_zeroupper();
+
+    auto sum = sumInt64Scalar(v + i, n - i);
+    for (std::size_t lane = 0; lane < 4; ++lane) {
+        sum += laneSums[lane];
+        sum += static_cast<Int128>(laneCarries[lane]) * (Int128{1} << 64);
+    }
+    return sum;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// AVX-512 kernels
+// ---------------------------------------------------------------------------------------------------------------------
+
+TARGET("avx512f") void divideAvx512(const double* a, const double* b, double* q, std::size_t n) {
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm512_storeu_pd(q + i, _mm512_div_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i)));
+    }
+    _mm256_zeroupper();
+    divideScalar(a + i, b + i, q + i, n - i);
+}
+
+TARGET("avx512f") double sumFastAvx512(const double* v, std::size_t n) {
+    __m512d a0 = _mm512_setzero_pd(), a1 = _mm512_setzero_pd(), a2 = _mm512_setzero_pd(), a3 = _mm512_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        a0 = _mm512_add_pd(a0, _mm512_loadu_pd(v + i));
+        a1 = _mm512_add_pd(a1, _mm512_loadu_pd(v + i + 8));
+        a2 = _mm512_add_pd(a2, _mm512_loadu_pd(v + i + 16));
+        a3 = _mm512_add_pd(a3, _mm512_loadu_pd(v + i + 24));
+    }
+    alignas(64) double lanes[8];
+    _mm512_store_pd(lanes, _mm512_add_pd(_mm512_add_pd(a0, a1), _mm512_add_pd(a2, a3)));
+    _mm256_zeroupper();
+    return sumFastScalar(lanes, 8) + sumFastScalar(v + i, n - i);
+}
+
+// The unmasked conversions trip -Wmaybe-uninitialized in the GCC headers, the zero-masked ones are the same instruction
+constexpr __mmask8 ALL_LANES = 0xff;
+
+TARGET("avx512f") double sumFloatAvx512(const float* v, std::size_t n) {
+    __m512d a0 = _mm512_setzero_pd(), a1 = _mm512_setzero_pd(), a2 = _mm512_setzero_pd(), a3 = _mm512_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        a0 = _mm512_add_pd(a0, _mm512_maskz_cvtps_pd(ALL_LANES, _mm256_loadu_ps(v + i)));
+        a1 = _mm512_add_pd(a1, _mm512_maskz_cvtps_pd(ALL_LANES, _mm256_loadu_ps(v + i + 8)));
+        a2 = _mm512_add_pd(a2, _mm512_maskz_cvtps_pd(ALL_LANES, _mm256_loadu_ps(v + i + 16)));
+        a3 = _mm512_add_pd(a3, _mm512_maskz_cvtps_pd(ALL_LANES, _mm256_loadu_ps(v + i + 24)));
+    }
+    alignas(64) double lanes[8];
+    _mm512_store_pd(lanes, _mm512_add_pd(_mm512_add_pd(a0, a1), _mm512_add_pd(a2, a3)));
+    _mm256_zeroupper();
+    return sumFastScalar(lanes, 8) + sumFloatScalar(v + i, n - i);
+}
+
+TARGET("avx512f") std::int64_t sumInt32Avx512(const std::int32_t* v, std::size_t n) {
+    __m512i a0 = _mm512_setzero_si512(), a1 = _mm512_setzero_si512();
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        auto const x0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i));
+        auto const x1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i + 8));
+        a0 = _mm512_add_epi64(a0, _mm512_maskz_cvtepi32_epi64(ALL_LANES, x0));
+        a1 = _mm512_add_epi64(a1, _mm512_maskz_cvtepi32_epi64(ALL_LANES, x1));
+    }
+    alignas(64) std::int64_t lanes[8];
+    _mm512_store_si512(lanes, _mm512_add_epi64(a0, a1));
+    _mm256_zeroupper();
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]))
+         + sumInt32Scalar(v + i, n - i);
+}
+
+TARGET("avx512f") void sumCompensatedAvx512(SumAccumulator& acc, const double* v, std::size_t n) {
+    __m512d s = _mm512_setzero_pd(), c = _mm512_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        auto const x = _mm512_loadu_pd(v + i);
+        auto const t = _mm512_add_pd(s, x);
+        auto const sIsBigger = _mm512_cmp_pd_mask(_mm512_abs_pd(s), _mm512_abs_pd(x), _CMP_GE_OQ);
+        auto const big = _mm512_mask_blend_pd(sIsBigger, x, s);
+        auto const small = _mm512_mask_blend_pd(sIsBigger, s, x);
+        c = _mm512_add_pd(c, _mm512_add_pd(_mm512_sub_pd(big, t), small));
+        s = t;
+    }
+    alignas(64) double sums[8], compensations[8];
+    _mm512_store_pd(sums, s);
+    _mm512_store_pd(compensations, c);
+    _mm256_zeroupper();
+    mergeLanes(acc, sums, compensations, 8);
+    sumCompensatedScalar(acc, v + i, n - i);
+}
+
+/**
+ * @brief splitAvx2 Splits the values into their mantissas in [1, 2) (returned) and biased exponents (added to e)
+ */
+TARGET("avx2") inline __m256d splitAvx2(__m256i bits, __m256i& e) {
+    e = _mm256_add_epi64(e, _mm256_and_si256(_mm256_srli_epi64(bits, 52), _mm256_set1_epi64x(0x7ff)));
+    return _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi64x(static_cast<long long>(SIGN_AND_FRACTION))),
+                                               _mm256_set1_epi64x(static_cast<long long>(EXPONENT_OF_ONE))));
+}
+
+TARGET("avx2") void productAvx2(ProductAccumulator& acc, const double* v, std::size_t n) {
+    constexpr std::size_t LANES = 4;
+    constexpr std::size_t BLOCK = 4 * LANES * PRODUCT_ITERATIONS;
+
+    auto const exponentMask = _mm256_set1_epi64x(0x7ff);
+    auto const zero = _mm256_setzero_si256();
+
+    __m256d m[4] = {_mm256_set1_pd(1.0), _mm256_set1_pd(1.0), _mm256_set1_pd(1.0), _mm256_set1_pd(1.0)};
+    __m256i e = zero;
+    std::int64_t biases = 0;
+
+    std::size_t i = 0;
+    for (; i + BLOCK <= n && !acc.isFinal(); i += BLOCK) {
+        __m256d const savedM[4] = {m[0], m[1], m[2], m[3]};
+        auto const savedE = e;
+        auto special = zero;
+
+        for (std::size_t j = i; j < i + BLOCK; j += 4 * LANES) {
+            for (std::size_t k = 0; k < 4; ++k) {
+                auto const bits = _mm256_castpd_si256(_mm256_loadu_pd(v + j + k * LANES));
+                auto const exponent = _mm256_and_si256(_mm256_srli_epi64(bits, 52), exponentMask);
+                special = _mm256_or_si256(special, _mm256_or_si256(_mm256_cmpeq_epi64(exponent, zero),
+                                                                   _mm256_cmpeq_epi64(exponent, exponentMask)));
+                m[k] = _mm256_mul_pd(m[k], splitAvx2(bits, e));
+            }
+        }
+
+        if (!_mm256_testz_si256(special, special)) {
+            std::copy(savedM, savedM + 4, m);
+            e = savedE;
+            _mm256_zeroupper();
+            productElementwise(acc, v + i, BLOCK);
+            continue;
+        }
+
+        for (auto& partial : m) {
+            partial = splitAvx2(_mm256_castpd_si256(partial), e);
+        }
+        biases += static_cast<std::int64_t>(PRODUCT_ITERATIONS + 1) * 4;
+    }
+
+    alignas(32) double mantissas[4][LANES];
+    alignas(32) std::int64_t exponents[LANES];
+    for (std::size_t k = 0; k < 4; ++k) {
+        _mm256_store_pd(mantissas[k], m[k]);
+    }
+    _mm256_store_si256(reinterpret_cast<__m256i*>(exponents), e);
+    _mm256_zeroupper();
+
+    if (!acc.isFinal()) {
+        for (std::size_t lane = 0; lane < LANES; ++lane) {
+            multiplyFinite(acc, mantissas[0][lane] * mantissas[1][lane], exponents[lane] - 1023 * biases);
+            multiplyFinite(acc, mantissas[2][lane] * mantissas[3][lane], 0);
+        }
+        productScalar(acc, v + i, n - i);
+    }
+}
+
+/**
+ * @brief shiftExponentAvx512 Shifts the exponents of the values to the low bits
+ * @note The zero-masked shift avoids a spurious -Wmaybe-uninitialized coming from _mm512_srli_epi64 in GCC 12.
+ */
+TARGET("avx512f") inline __m512i shiftExponentAvx512(__m512i bits) {
+    return _mm512_maskz_srli_epi64(0xff, bits, 52);
+}
+
+/**
+ * @brief splitAvx512 Splits the values into their mantissas in [1, 2) (returned) and biased exponents (added to e)
+ */
+TARGET("avx512f") inline __m512d splitAvx512(__m512i bits, __m512i& e) {
+    e = _mm512_add_epi64(e, _mm512_and_si512(shiftExponentAvx512(bits), _mm512_set1_epi64(0x7ff)));
+    return _mm512_castsi512_pd(_mm512_or_si512(_mm512_and_si512(bits, _mm512_set1_epi64(static_cast<long long>(SIGN_AND_FRACTION))),
+                                               _mm512_set1_epi64(static_cast<long long>(EXPONENT_OF_ONE))));
+}
+
+TARGET("avx512f") void productAvx512(ProductAccumulator& acc, const double* v, std::size_t n) {
+    constexpr std::size_t LANES = 8;
+    constexpr std::size_t BLOCK = 4 * LANES * PRODUCT_ITERATIONS;
+
+    auto const exponentMask = _mm512_set1_epi64(0x7ff);
+    auto const zero = _mm512_setzero_si512();
+
+    __m512d m[4] = {_mm512_set1_pd(1.0), _mm512_set1_pd(1.0), _mm512_set1_pd(1.0), _mm512_set1_pd(1.0)};
+    __m512i e = zero;
+    std::int64_t biases = 0;
+
+    std::size_t i = 0;
+    for (; i + BLOCK <= n && !acc.isFinal(); i += BLOCK) {
+        __m512d const savedM[4] = {m[0], m[1], m[2], m[3]};
+        auto const savedE = e;
+        __mmask8 special = 0;
+
+        for (std::size_t j = i; j < i + BLOCK; j += 4 * LANES) {
+            for (std::size_t k = 0; k < 4; ++k) {
+                auto const bits = _mm512_castpd_si512(_mm512_loadu_pd(v + j + k * LANES));
+                auto const exponent = _mm512_and_si512(shiftExponentAvx512(bits), exponentMask);
+                special = static_cast<__mmask8>(special | _mm512_cmpeq_epi64_mask(exponent, zero) |
+                                                _mm512_cmpeq_epi64_mask(exponent, exponentMask));
+                m[k] = _mm512_mul_pd(m[k], splitAvx512(bits, e));
+            }
+        }
+
+        if (special != 0) {
+            std::copy(savedM, savedM + 4, m);
+            e = savedE;
+            _mm256_zeroupper();
+            productElementwise(acc, v + i, BLOCK);
+            continue;
+        }
+
+        for (auto& partial : m) {
+            partial = splitAvx512(_mm512_castpd_si512(partial), e);
+        }
+        biases += static_cast<std::int64_t>(PRODUCT_ITERATIONS + 1) * 4;
+    }
+
+    alignas(64) double mantissas[4][LANES];
+    alignas(64) std::int64_t exponents[LANES];
+    for (std::size_t k = 0; k < 4; ++k) {
+        _mm512_store_pd(mantissas[k], m[k]);
+    }
+    _mm512_store_si512(exponents, e);
+    _mm256_zeroupper();
+
+    if (!acc.isFinal()) {
+        for (std::size_t lane = 0; lane < LANES; ++lane) {
+            multiplyFinite(acc, mantissas[0][lane] * mantissas[1][lane], exponents[lane] - 1023 * biases);
+            multiplyFinite(acc, mantissas[2][lane] * mantissas[3][lane], 0);
+        }
+        productScalar(acc, v + i, n - i);
+    }
+}
+
+#endif // KERNELS_X86
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Dispatch
+// ---------------------------------------------------------------------------------------------------------------------
+
+double sumFast(const double* v, std::size_t n, SimdLevel level) {
+    switch (level) {
+#ifdef KERNELS_X86
+    case SimdLevel::AVX512: return sumFastAvx512(v, n);
+    case SimdLevel::AVX2:   return sumFastAvx2(v, n);
+    case SimdLevel::SSE2:   return sumFastSse2(v, n);
+#endif
+    default:                return sumFastScalar(v, n);
+    }
+}
+
+void sumCompensated(SumAccumulator& acc, const double* v, std::size_t n, SimdLevel level) {
+    switch (level) {
+#ifdef KERNELS_X86
+    case SimdLevel::AVX512: sumCompensatedAvx512(acc, v, n); break;
+    case SimdLevel::AVX2:   sumCompensatedAvx2(acc, v, n); break;
+    case SimdLevel::SSE2:   sumCompensatedSse2(acc, v, n); break;
+#endif
+    default:                sumCompensatedScalar(acc, v, n); break;
+    }
+}
+
+double sumFloat(const float* v, std::size_t n, SimdLevel level) {
+    switch (level) {
+#ifdef KERNELS_X86
+    case SimdLevel::AVX512: return sumFloatAvx512(v, n);
+    case SimdLevel::AVX2:   return sumFloatAvx2(v, n);
+    case SimdLevel::SSE2:   return sumFloatSse2(v, n);
+#endif
+    default:                return sumFloatScalar(v, n);
+    }
+}
+
+std::int64_t sumInt32(const std::int32_t* v, std::size_t n, SimdLevel level) {
+    switch (level) {
+#ifdef KERNELS_X86
+    case SimdLevel::AVX512: return sumInt32Avx512(v, n);
+    case SimdLevel::AVX2:   return sumInt32Avx2(v, n);
+#endif
+    default:                return sumInt32Scalar(v, n);
+    }
+}
+
+/**
+ * @brief addInteger Adds x to the integer sum of the accumulator, remembers an overflow
+ */
+inline void addInteger(SumAccumulator& acc, std::int64_t x) {
+    acc.integerOverflow |= __builtin_add_overflow(acc.integer, x, &acc.integer);
+    acc.integerApprox += static_cast<double>(x);
+}
+
+double sumPairwise(const double* v, std::size_t n, SimdLevel level) {
+    if (n <= PAIRWISE_BLOCK) {
+        return sumFast(v, n, level);
+    }
+    auto const half = n / 2;
+    return sumPairwise(v, half, level) + sumPairwise(v + half, n - half, level);
+}
+
+} // namespace
+
+SimdLevel detectedSimdLevel() {
+    static const SimdLevel level = [] {
+#ifdef KERNELS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) {
+            return SimdLevel::AVX512;
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            return SimdLevel::AVX2;
+        }
+        if (__builtin_cpu_supports("sse2")) {
+            return SimdLevel::SSE2;
+        }
+#endif
+        return SimdLevel::Scalar;
+    }();
+    return level;
+}
+
+const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::AVX512: return "AVX-512";
+    case SimdLevel::AVX2:   return "AVX2";
+    case SimdLevel::SSE2:   return "SSE2";
+    default:                return "scalar";
+    }
+}
+
+void accumulateSum(SumAccumulator& acc, const double* values, std::size_t n, SummationMode mode, SimdLevel level) {
+    level = std::min(level, detectedSimdLevel());
+
+    switch (mode) {
+    case SummationMode::Fast:
+        acc.sum += sumFast(values, n, level);
+        break;
+    case SummationMode::Compensated:
+        sumCompensated(acc, values, n, level);
+        break;
+    case SummationMode::Pairwise:
+        // The pairwise sum of the chunk is exact enough, it is merged with compensation across chunks
+        neumaierAdd(acc.sum, acc.compensation, sumPairwise(values, n, level));
+        break;
+    }
+}
+
+void accumulateSum(SumAccumulator& acc, const float* values, std::size_t n, SummationMode mode, SimdLevel level) {
+    level = std::min(level, detectedSimdLevel());
+
+    if (mode == SummationMode::Fast) {
+        acc.sum += sumFloat(values, n, level);
+        return;
+    }
+
+    // The other modes go through the double kernels, a block at a time
+    double block[CONVERSION_BLOCK];
+    for (std::size_t i = 0; i < n; i += CONVERSION_BLOCK) {
+        auto const count = std::min(CONVERSION_BLOCK, n - i);
+        std::copy(values + i, values + i + count, block);
+        accumulateSum(acc, block, count, mode, level);
+    }
+}
+
+void accumulateSum(SumAccumulator& acc, const std::int32_t* values, std::size_t n, SimdLevel level) {
+    level = std::min(level, detectedSimdLevel());
+    for (std::size_t i = 0; i < n; i += INT32_BLOCK) {
+        addInteger(acc, sumInt32(values + i, std::min(INT32_BLOCK, n - i), level));
+    }
+}
+
+void accumulateSum(SumAccumulator& acc, const std::int64_t* values, std::size_t n, SimdLevel level) {
+    Int128 added = 0;
+    switch (std::min(level, detectedSimdLevel())) {
+#ifdef KERNELS_X86
+    case SimdLevel::AVX512:
+    case SimdLevel::AVX2:   added = sumInt64Avx2(values, n); break;
+#endif
+    default:                added = sumInt64Scalar(values, n); break;
+    }
+    Int128 const sum = acc.integer + added;
+    acc.integerApprox += static_cast<double>(added);
+    acc.integerOverflow |= sum > std::numeric_limits<std::int64_t>::max() || sum < std::numeric_limits<std::int64_t>::min();
+    acc.integer = static_cast<std::int64_t>(sum);
+}
+
+bool ProductAccumulator::isFinal() const {
+    return std::isnan(mantissa);
+}
+
+double ProductAccumulator::value() const {
+    if (isFinal() || mantissa == 0.0) {
+        return mantissa;
+    }
+    if (infinite) {
+        return std::copysign(std::numeric_limits<double>::infinity(), mantissa);
+    }
+    // Anything outside of this range is infinity or zero anyway, the clamp keeps the exponent in an int
+    constexpr std::int64_t LIMIT = 4 * DBL_MAX_EXP;
+    return std::ldexp(mantissa, static_cast<int>(std::clamp(exponent, -LIMIT, LIMIT)));
+}
+
+bool ProductAccumulator::overflows() const {
+    return !isFinal() && !infinite && std::isinf(value());
+}
+
+bool ProductAccumulator::underflows() const {
+    return !isFinal() && !infinite && mantissa != 0.0 && value() == 0.0;
+}
+
+void accumulateProduct(ProductAccumulator& acc, const double* values, std::size_t n, SimdLevel level) {
+    switch (std::min(level, detectedSimdLevel())) {
+#ifdef KERNELS_X86
+    case SimdLevel::AVX512: productAvx512(acc, values, n); break;
+    case SimdLevel::AVX2:   productAvx2(acc, values, n); break;
+#endif
+    default:                productScalar(acc, values, n); break;
+    }
+}
+
+void divide(const double* numerators, const double* denominators, double* quotients, std::size_t n, SimdLevel level) {
+    switch (std::min(level, detectedSimdLevel())) {
+#ifdef KERNELS_X86
+    case SimdLevel::AVX512: divideAvx512(numerators, denominators, quotients, n); break;
+    case SimdLevel::AVX2:   divideAvx2(numerators, denominators, quotients, n); break;
+    case SimdLevel::SSE2:   divideSse2(numerators, denominators, quotients, n); break;
+#endif
+    default:                divideScalar(numerators, denominators, quotients, n); break;
+    }
+}
@@ -0,0 +1,149 @@
+//     ____  __________     ___   ____ ___  _____ //
+//    / __ \/ ____/ __ \   |__ \ / __ \__ \|__  / //
+//   / /_/ / /   / / / /   __/ // / / /_/ / /_ <  //
+//  / ____/ /___/ /_/ /   / __// /_/ / __/___/ /  //
+// /_/    \____/\____/   /____/\____/____/____/   //
+// Auteurs : Timothée Van Hove, Aubry Mangold
+
+// Vectorized kernels used by the compute engines. Every kernel has a scalar version and versions for
+// the SIMD instruction sets, the best one supported by the processor is chosen at runtime.
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+/**
+ * @brief The SimdLevel enum lists the instruction sets the kernels are written for, in increasing order
+ */
+enum class SimdLevel {Scalar, SSE2, AVX2, AVX512};
+
+/**
+ * @brief detectedSimdLevel Returns the best instruction set supported by the processor
+ * @return the detected level, computed once
+ */
+SimdLevel detectedSimdLevel();
+
+/**
+ * @brief simdLevelName Returns a printable name for a SIMD level
+ */
+const char* simdLevelName(SimdLevel level);
+
+/**
+ * @brief The SummationMode enum selects the accuracy of the sum kernel.
+ * Fast uses several independent accumulators (the order of the additions differs from a sequential sum),
+ * Compensated uses Neumaier compensated summation and Pairwise sums blocks in a binary tree.
+ */
+enum class SummationMode {Fast, Compensated, Pairwise};
+
+/**
+ * @brief The SumAccumulator struct holds a running sum across several calls to accumulateSum()
+ */
+struct SumAccumulator
+{
+    double sum = 0.0;
+    double compensation = 0.0;
+    std::int64_t integer = 0;      ///< The exact sum of the integer values
+    bool integerOverflow = false;  ///< True if the sum of the integer values went out of the range of an int64
+    double integerApprox = 0.0;    ///< The sum of the integer values as a double, gives the sign of an overflow
+
+    /**
+     * @brief value Returns the accumulated sum, +/-infinity once the sum of the integer values overflowed
+     */
+    [[nodiscard]] double value() const {
+        if (integerOverflow) {
+            return std::copysign(std::numeric_limits<double>::infinity(), sum + compensation + integerApprox);
+        }
+        return sum + compensation + static_cast<double>(integer);
+    }
+};
+
+/**
+ * @brief accumulateSum Adds n values to the accumulator
+ * @param acc the accumulator
+ * @param values pointer to the first value
+ * @param n the number of values
+ * @param mode the accuracy of the summation
+ * @param level the instruction set to use, capped to the detected one
+ */
+void accumulateSum(SumAccumulator& acc, const double* values, std::size_t n, SummationMode mode = SummationMode::Fast,
+                   SimdLevel level = detectedSimdLevel());
+
+/**
+ * @brief accumulateSum Adds n floats to the accumulator, they are summed as doubles
+ * @note Only the Fast mode has float kernels, the other modes convert the floats a block at a time
+ */
+void accumulateSum(SumAccumulator& acc, const float* values, std::size_t n, SummationMode mode = SummationMode::Fast,
+                   SimdLevel level = detectedSimdLevel());
+
+/**
+ * @brief accumulateSum Adds n int32 values to the exact integer sum of the accumulator
+ * @param level the instruction set to use, capped to the detected one (SSE2 uses the scalar kernel)
+ */
+void accumulateSum(SumAccumulator& acc, const std::int32_t* values, std::size_t n, SimdLevel level = detectedSimdLevel());
+
+/**
+ * @brief accumulateSum Adds n int64 values to the exact integer sum of the accumulator
+ * @param level the instruction set to use, capped to the detected one (SSE2 uses the scalar kernel, AVX-512
+ * the AVX2 one)
+ */
+void accumulateSum(SumAccumulator& acc, const std::int64_t* values, std::size_t n, SimdLevel level = detectedSimdLevel());
+
+/**
+ * @brief The ProductAccumulator struct holds a running product as mantissa * 2^exponent so that long
+ * products neither overflow to infinity nor underflow to zero before the end of the computation.
+ * The mantissa is kept in [0.5, 1) (as returned by frexp), it is zero once a zero was seen and NaN once the product is known.
+ */
+struct ProductAccumulator
+{
+    double mantissa = 0.5;
+    std::int64_t exponent = 1;
+    bool infinite = false;
+
+    /**
+     * @brief isFinal Returns true once the product can not change anymore (a NaN was seen)
+     */
+    [[nodiscard]] bool isFinal() const;
+
+    /**
+     * @brief value Returns the product rounded to a double (infinity or zero if it is out of range)
+     */
+    [[nodiscard]] double value() const;
+
+    /**
+     * @brief overflows Returns true if the true product is finite but too large for a double
+     */
+    [[nodiscard]] bool overflows() const;
+
+    /**
+     * @brief underflows Returns true if the true product is not zero but too small for a double
+     */
+    [[nodiscard]] bool underflows() const;
+};
+
+/**
+ * @brief accumulateProduct Multiplies the accumulator by n values, stops early on a NaN.
+ * @note A zero and an infinity give NaN whatever their order, the values after a zero are thus still scanned.
+ * @param acc the accumulator
+ * @param values pointer to the first value
+ * @param n the number of values
+ * @param level the instruction set to use, capped to the detected one (SSE2 uses the scalar kernel)
+ */
+void accumulateProduct(ProductAccumulator& acc, const double* values, std::size_t n,
+                       SimdLevel level = detectedSimdLevel());
+
+/**
+ * @brief divide Computes quotients[i] = numerators[i] / denominators[i] for n elements
+ * @param numerators pointer to the first numerator
+ * @param denominators pointer to the first denominator
+ * @param quotients pointer to the first quotient, may not overlap the operands
+ * @param n the number of divisions
+ * @param level the instruction set to use, capped to the detected one
+ */
+void divide(const double* numerators, const double* denominators, double* quotients, std::size_t n,
+            SimdLevel level = detectedSimdLevel());
+
+#endif // KERNELS_H
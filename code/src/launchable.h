@@ -9,10 +9,15 @@
 #ifndef LAUNCHABLE_H
 #define LAUNCHABLE_H
 
+#include <atomic>
+
 #include <QDebug>
 
 #include <pcosynchro/pcothread.h>
 
+#include "fiber.h"
+#include "placement.h"
+
 /*!
  * \brief La classe Launchable est une classe abstraite qui représente le fait d'avoir un thread
  * associé qui permet d'être lancé, thread qui exécute la fonction run() qui représente le
@@ -23,27 +28,65 @@ class Launchable
 public:
     Launchable() {}
 
+    // Déplaçable comme avant l'ajout de l'indicateur de fin (atomique donc non déplaçable par défaut)
+    Launchable(Launchable&& other) noexcept
+        : thread(std::move(other.thread)), fiber(std::move(other.fiber)), cpus(std::move(other.cpus)), finished(other.finished.load()) {}
+    Launchable& operator=(Launchable&& other) noexcept {
+        thread = std::move(other.thread);
+        fiber = std::move(other.fiber);
+        cpus = std::move(other.cpus);
+        finished = other.finished.load();
+        return *this;
+    }
+
+    /*!
+     * \brief Restreint le thread aux processeurs donnés, appliqué au lancement du thread (vide : aucune restriction)
+     */
+    void setPlacement(CpuSet cpus) {this->cpus = std::move(cpus);}
+
     /*!
      * \brief Lance un thread avec la fonction run()
      */
     void startThread() {
-        if (thread == nullptr) {
+        if (thread == nullptr && fiber == nullptr) {
+            printStartMessage();
+            finished = false;
+            thread = std::make_unique<PcoThread>(&Launchable::runThread, this, false);
+        }
+    }
+
+    /*!
+     * \brief Lance la fonction run() dans une fibre de l'ordonnanceur donné plutôt que dans un thread
+     * (le placement ne s'applique alors pas, les fibres passent d'un thread de l'ordonnanceur à l'autre)
+     */
+    void startFiber(FiberScheduler& scheduler) {
+        if (thread == nullptr && fiber == nullptr) {
             printStartMessage();
-            thread = std::make_unique<PcoThread>(&Launchable::run, this);
+            finished = false;
+            fiber = std::make_unique<FiberScheduler::Handle>(scheduler.spawn([this] {runThread(true);}));
         }
     }
 
     /*!
-     * \brief Attend la fin du thread lancé
+     * \brief Attend la fin du thread (ou de la fibre) lancé
      */
     void join() {
         if (thread != nullptr) {
             thread->join();
             thread = nullptr;
             printCompletionMessage();
+        } else if (fiber != nullptr) {
+            fiber->join();
+            fiber = nullptr;
+            printCompletionMessage();
         }
     };
 
+    /*!
+     * \brief Indique si la fonction run() du thread lancé a terminé (le thread peut alors être joint sans attendre)
+     */
+    bool isFinished() const {return finished;}
+
 protected:
 
     /*!
@@ -67,6 +110,26 @@ protected:
      */
     std::unique_ptr<PcoThread> thread = nullptr;
 
+    /*!
+     * \brief La fibre associée, si lancé dans une fibre
+     */
+    std::unique_ptr<FiberScheduler::Handle> fiber = nullptr;
+
+private:
+    /*!
+     * \brief Exécute run() puis note que le thread a terminé
+     * \param onFiber vrai si exécuté dans une fibre, qui n'est alors pas placée
+     */
+    void runThread(bool onFiber) {
+        if (!cpus.empty() && !onFiber) {
+            pinCurrentThread(cpus);
+        }
+        run();
+        finished = true;
+    }
+
+    CpuSet cpus;
+    std::atomic<bool> finished = false;
 
 };
 
@@ -0,0 +1,96 @@
+//     ____  __________     ___   ____ ___  _____ //
+//    / __ \/ ____/ __ \   |__ \ / __ \__ \|__  / //
+//   / /_/ / /   / / / /   __/ // / / /_/ / /_ <  //
+//  / ____/ /___/ /_/ /   / __// /_/ / __/___/ /  //
+// /_/    \____/\____/   /____/\____/____/____/   //
+// Auteurs : Timothée Van Hove, Aubry Mangold
+
+#include "mappedpayload.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+std::size_t pageSize() {
+    static auto const size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+} // namespace
+
+std::shared_ptr<const MappedPayload> MappedPayload::open(const std::string& path, std::size_t offset, std::size_t count) {
+    if (offset % sizeof(double) != 0) {
+        throw std::invalid_argument("The offset of a mapped payload must be a multiple of the size of a double");
+    }
+
+    auto const fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "Could not open " + path);
+    }
+
+    struct stat status{};
+    if (fstat(fd, &status) != 0) {
+        auto const error = errno;
+        close(fd);
+        throw std::system_error(error, std::generic_category(), "Could not stat " + path);
+    }
+
+    auto const fileSize = static_cast<std::size_t>(status.st_size);
+    auto const available = offset <= fileSize ? (fileSize - offset) / sizeof(double) : 0;
+    if (offset > fileSize || (count != WHOLE_FILE && count > available)) {
+        close(fd);
+        throw std::invalid_argument("The mapped payload goes beyond the end of " + path);
+    }
+    count = std::min(count, available);
+
+    // An empty region is not mapped, mmap refuses empty mappings
+    if (count == 0) {
+        close(fd);
+        return std::shared_ptr<const MappedPayload>(new MappedPayload(nullptr, 0, nullptr, 0));
+    }
+
+    // The mapping starts at the page holding the first double
+    auto const start = offset / pageSize() * pageSize();
+    auto const mappedBytes = offset - start + count * sizeof(double);
+    auto const mapping = mmap(nullptr, mappedBytes, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(start));
+    auto const error = errno;
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::system_error(error, std::generic_category(), "Could not map " + path);
+    }
+
+    // The engines read the payload front to back, the kernel may read ahead aggressively and drop the pages
+    // that were read. The first pages are requested right away so that the computation starts on loaded data.
+    madvise(mapping, mappedBytes, MADV_SEQUENTIAL);
+    auto const first = reinterpret_cast<const double*>(static_cast<const char*>(mapping) + (offset - start));
+    auto payload = std::shared_ptr<const MappedPayload>(new MappedPayload(mapping, mappedBytes, first, count));
+    payload->willNeed(0);
+    return payload;
+}
+
+MappedPayload::~MappedPayload() {
+    if (mapping != nullptr) {
+        munmap(mapping, mappedBytes);
+    }
+}
+
+void MappedPayload::willNeed(std::size_t position) const {
+    if (position >= count) {
+        return;
+    }
+
+    // madvise needs a page aligned address
+    auto const address = reinterpret_cast<std::uintptr_t>(first + position) / pageSize() * pageSize();
+    auto const end = std::min(reinterpret_cast<std::uintptr_t>(first + count),
+                              reinterpret_cast<std::uintptr_t>(first + position) + READAHEAD);
+    madvise(reinterpret_cast<void*>(address), end - address, MADV_WILLNEED);
+}
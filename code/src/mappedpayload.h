@@ -0,0 +1,69 @@
+//     ____  __________     ___   ____ ___  _____ //
+//    / __ \/ ____/ __ \   |__ \ / __ \__ \|__  / //
+//   / /_/ / /   / / / /   __/ // / / /_/ / /_ <  //
+//  / ____/ /___/ /_/ /   / __// /_/ / __/___/ /  //
+// /_/    \____/\____/   /____/\____/____/____/   //
+// Auteurs : Timothée Van Hove, Aubry Mangold
+
+#ifndef MAPPEDPAYLOAD_H
+#define MAPPEDPAYLOAD_H
+
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <string>
+
+/**
+ * @brief The MappedPayload class is a read-only view of doubles stored in a file, mapped in memory instead of
+ * being read: the pages are loaded from the page cache when the engines first read them, and the kernel is
+ * told that they are read sequentially so that it reads ahead.
+ * The file is unmapped once the last computation holding the view is done.
+ */
+class MappedPayload
+{
+public:
+    /**
+     * @brief WHOLE_FILE The count that maps the doubles up to the end of the file
+     */
+    static constexpr std::size_t WHOLE_FILE = std::numeric_limits<std::size_t>::max();
+
+    /**
+     * @brief READAHEAD The number of bytes that willNeed() asks the kernel to load ahead
+     */
+    static constexpr std::size_t READAHEAD = std::size_t{4} << 20;
+
+    /**
+     * @brief open Maps count doubles of a file, in the native byte order, starting at a byte offset
+     * @param path the path of the file
+     * @param offset the offset of the first double in bytes, a multiple of the size of a double
+     * @param count the number of doubles, WHOLE_FILE for all the doubles up to the end of the file
+     * @return the view, throws std::system_error if the file can not be mapped and std::invalid_argument if
+     * the region is misaligned or beyond the end of the file
+     */
+    static std::shared_ptr<const MappedPayload> open(const std::string& path, std::size_t offset = 0,
+                                                     std::size_t count = WHOLE_FILE);
+
+    ~MappedPayload();
+
+    MappedPayload(const MappedPayload&) = delete;
+    MappedPayload& operator=(const MappedPayload&) = delete;
+
+    [[nodiscard]] const double* values() const {return first;}
+    [[nodiscard]] std::size_t size() const {return count;}
+
+    /**
+     * @brief willNeed Asks the kernel to start loading the elements [position, position + READAHEAD bytes)
+     */
+    void willNeed(std::size_t position) const;
+
+private:
+    MappedPayload(void* mapping, std::size_t mappedBytes, const double* first, std::size_t count)
+        : mapping(mapping), mappedBytes(mappedBytes), first(first), count(count) {}
+
+    void* const mapping;
+    const std::size_t mappedBytes;
+    const double* const first;
+    const std::size_t count;
+};
+
+#endif // MAPPEDPAYLOAD_H
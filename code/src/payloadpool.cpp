@@ -0,0 +1,233 @@
+//     ____  __________     ___   ____ ___  _____ //
+//    / __ \/ ____/ __ \   |__ \ / __ \__ \|__  / //
+//   / /_/ / /   / / / /   __/ // / / /_/ / /_ <  //
+//  / ____/ /___/ /_/ /   / __// /_/ / __/___/ /  //
+// /_/    \____/\____/   /____/\____/____/____/   //
+// Auteurs : Timothée Van Hove, Aubry Mangold
+
+#include "payloadpool.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <mutex>
+
+namespace {
+
+// The caches hold the payloads of each class, then the control blocks in the last slot
+constexpr std::size_t BLOCK_SLOT = PayloadPool::CLASS_COUNT;
+constexpr std::size_t SLOT_COUNT = PayloadPool::CLASS_COUNT + 1;
+constexpr std::size_t LOCAL_BLOCK_CACHE_SIZE = 64;
+constexpr std::size_t DEPOT_BLOCKS = 4096;
+
+using Slots = std::array<std::vector<void*>, SLOT_COUNT>;
+
+std::atomic<std::uint64_t> payloadAllocations = 0;
+std::atomic<std::uint64_t> blockAllocations = 0;
+
+constexpr std::size_t classCapacity(std::size_t k) {
+    return PayloadPool::MIN_CAPACITY << k;
+}
+
+/**
+ * @brief classFor Returns the smallest class holding size elements, CLASS_COUNT if there is none
+ */
+std::size_t classFor(std::size_t size) {
+    std::size_t k = 0;
+    while (k < PayloadPool::CLASS_COUNT && classCapacity(k) < size) {
+        ++k;
+    }
+    return k;
+}
+
+/**
+ * @brief classOf Returns the largest class whose capacity fits in capacity, CLASS_COUNT if there is none
+ */
+std::size_t classOf(std::size_t capacity) {
+    if (capacity < PayloadPool::MIN_CAPACITY || capacity >= classCapacity(PayloadPool::CLASS_COUNT)) {
+        return PayloadPool::CLASS_COUNT;
+    }
+    std::size_t k = 0;
+    while (classCapacity(k + 1) <= capacity) {
+        ++k;
+    }
+    return k;
+}
+
+std::size_t localLimit(std::size_t slot) {
+    return slot == BLOCK_SLOT ? LOCAL_BLOCK_CACHE_SIZE : PayloadPool::LOCAL_CACHE_SIZE;
+}
+
+std::size_t depotLimit(std::size_t slot) {
+    if (slot == BLOCK_SLOT) {
+        return DEPOT_BLOCKS;
+    }
+    return std::max<std::size_t>(4, PayloadPool::DEPOT_BYTES / (classCapacity(slot) * sizeof(double)));
+}
+
+void destroy(std::size_t slot, void* item) {
+    if (slot == BLOCK_SLOT) {
+        ::operator delete(item);
+    } else {
+        delete static_cast<std::vector<double>*>(item);
+    }
+}
+
+/**
+ * @brief The Depot struct holds the items that the threads put aside when their cache is full
+ * @note Never destroyed, payloads may be released until the very end of the program
+ */
+struct Depot
+{
+    std::mutex mutex;
+    Slots slots;
+
+    /**
+     * @brief put Moves the last count items of a cache to the depot, the ones beyond its limit are destroyed
+     */
+    void put(std::size_t slot, std::vector<void*>& cache, std::size_t count) {
+        auto const first = cache.end() - static_cast<std::ptrdiff_t>(std::min(count, cache.size()));
+        auto extra = first;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto& items = slots[slot];
+            auto const room = depotLimit(slot) - std::min(depotLimit(slot), items.size());
+            extra = first + static_cast<std::ptrdiff_t>(std::min(room, static_cast<std::size_t>(cache.end() - first)));
+            items.insert(items.end(), first, extra);
+        }
+        std::for_each(extra, cache.end(), [slot](void* item) { destroy(slot, item); });
+        cache.erase(first, cache.end());
+    }
+
+    /**
+     * @brief take Moves up to count items from the depot to a cache
+     */
+    void take(std::size_t slot, std::vector<void*>& cache, std::size_t count) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto& items = slots[slot];
+        auto const first = items.end() - static_cast<std::ptrdiff_t>(std::min(count, items.size()));
+        cache.insert(cache.end(), first, items.end());
+        items.erase(first, items.end());
+    }
+};
+
+Depot& depot() {
+    static auto const instance = new Depot;
+    return *instance;
+}
+
+// 0: the cache of the thread was not used yet, 1: it is alive, 2: it was destroyed (the thread is exiting)
+thread_local int cacheState = 0;
+
+/**
+ * @brief The LocalCache struct holds the items released by a thread, it gives them back to the depot when
+ * the thread exits
+ */
+struct LocalCache
+{
+    Slots slots;
+
+    LocalCache() {
+        for (std::size_t slot = 0; slot < SLOT_COUNT; ++slot) {
+            slots[slot].reserve(localLimit(slot));
+        }
+        cacheState = 1;
+    }
+
+    ~LocalCache() {
+        for (std::size_t slot = 0; slot < SLOT_COUNT; ++slot) {
+            depot().put(slot, slots[slot], slots[slot].size());
+        }
+        cacheState = 2;
+    }
+};
+
+LocalCache& localCache() {
+    thread_local LocalCache cache;
+    return cache;
+}
+
+void* take(std::size_t slot) {
+    if (cacheState == 2) {
+        std::vector<void*> item;
+        item.reserve(1);
+        depot().take(slot, item, 1);
+        return item.empty() ? nullptr : item.back();
+    }
+
+    auto& cache = localCache().slots[slot];
+    if (cache.empty()) {
+        depot().take(slot, cache, localLimit(slot) / 2);
+    }
+    if (cache.empty()) {
+        return nullptr;
+    }
+    auto const item = cache.back();
+    cache.pop_back();
+    return item;
+}
+
+void give(std::size_t slot, void* item) {
+    if (cacheState == 2) {
+        std::vector<void*> single{item};
+        depot().put(slot, single, 1);
+        return;
+    }
+
+    // A full cache hands its older half to the depot, a thread that only releases (such as an engine
+    // dropping the payloads of the client) thus feeds the threads that only acquire.
+    auto& cache = localCache().slots[slot];
+    if (cache.size() >= localLimit(slot)) {
+        std::rotate(cache.begin(), cache.begin() + static_cast<std::ptrdiff_t>(cache.size() / 2), cache.end());
+        depot().put(slot, cache, cache.size() / 2 + cache.size() % 2);
+    }
+    cache.push_back(item);
+}
+
+} // namespace
+
+PayloadPool::Payload PayloadPool::acquire(std::size_t size) {
+    auto const k = classFor(size);
+    if (k == CLASS_COUNT) {
+        return std::make_shared<std::vector<double>>(size);
+    }
+
+    auto payload = static_cast<std::vector<double>*>(take(k));
+    if (payload == nullptr) {
+        payload = new std::vector<double>();
+        payload->reserve(classCapacity(k));
+        payloadAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    payload->resize(size);
+    return Payload(payload, Recycler{}, BlockAllocator<std::vector<double>>{});
+}
+
+PayloadPool::Stats PayloadPool::stats() {
+    Stats stats;
+    stats.payloadAllocations = payloadAllocations.load(std::memory_order_relaxed);
+    stats.blockAllocations = blockAllocations.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void PayloadPool::Recycler::operator()(std::vector<double>* payload) const {
+    auto const k = classOf(payload->capacity());
+    if (k == CLASS_COUNT) {
+        delete payload;
+        return;
+    }
+    payload->clear();
+    give(k, payload);
+}
+
+void* PayloadPool::takeBlock() {
+    auto block = take(BLOCK_SLOT);
+    if (block == nullptr) {
+        block = ::operator new(BLOCK_SIZE);
+        blockAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    return block;
+}
+
+void PayloadPool::giveBlock(void* block) {
+    give(BLOCK_SLOT, block);
+}
@@ -0,0 +1,123 @@
+//     ____  __________     ___   ____ ___  _____ //
+//    / __ \/ ____/ __ \   |__ \ / __ \__ \|__  / //
+//   / /_/ / /   / / / /   __/ // / / /_/ / /_ <  //
+//  / ____/ /___/ /_/ /   / __// /_/ / __/___/ /  //
+// /_/    \____/\____/   /____/\____/____/____/   //
+// Auteurs : Timothée Van Hove, Aubry Mangold
+
+// Recycling of the payloads (data vectors) of the computations.
+
+#ifndef PAYLOADPOOL_H
+#define PAYLOADPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+/**
+ * @brief The PayloadPool class recycles the data vectors of the computations. The vectors are kept by size
+ * class (powers of two of their capacity), first in a cache of the thread that releases them, then in a
+ * shared depot once the cache is full. A payload goes back to the pool when its last shared_ptr is released,
+ * from whatever thread this happens, and the control blocks of the shared_ptr are recycled the same way.
+ * Once the pool holds the payloads needed by a workload, acquiring and releasing them does no heap allocation.
+ * @note Payloads larger than the largest class are neither pooled nor kept.
+ */
+class PayloadPool
+{
+public:
+    using Payload = std::shared_ptr<std::vector<double>>;
+
+    /**
+     * @brief MIN_CAPACITY The capacity of the smallest class
+     */
+    static constexpr std::size_t MIN_CAPACITY = 64;
+
+    /**
+     * @brief CLASS_COUNT The number of size classes, the largest holds 16M elements (128 MB)
+     */
+    static constexpr std::size_t CLASS_COUNT = 19;
+
+    /**
+     * @brief LOCAL_CACHE_SIZE The number of payloads of a class kept by each thread, half of them move to the
+     * depot when the cache is full
+     */
+    static constexpr std::size_t LOCAL_CACHE_SIZE = 16;
+
+    /**
+     * @brief DEPOT_BYTES The number of bytes of payloads of each class kept in the depot (at least 4 payloads)
+     */
+    static constexpr std::size_t DEPOT_BYTES = std::size_t{64} << 20;
+
+    /**
+     * @brief The Stats struct counts the heap allocations done by the pool
+     */
+    struct Stats
+    {
+        std::uint64_t payloadAllocations = 0;  ///< The number of vectors allocated
+        std::uint64_t blockAllocations = 0;    ///< The number of control blocks allocated
+    };
+
+    /**
+     * @brief acquire Returns a zeroed payload of size elements, its capacity is the one of its class
+     */
+    static Payload acquire(std::size_t size);
+
+    /**
+     * @brief stats Returns the number of allocations done so far by all the threads
+     */
+    static Stats stats();
+
+private:
+    /**
+     * @brief The Recycler struct is the deleter of the pooled payloads
+     */
+    struct Recycler
+    {
+        void operator()(std::vector<double>* payload) const;
+    };
+
+    /**
+     * @brief The BlockAllocator class allocates the control blocks of the pooled payloads from the pool
+     */
+    template <typename T>
+    struct BlockAllocator
+    {
+        using value_type = T;
+
+        BlockAllocator() = default;
+        template <typename U>
+        BlockAllocator(const BlockAllocator<U>&) {}
+
+        T* allocate(std::size_t n) {
+            if (n != 1 || sizeof(T) > BLOCK_SIZE || alignof(T) > alignof(std::max_align_t)) {
+                return static_cast<T*>(::operator new(n * sizeof(T)));
+            }
+            return static_cast<T*>(takeBlock());
+        }
+
+        void deallocate(T* p, std::size_t n) {
+            if (n != 1 || sizeof(T) > BLOCK_SIZE || alignof(T) > alignof(std::max_align_t)) {
+                ::operator delete(p);
+                return;
+            }
+            giveBlock(p);
+        }
+
+        template <typename U>
+        bool operator==(const BlockAllocator<U>&) const {return true;}
+        template <typename U>
+        bool operator!=(const BlockAllocator<U>&) const {return false;}
+    };
+
+    /**
+     * @brief BLOCK_SIZE The size of the recycled control blocks, larger ones are not recycled
+     */
+    static constexpr std::size_t BLOCK_SIZE = 64;
+
+    static void* takeBlock();
+    static void giveBlock(void* block);
+};
+
+#endif // PAYLOADPOOL_H
@@ -0,0 +1,159 @@
+//     ____  __________     ___   ____ ___  _____ //
+//    / __ \/ ____/ __ \   |__ \ / __ \__ \|__  / //
+//   / /_/ / /   / / / /   __/ // / / /_/ / /_ <  //
+//  / ____/ /___/ /_/ /   / __// /_/ / __/___/ /  //
+// /_/    \____/\____/   /____/\____/____/____/   //
+// Auteurs : Timothée Van Hove, Aubry Mangold
+
+#include "placement.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <pcosynchro/pcothread.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+/**
+ * @brief allowedCpus Returns the processors the process may run on
+ */
+CpuSet allowedCpus() {
+    CpuSet cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (std::size_t cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(static_cast<int>(cpu));
+            }
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        for (unsigned cpu = 0; cpu < std::max(std::thread::hardware_concurrency(), 1u); ++cpu) {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+    }
+    return cpus;
+}
+
+/**
+ * @brief readTopology Reads the processors of the NUMA nodes, nodes without processors are skipped
+ */
+CpuTopology readTopology() {
+    auto const allowed = allowedCpus();
+    std::vector<CpuSet> nodes;
+
+    // Node numbers may have holes, stop after a run of missing nodes
+    for (int node = 0, missing = 0; missing < 8; ++node) {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        std::string list;
+        if (!file || !std::getline(file, list)) {
+            ++missing;
+            continue;
+        }
+        missing = 0;
+
+        CpuSet cpus;
+        for (auto cpu : CpuTopology::parseCpuList(list)) {
+            if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end()) {
+                cpus.push_back(cpu);
+            }
+        }
+        if (!cpus.empty()) {
+            nodes.push_back(std::move(cpus));
+        }
+    }
+
+    if (nodes.empty()) {
+        nodes.push_back(allowed);
+    }
+    return CpuTopology(std::move(nodes));
+}
+
+} // namespace
+
+const CpuTopology& CpuTopology::system() {
+    static const CpuTopology topology = readTopology();
+    return topology;
+}
+
+CpuTopology::CpuTopology(std::vector<CpuSet> nodes): nodes(std::move(nodes)) {
+    for (auto const& node : this->nodes) {
+        allCpus.insert(allCpus.end(), node.begin(), node.end());
+    }
+}
+
+CpuSet CpuTopology::parseCpuList(const std::string& list) {
+    CpuSet cpus;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        auto const dash = range.find('-');
+        try {
+            auto const first = std::stoi(range.substr(0, dash));
+            auto const last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        } catch (const std::exception&) {
+            // Ignore malformed ranges (e.g. the empty list of a node without processors)
+        }
+    }
+    return cpus;
+}
+
+CpuSet Placement::cpusFor(int node, std::size_t index, const CpuTopology& topology) const {
+    if (!pinToCore && !groupByType) {
+        return {};
+    }
+
+    auto const& cpus = groupByType && node >= 0 ? topology.cpusOfNode(static_cast<std::size_t>(node) % topology.nodeCount())
+                                                : topology.cpus();
+    if (!pinToCore || cpus.empty()) {
+        return cpus;
+    }
+    return {cpus[index % cpus.size()]};
+}
+
+bool pinCurrentThread(const CpuSet& cpus) {
+#ifdef __linux__
+    if (cpus.empty()) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(static_cast<std::size_t>(cpu), &set);
+        }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+std::shared_ptr<std::vector<double>> allocateOnCpus(std::size_t size, const CpuSet& cpus) {
+    if (cpus.empty()) {
+        return std::make_shared<std::vector<double>>(size);
+    }
+
+    // The vector is zeroed (i.e. its pages are first written) by a thread running on the given processors
+    std::shared_ptr<std::vector<double>> data;
+    PcoThread toucher([&] {
+        pinCurrentThread(cpus);
+        data = std::make_shared<std::vector<double>>(size);
+    });
+    toucher.join();
+    return data;
+}
@@ -0,0 +1,95 @@
+//     ____  __________     ___   ____ ___  _____ //
+//    / __ \/ ____/ __ \   |__ \ / __ \__ \|__  / //
+//   / /_/ / /   / / / /   __/ // / / /_/ / /_ <  //
+//  / ____/ /___/ /_/ /   / __// /_/ / __/___/ /  //
+// /_/    \____/\____/   /____/\____/____/____/   //
+// Auteurs : Timothée Van Hove, Aubry Mangold
+
+// Placement of the threads on the processors and of the memory on the NUMA nodes.
+
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief CpuSet A set of logical processor numbers, empty means no restriction
+ */
+using CpuSet = std::vector<int>;
+
+/**
+ * @brief The CpuTopology class lists the processors of each NUMA node
+ */
+class CpuTopology
+{
+public:
+    /**
+     * @brief system Returns the topology of the machine, read once from /sys (a single node holding the
+     * processors the process may use if it is not available)
+     */
+    static const CpuTopology& system();
+
+    /**
+     * @brief CpuTopology Constructs a topology from the processors of each node
+     */
+    explicit CpuTopology(std::vector<CpuSet> nodes);
+
+    [[nodiscard]] std::size_t nodeCount() const {return nodes.size();}
+    [[nodiscard]] const CpuSet& cpusOfNode(std::size_t node) const {return nodes.at(node);}
+
+    /**
+     * @brief cpus Returns all the processors, node by node
+     */
+    [[nodiscard]] const CpuSet& cpus() const {return allCpus;}
+
+    /**
+     * @brief parseCpuList Parses a list of processors in the format of the kernel, e.g. "0-3,8,10-11"
+     */
+    static CpuSet parseCpuList(const std::string& list);
+
+private:
+    std::vector<CpuSet> nodes;
+    CpuSet allCpus;
+};
+
+/**
+ * @brief The Placement struct sets where the threads of the compute engines run.
+ * With pinToCore each engine runs on a single processor, engines being spread round-robin over the
+ * processors. With groupByType the engines of a type share the processors of one NUMA node (the node of
+ * a type is its index modulo the number of nodes), combined with pinToCore they are spread over this node.
+ * With firstTouch the payloads allocated through the environment are first written by a thread running on
+ * the node of the engines of their type, which makes the kernel place their pages on this node.
+ */
+struct Placement
+{
+    bool pinToCore = false;
+    bool groupByType = false;
+    bool firstTouch = false;
+
+    /**
+     * @brief cpusFor Returns the processors an engine may run on
+     * @param node the NUMA node of the engine (modulo the number of nodes), negative if it is not bound to a node
+     * @param index the index of the engine among the engines placed on the same node (or on any node)
+     * @param topology the topology of the machine
+     */
+    [[nodiscard]] CpuSet cpusFor(int node, std::size_t index, const CpuTopology& topology = CpuTopology::system()) const;
+};
+
+/**
+ * @brief pinCurrentThread Restricts the calling thread to a set of processors
+ * @return true on success, false if the set is empty or the system refused it
+ */
+bool pinCurrentThread(const CpuSet& cpus);
+
+/**
+ * @brief allocateOnCpus Allocates a zeroed payload of the given size whose pages are first written from the
+ * given processors, which places them on the NUMA node of these processors (first-touch policy)
+ * @param size the number of elements
+ * @param cpus the processors on which to touch the pages, no placement if empty
+ */
+std::shared_ptr<std::vector<double>> allocateOnCpus(std::size_t size, const CpuSet& cpus);
+
+#endif // PLACEMENT_H
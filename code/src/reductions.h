@@ -0,0 +1,368 @@
+//     ____  __________     ___   ____ ___  _____ //
+//    / __ \/ ____/ __ \   |__ \ / __ \__ \|__  / //
+//   / /_/ / /   / / / /   __/ // / / /_/ / /_ <  //
+//  / ____/ /___/ /_/ /   / __// /_/ / __/___/ /  //
+// /_/    \____/\____/   /____/\____/____/____/   //
+// Auteurs : Timothée Van Hove, Aubry Mangold
+
+// Reduction operations for the ReductionEngine template. A reduction provides:
+//   Accumulator                                     the running state of the reduction
+//   Accumulator identity() const                    the state before any element
+//   void accumulate(Accumulator&, const double*, n) adds n elements to the state
+//   bool isFinal(const Accumulator&) const          true if the remaining elements can not change the result
+//   double value(const Accumulator&) const          the result
+//   ResultStatus status(const Accumulator&) const   whether the result can be trusted
+//   std::pair<double, std::int64_t> partial(const Accumulator&) const
+//                                                   the result of a shard as value * 2^exponent
+// The accumulate() function is called with whole chunks so that it can be inlined and vectorized.
+// A reduction may also provide accumulate() for the other element types (const float*, const std::int32_t*,
+// const std::int64_t*), the elements are converted to doubles a block at a time otherwise (see accumulateElements),
+// and std::optional<std::int64_t> exact(const Accumulator&) const for the exact result over integer elements.
+// The elements of a computation with an element map are mapped before the kernel, see accumulateMapped.
+// A reduction whose state depends on the request provides Accumulator identity(const Request&) const, and one
+// that gives several aggregates Aggregates aggregates(const Accumulator&) const.
+
+#ifndef REDUCTIONS_H
+#define REDUCTIONS_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "computationmanager.h"
+#include "kernels.h"
+
+/**
+ * @brief The SumReduction struct sums the elements with the vectorized sum kernel
+ */
+struct SumReduction
+{
+    using Accumulator = SumAccumulator;
+
+    SumReduction(SummationMode mode = SummationMode::Fast): mode(mode) {}
+
+    [[nodiscard]] Accumulator identity() const {return {};}
+    void accumulate(Accumulator& acc, const double* values, std::size_t n) const {accumulateSum(acc, values, n, mode);}
+    void accumulate(Accumulator& acc, const float* values, std::size_t n) const {accumulateSum(acc, values, n, mode);}
+    void accumulate(Accumulator& acc, const std::int32_t* values, std::size_t n) const {accumulateSum(acc, values, n);}
+    void accumulate(Accumulator& acc, const std::int64_t* values, std::size_t n) const {accumulateSum(acc, values, n);}
+    [[nodiscard]] bool isFinal(const Accumulator&) const {return false;}
+    [[nodiscard]] double value(const Accumulator& acc) const {return acc.value();}
+    [[nodiscard]] ResultStatus status(const Accumulator& acc) const {return acc.integerOverflow ? ResultStatus::Overflow : ResultStatus::Ok;}
+    [[nodiscard]] std::pair<double, std::int64_t> partial(const Accumulator& acc) const {return {acc.value(), 0};}
+
+    [[nodiscard]] std::optional<std::int64_t> exact(const Accumulator& acc) const {
+        return acc.integerOverflow ? std::nullopt : std::optional<std::int64_t>(acc.integer);
+    }
+
+    SummationMode mode;
+};
+
+/**
+ * @brief The ProductReduction struct multiplies the elements with the scaled product kernel, which reports
+ * products out of the range of a double instead of silently giving infinity or zero
+ */
+struct ProductReduction
+{
+    using Accumulator = ProductAccumulator;
+
+    [[nodiscard]] Accumulator identity() const {return {};}
+    void accumulate(Accumulator& acc, const double* values, std::size_t n) const {accumulateProduct(acc, values, n);}
+    [[nodiscard]] bool isFinal(const Accumulator& acc) const {return acc.isFinal();}
+    [[nodiscard]] double value(const Accumulator& acc) const {return acc.value();}
+
+    [[nodiscard]] ResultStatus status(const Accumulator& acc) const {
+        return acc.overflows()  ? ResultStatus::Overflow
+             : acc.underflows() ? ResultStatus::Underflow
+                                : ResultStatus::Ok;
+    }
+
+    // The partial product of a shard keeps its exponent apart, it may well be out of range on its own
+    [[nodiscard]] std::pair<double, std::int64_t> partial(const Accumulator& acc) const {
+        if (acc.isFinal() || acc.infinite || acc.mantissa == 0.0) {
+            return {acc.value(), 0};
+        }
+        return {acc.mantissa, acc.exponent};
+    }
+};
+
+/**
+ * @brief The Unchanged struct is the transform that leaves the elements as they are
+ */
+struct Unchanged
+{
+    double operator()(double x) const {return x;}
+};
+
+/**
+ * @brief The Square struct is the transform that squares the elements
+ */
+struct Square
+{
+    double operator()(double x) const {return x * x;}
+};
+
+/**
+ * @brief The Minimum struct returns the smallest of two values (the first one if they are not ordered)
+ */
+struct Minimum
+{
+    double operator()(double a, double b) const {return b < a ? b : a;}
+};
+
+/**
+ * @brief The Maximum struct returns the largest of two values (the first one if they are not ordered)
+ */
+struct Maximum
+{
+    double operator()(double a, double b) const {return b > a ? b : a;}
+};
+
+/**
+ * @brief Identity elements for ElementwiseReduction
+ */
+struct Zero {static constexpr double value = 0.0;};
+struct PositiveInfinity {static constexpr double value = std::numeric_limits<double>::infinity();};
+struct NegativeInfinity {static constexpr double value = -std::numeric_limits<double>::infinity();};
+
+/**
+ * @brief The ElementwiseReduction class turns a binary operation into a reduction: the result is
+ * op(...op(op(identity, transform(x0)), transform(x1))..., transform(xn)).
+ * @note The elements are spread over independent lanes so that the loop vectorizes, the operation must
+ * thus be associative and commutative (up to rounding).
+ * @tparam BinaryOp the operation, a functor taking and returning doubles
+ * @tparam Identity a type whose static member value is the identity element of the operation
+ * @tparam Transform a functor applied to each element before the operation
+ */
+template <typename BinaryOp, typename Identity, typename Transform = Unchanged>
+struct ElementwiseReduction
+{
+    using Accumulator = double;
+
+    /**
+     * @brief LANES The number of independent accumulators, two AVX-512 or four AVX2 registers
+     */
+    static constexpr std::size_t LANES = 16;
+
+    [[nodiscard]] Accumulator identity() const {return Identity::value;}
+
+    void accumulate(Accumulator& acc, const double* values, std::size_t n) const {
+        std::array<double, LANES> lanes;
+        lanes.fill(Identity::value);
+
+        std::size_t i = 0;
+        for (; i + LANES <= n; i += LANES) {
+            for (std::size_t lane = 0; lane < LANES; ++lane) {
+                lanes[lane] = op(lanes[lane], transform(values[i + lane]));
+            }
+        }
+        for (; i < n; ++i) {
+            acc = op(acc, transform(values[i]));
+        }
+        for (auto const lane : lanes) {
+            acc = op(acc, lane);
+        }
+    }
+
+    [[nodiscard]] bool isFinal(const Accumulator&) const {return false;}
+    [[nodiscard]] double value(const Accumulator& acc) const {return acc;}
+    [[nodiscard]] ResultStatus status(const Accumulator&) const {return ResultStatus::Ok;}
+    [[nodiscard]] std::pair<double, std::int64_t> partial(const Accumulator& acc) const {return {acc, 0};}
+
+    BinaryOp op;
+    Transform transform;
+};
+
+using MinReduction = ElementwiseReduction<Minimum, PositiveInfinity>;
+using MaxReduction = ElementwiseReduction<Maximum, NegativeInfinity>;
+using SumOfSquaresReduction = ElementwiseReduction<std::plus<>, Zero, Square>;
+
+/**
+ * @brief The AggregateAccumulator struct holds the running aggregates of a computation of type D
+ */
+struct AggregateAccumulator
+{
+    AggregateSet wanted;
+    SumAccumulator sum;
+    ProductAccumulator product;
+    double min = PositiveInfinity::value;
+    double max = NegativeInfinity::value;
+    std::uint64_t count = 0;
+};
+
+/**
+ * @brief The AggregateReduction struct computes the aggregates asked for by a request in one scan of its
+ * elements. The kernels of the sum, product, min and max reductions take each block in turn: the first one
+ * reads it from memory, the others find it in the L1 cache.
+ * @note Its value is the first aggregate asked for, in the order of Aggregate
+ */
+struct AggregateReduction
+{
+    using Accumulator = AggregateAccumulator;
+
+    /**
+     * @brief BLOCK The number of elements passed to every kernel in turn, 16 KiB stay in the L1 cache
+     */
+    static constexpr std::size_t BLOCK = 2048;
+
+    [[nodiscard]] Accumulator identity() const {
+        Accumulator acc;
+        acc.wanted = AggregateSet::all();
+        return acc;
+    }
+
+    [[nodiscard]] Accumulator identity(const Request& request) const {
+        Accumulator acc;
+        acc.wanted = request.getAggregates();
+        return acc;
+    }
+
+    void accumulate(Accumulator& acc, const double* values, std::size_t n) const {
+        for (std::size_t i = 0; i < n; i += BLOCK) {
+            auto const block = values + i;
+            auto const count = std::min(BLOCK, n - i);
+            if (acc.wanted.contains(Aggregate::Sum)) {
+                accumulateSum(acc.sum, block, count);
+            }
+            if (acc.wanted.contains(Aggregate::Product) && !acc.product.isFinal()) {
+                accumulateProduct(acc.product, block, count);
+            }
+            if (acc.wanted.contains(Aggregate::Min)) {
+                MinReduction().accumulate(acc.min, block, count);
+            }
+            if (acc.wanted.contains(Aggregate::Max)) {
+                MaxReduction().accumulate(acc.max, block, count);
+            }
+        }
+        acc.count += n;
+    }
+
+    [[nodiscard]] bool isFinal(const Accumulator&) const {return false;}
+
+    [[nodiscard]] double value(const Accumulator& acc) const {
+        auto const result = aggregates(acc);
+        return acc.wanted.contains(Aggregate::Sum)     ? result.sum
+             : acc.wanted.contains(Aggregate::Product) ? result.product
+             : acc.wanted.contains(Aggregate::Min)     ? result.min
+             : acc.wanted.contains(Aggregate::Max)     ? result.max
+                                                       : static_cast<double>(result.count);
+    }
+
+    // Only the product may be out of range
+    [[nodiscard]] ResultStatus status(const Accumulator& acc) const {
+        return acc.wanted.contains(Aggregate::Product) ? ProductReduction().status(acc.product) : ResultStatus::Ok;
+    }
+
+    [[nodiscard]] std::pair<double, std::int64_t> partial(const Accumulator& acc) const {return {value(acc), 0};}
+
+    [[nodiscard]] Aggregates aggregates(const Accumulator& acc) const {
+        Aggregates result;
+        result.computed = acc.wanted;
+        if (acc.wanted.contains(Aggregate::Sum)) {
+            result.sum = acc.sum.value();
+        }
+        if (acc.wanted.contains(Aggregate::Product)) {
+            result.product = acc.product.value();
+        }
+        if (acc.wanted.contains(Aggregate::Min)) {
+            result.min = acc.min;
+        }
+        if (acc.wanted.contains(Aggregate::Max)) {
+            result.max = acc.max;
+        }
+        if (acc.wanted.contains(Aggregate::Count)) {
+            result.count = acc.count;
+        }
+        return result;
+    }
+};
+
+/**
+ * @brief The AccumulatesElements trait tells whether a reduction has an accumulate() for elements of type T
+ */
+template <typename Op, typename T, typename = void>
+struct AccumulatesElements : std::false_type {};
+
+template <typename Op, typename T>
+struct AccumulatesElements<Op, T, std::void_t<decltype(std::declval<const Op&>().accumulate(
+    std::declval<typename Op::Accumulator&>(), std::declval<const T*>(), std::size_t{}))>> : std::true_type {};
+
+/**
+ * @brief The HasExactResult trait tells whether a reduction gives an exact result over integer elements
+ */
+template <typename Op, typename = void>
+struct HasExactResult : std::false_type {};
+
+template <typename Op>
+struct HasExactResult<Op, std::void_t<decltype(std::declval<const Op&>().exact(std::declval<const typename Op::Accumulator&>()))>>
+    : std::true_type {};
+
+/**
+ * @brief The StartsFromRequest trait tells whether a reduction sets up its state from the request
+ */
+template <typename Op, typename = void>
+struct StartsFromRequest : std::false_type {};
+
+template <typename Op>
+struct StartsFromRequest<Op, std::void_t<decltype(std::declval<const Op&>().identity(std::declval<const Request&>()))>>
+    : std::true_type {};
+
+/**
+ * @brief The HasAggregates trait tells whether a reduction gives several aggregates besides its value
+ */
+template <typename Op, typename = void>
+struct HasAggregates : std::false_type {};
+
+template <typename Op>
+struct HasAggregates<Op, std::void_t<decltype(std::declval<const Op&>().aggregates(std::declval<const typename Op::Accumulator&>()))>>
+    : std::true_type {};
+
+/**
+ * @brief ELEMENT_BLOCK The number of elements converted or mapped at once, the block fits in the L1 cache
+ */
+constexpr std::size_t ELEMENT_BLOCK = 256;
+
+/**
+ * @brief accumulateElements Adds n elements of any type to the state of a reduction, with the kernel of the
+ * reduction for this type if it has one, otherwise converted to doubles a block at a time
+ */
+template <typename Op, typename T>
+void accumulateElements(const Op& op, typename Op::Accumulator& acc, const T* values, std::size_t n) {
+    if constexpr (AccumulatesElements<Op, T>::value) {
+        op.accumulate(acc, values, n);
+    } else {
+        std::array<double, ELEMENT_BLOCK> block;
+        for (std::size_t i = 0; i < n; i += ELEMENT_BLOCK) {
+            auto const count = std::min(ELEMENT_BLOCK, n - i);
+            std::transform(values + i, values + i + count, block.begin(), [](T x) { return static_cast<double>(x); });
+            op.accumulate(acc, block.data(), count);
+        }
+    }
+}
+
+/**
+ * @brief accumulateMapped Adds n elements passed through an element map to the state of a reduction. Each block
+ * of elements is converted and mapped into a buffer that stays in the L1 cache, then reduced with the kernel for
+ * doubles: the elements are read from memory once.
+ */
+template <typename Op, typename T>
+void accumulateMapped(const Op& op, typename Op::Accumulator& acc, const ElementMap& map, const T* values, std::size_t n) {
+    std::array<double, ELEMENT_BLOCK> block;
+    for (std::size_t i = 0; i < n; i += ELEMENT_BLOCK) {
+        auto const count = std::min(ELEMENT_BLOCK, n - i);
+        if constexpr (std::is_same_v<T, double>) {
+            map.apply(values + i, block.data(), count);
+        } else {
+            std::transform(values + i, values + i + count, block.begin(), [](T x) { return static_cast<double>(x); });
+            map.apply(block.data(), block.data(), count);
+        }
+        op.accumulate(acc, block.data(), count);
+    }
+}
+
+#endif // REDUCTIONS_H
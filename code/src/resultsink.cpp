@@ -0,0 +1,169 @@
+//     ____  __________     ___   ____ ___  _____ //
+//    / __ \/ ____/ __ \   |__ \ / __ \__ \|__  / //
+//   / /_/ / /   / / / /   __/ // / / /_/ / /_ <  //
+//  / ____/ /___/ /_/ /   / __// /_/ / __/___/ /  //
+// /_/    \____/\____/   /____/\____/____/____/   //
+// Auteurs : Timothée Van Hove, Aubry Mangold
+
+#include "resultsink.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#include "batchfile.h"
+
+namespace {
+
+std::size_t roundUpToPowerOfTwo(std::size_t n) {
+    std::size_t power = 1;
+    while (power < n) {
+        power <<= 1;
+    }
+    return power;
+}
+
+const char* statusName(ResultStatus status) {
+    switch (status) {
+    case ResultStatus::Ok:              return "Ok";
+    case ResultStatus::Overflow:        return "Overflow";
+    case ResultStatus::Underflow:       return "Underflow";
+    case ResultStatus::InvalidOperands: return "InvalidOperands";
+    }
+    return "?";
+}
+
+} // namespace
+
+ResultSink::ResultSink(std::shared_ptr<ClientInterface> computationManager, Output output, SinkPolicy policy)
+    : computationManager(std::move(computationManager)), output(std::move(output)), policy(policy),
+      slots(roundUpToPowerOfTwo(std::max<std::size_t>(policy.capacity, 1)), Result(0, 0.0)), mask(slots.size() - 1) {}
+
+ResultSink::Output ResultSink::toResultFile(const std::string& path) {
+    auto file = std::make_shared<std::ofstream>(path, std::ios::binary);
+    if (!*file) {
+        throw std::runtime_error("Could not create " + path);
+    }
+    auto writer = std::make_shared<BatchResultWriter>(*file);
+    return [file, writer](const Result* results, std::size_t count) {
+        for (std::size_t i = 0; i < count; ++i) {
+            writer->write(results[i]);
+        }
+        file->flush();
+    };
+}
+
+ResultSink::Output ResultSink::toText(std::ostream& out) {
+    return [&out](const Result* results, std::size_t count) {
+        for (std::size_t i = 0; i < count; ++i) {
+            out << results[i].getId() << ' ' << results[i].getResult() << ' ' << statusName(results[i].getStatus()) << '\n';
+        }
+        out.flush();
+    };
+}
+
+SinkStats ResultSink::getStats() const {
+    SinkStats stats;
+    stats.written = written.load(std::memory_order_relaxed);
+    stats.dropped = dropped.load(std::memory_order_relaxed);
+    stats.stalls = stalls.load(std::memory_order_relaxed);
+    stats.buffered = tail.load(std::memory_order_relaxed) - head.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void ResultSink::run() {
+    PcoThread writer(&ResultSink::write, this);
+
+    try {
+        for (;;) {
+            push(computationManager->getNextResult());
+        }
+    } catch (ComputationManager::StopException&) {
+        // The buffered results are still written
+    }
+
+    closed.store(true, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (writerSleeping.exchange(false)) {
+        wakeWriter.release();
+    }
+    writer.join();
+}
+
+void ResultSink::push(Result result) {
+    auto const position = tail.load(std::memory_order_relaxed);
+
+    while (position - head.load(std::memory_order_acquire) == slots.size()) {
+        if (policy.overflow == OverflowPolicy::DropNewest) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        // Sleep until the writer frees a slot, the flag is checked by the writer after it moved head
+        stalls.fetch_add(1, std::memory_order_relaxed);
+        drainSleeping.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (position - head.load(std::memory_order_acquire) == slots.size()) {
+            wakeDrain.acquire();
+        }
+        drainSleeping.store(false);
+    }
+
+    slots[position & mask] = std::move(result);
+    tail.store(position + 1, std::memory_order_release);
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (writerSleeping.exchange(false)) {
+        wakeWriter.release();
+    }
+}
+
+void ResultSink::write() {
+    std::vector<Result> batch;
+    batch.reserve(std::max<std::size_t>(policy.batchSize, 1));
+
+    for (;;) {
+        auto const position = head.load(std::memory_order_relaxed);
+        auto const available = tail.load(std::memory_order_acquire) - position;
+
+        if (available > 0) {
+            // The results are copied out so that the buffer takes new ones while the output is running
+            auto const count = std::min(available, batch.capacity());
+            batch.clear();
+            for (std::size_t i = 0; i < count; ++i) {
+                batch.push_back(slots[(position + i) & mask]);
+            }
+            head.store(position + count, std::memory_order_release);
+
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (drainSleeping.exchange(false)) {
+                wakeDrain.release();
+            }
+
+            try {
+                output(batch.data(), count);
+                written.fetch_add(count, std::memory_order_relaxed);
+            } catch (std::exception&) {
+                dropped.fetch_add(count, std::memory_order_relaxed);
+            }
+            continue;
+        }
+
+        if (closed.load(std::memory_order_acquire)) {
+            // Every result was pushed before the sink was closed
+            if (tail.load(std::memory_order_acquire) == position) {
+                return;
+            }
+            continue;
+        }
+
+        // Sleep until the drain pushes a result or closes the sink, the flag is checked by the drain after it
+        // moved tail
+        writerSleeping.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (tail.load(std::memory_order_acquire) == position && !closed.load(std::memory_order_acquire)) {
+            wakeWriter.acquire();
+        }
+        writerSleeping.store(false);
+    }
+}
@@ -0,0 +1,136 @@
+//     ____  __________     ___   ____ ___  _____ //
+//    / __ \/ ____/ __ \   |__ \ / __ \__ \|__  / //
+//   / /_/ / /   / / / /   __/ // / / /_/ / /_ <  //
+//  / ____/ /___/ /_/ /   / __// /_/ / __/___/ /  //
+// /_/    \____/\____/   /____/\____/____/____/   //
+// Auteurs : Timothée Van Hove, Aubry Mangold
+
+#ifndef RESULTSINK_H
+#define RESULTSINK_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "computationmanager.h"
+#include "launchable.h"
+#include "pcosynchro/pcosemaphore.h"
+
+/**
+ * @brief The OverflowPolicy enum tells what the sink does with a result when its buffer is full
+ */
+enum class OverflowPolicy {
+    Block,      ///< The sink stops draining the manager until the output catches up (the engines block in turn)
+    DropNewest  ///< The result is dropped and counted, the manager is drained at the pace of the engines
+};
+
+/**
+ * @brief The SinkPolicy struct sets the buffer of a ResultSink
+ */
+struct SinkPolicy
+{
+    /**
+     * @brief capacity The number of results buffered between the manager and the output, rounded up to a
+     * power of two
+     */
+    std::size_t capacity = 4096;
+
+    /**
+     * @brief batchSize The maximum number of results handed to the output at once
+     */
+    std::size_t batchSize = 256;
+
+    OverflowPolicy overflow = OverflowPolicy::Block;
+};
+
+/**
+ * @brief The SinkStats struct is a snapshot of the counters of a ResultSink
+ */
+struct SinkStats
+{
+    std::size_t written = 0;   ///< The results handed to the output
+    std::size_t dropped = 0;   ///< The results dropped on a full buffer (DropNewest) or by a failed output
+    std::size_t stalls = 0;    ///< The times the sink waited for room in the buffer (Block)
+    std::size_t buffered = 0;  ///< The results waiting in the buffer
+};
+
+/**
+ * @brief The ResultSink class takes the results of a computation manager off the client. Its thread drains
+ * getNextResult() into a lock-free buffer, and a writer thread hands the buffered results to the output by
+ * batches, so that a slow output never keeps the results from being drained.
+ * The results reach the output in the order of the requests. The sink stops once the manager is stopped,
+ * after the buffered results have been written.
+ * @note Runs on threads, it must not be started on a fiber
+ */
+class ResultSink : public Launchable
+{
+public:
+    /**
+     * @brief Output Writes a batch of results, called from the writer thread only. The results of a batch
+     * whose output throws are counted as dropped.
+     */
+    using Output = std::function<void(const Result* results, std::size_t count)>;
+
+    ResultSink(std::shared_ptr<ClientInterface> computationManager, Output output, SinkPolicy policy = {});
+
+    /**
+     * @brief toResultFile Returns an output writing the results to a binary result file (see batchfile.h),
+     * flushed after every batch. Throws std::runtime_error if the file can not be created.
+     */
+    static Output toResultFile(const std::string& path);
+
+    /**
+     * @brief toText Returns an output writing one line per result (id, result and status) to a stream, e.g.
+     * a pipe or std::cout, flushed after every batch
+     * @note The stream must outlive the sink
+     */
+    static Output toText(std::ostream& out);
+
+    [[nodiscard]] SinkStats getStats() const;
+
+protected:
+    void run() override;
+
+    void printStartMessage() const override {qDebug() << "[START] Result sink launched";}
+    void printCompletionMessage() const override {qDebug() << "[STOP] Result sink";}
+
+private:
+    /**
+     * @brief push Buffers a result, applies the overflow policy when the buffer is full
+     * @note Called by the draining thread only
+     */
+    void push(Result result);
+
+    /**
+     * @brief write The writer thread, empties the buffer into the output until the sink is closed
+     */
+    void write();
+
+    const std::shared_ptr<ClientInterface> computationManager;
+    const Output output;
+    const SinkPolicy policy;
+
+    // Single producer (the draining thread), single consumer (the writer thread) ring buffer. Each index is
+    // only written by its own side, they are kept on separate cache lines.
+    std::vector<Result> slots;
+    const std::size_t mask;
+    alignas(64) std::atomic<std::size_t> head{0};
+    alignas(64) std::atomic<std::size_t> tail{0};
+    alignas(64) std::atomic<bool> closed{false};
+
+    // A side that finds nothing to do raises its flag and sleeps on its semaphore, the other side wakes it
+    std::atomic<bool> writerSleeping{false};
+    std::atomic<bool> drainSleeping{false};
+    PcoSemaphore wakeWriter{0};
+    PcoSemaphore wakeDrain{0};
+
+    std::atomic<std::size_t> written{0};
+    std::atomic<std::size_t> dropped{0};
+    std::atomic<std::size_t> stalls{0};
+};
+
+#endif // RESULTSINK_H
@@ -0,0 +1,182 @@
+//     ____  __________     ___   ____ ___  _____ //
+//    / __ \/ ____/ __ \   |__ \ / __ \__ \|__  / //
+//   / /_/ / /   / / / /   __/ // / / /_/ / /_ <  //
+//  / ____/ /___/ /_/ /   / __// /_/ / __/___/ /  //
+// /_/    \____/\____/   /____/\____/____/____/   //
+// Auteurs : Timothée Van Hove, Aubry Mangold
+
+#ifndef UTILIZATION_H
+#define UTILIZATION_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <utility>
+
+#include "computationmanager.h"
+
+/**
+ * @brief The EngineUtilization struct is a snapshot of where a compute engine spent its time since it started
+ */
+struct EngineUtilization
+{
+    ComputationType type = ComputationType::COUNT;  ///< The type of the engine or of its last computation
+    int id = 0;                                     ///< The id of the engine among the engines of its class
+
+    std::chrono::nanoseconds busy{0};     ///< Computing requests that were completed (or preempted and resumable)
+    std::chrono::nanoseconds idle{0};     ///< Waiting for work in getWork
+    std::chrono::nanoseconds blocked{0};  ///< Handing results and preempted requests back to the manager
+    std::chrono::nanoseconds wasted{0};   ///< Computing requests whose work was thrown away (aborted or restarted)
+
+    std::uint64_t completed = 0;  ///< The number of results provided
+    std::uint64_t aborted = 0;    ///< The number of computations dropped because they were aborted
+    std::uint64_t yielded = 0;    ///< The number of computations given back because they were preempted
+
+    /**
+     * @brief utilization Returns the share of the time spent on useful work, between 0 and 1
+     */
+    [[nodiscard]] double utilization() const {
+        auto const total = busy + idle + blocked + wasted;
+        return total.count() == 0 ? 0.0 : static_cast<double>(busy.count()) / static_cast<double>(total.count());
+    }
+};
+
+/**
+ * @brief The UtilizationCounters class accumulates the time of a compute engine by activity. The engine
+ * timestamps the end of each activity (lap), the time since the previous timestamp is charged to it.
+ * The time spent on a computation, including the checks for cancellation between its steps, is held until the
+ * computation ends, it is then charged as busy or wasted.
+ * @note Only the thread of the engine writes the counters, which are read by snapshot() from any thread: they
+ * are updated with relaxed stores without any read-modify-write, and kept on their own cache line.
+ */
+class UtilizationCounters
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    UtilizationCounters() = default;
+
+    // Movable with the engine as long as it is not running
+    UtilizationCounters(UtilizationCounters&& other) noexcept {*this = std::move(other);}
+    UtilizationCounters& operator=(UtilizationCounters&& other) noexcept {
+        last = other.last;
+        job = other.job;
+        copy(busyTime, other.busyTime);
+        copy(idleTime, other.idleTime);
+        copy(blockedTime, other.blockedTime);
+        copy(wastedTime, other.wastedTime);
+        copy(completedCount, other.completedCount);
+        copy(abortedCount, other.abortedCount);
+        copy(yieldedCount, other.yieldedCount);
+        return *this;
+    }
+
+    /**
+     * @brief start Starts the timing, called once by the engine before its first activity
+     */
+    void start() {last = Clock::now();}
+
+    /**
+     * @brief idle Charges the time since the last timestamp to waiting for work
+     */
+    void idle() {add(idleTime, lap());}
+
+    /**
+     * @brief blocked Charges the time since the last timestamp to the calls to the manager
+     */
+    void blocked() {add(blockedTime, lap());}
+
+    /**
+     * @brief work Charges the time since the last timestamp to the current computation
+     */
+    void work() {job += lap();}
+
+    /**
+     * @brief complete Ends the current computation with a result
+     */
+    void complete() {complete(1);}
+
+    /**
+     * @brief complete Ends the current batch of count computations with their results, the time of the batch
+     * is charged once
+     */
+    void complete(std::uint64_t count) {endJob(busyTime, completedCount, count);}
+
+    /**
+     * @brief abort Ends the current computation without result, its time was wasted
+     */
+    void abort() {endJob(wastedTime, abortedCount);}
+
+    /**
+     * @brief yield Ends the current computation because it was preempted, its time is wasted if it restarts
+     * @param resumable true if the progress of the computation was saved
+     */
+    void yield(bool resumable) {endJob(resumable ? busyTime : wastedTime, yieldedCount);}
+
+    /**
+     * @brief snapshot Returns the counters (the type and id of the result are left to the engine)
+     */
+    [[nodiscard]] EngineUtilization snapshot() const {
+        EngineUtilization u;
+        u.busy = std::chrono::nanoseconds(busyTime.load(std::memory_order_relaxed));
+        u.idle = std::chrono::nanoseconds(idleTime.load(std::memory_order_relaxed));
+        u.blocked = std::chrono::nanoseconds(blockedTime.load(std::memory_order_relaxed));
+        u.wasted = std::chrono::nanoseconds(wastedTime.load(std::memory_order_relaxed));
+        u.completed = completedCount.load(std::memory_order_relaxed);
+        u.aborted = abortedCount.load(std::memory_order_relaxed);
+        u.yielded = yieldedCount.load(std::memory_order_relaxed);
+        return u;
+    }
+
+private:
+    std::int64_t lap() {
+        auto const now = Clock::now();
+        auto const elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count();
+        last = now;
+        return elapsed;
+    }
+
+    template <typename T>
+    static void add(std::atomic<T>& counter, T value) {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    template <typename T>
+    static void copy(std::atomic<T>& counter, const std::atomic<T>& other) {
+        counter.store(other.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    void endJob(std::atomic<std::int64_t>& time, std::atomic<std::uint64_t>& count, std::uint64_t jobs = 1) {
+        add(time, job);
+        add(count, jobs);
+        job = 0;
+    }
+
+    // Only used by the thread of the engine
+    Clock::time_point last{};
+    std::int64_t job = 0;
+
+    alignas(64) std::atomic<std::int64_t> busyTime = 0;
+    std::atomic<std::int64_t> idleTime = 0;
+    std::atomic<std::int64_t> blockedTime = 0;
+    std::atomic<std::int64_t> wastedTime = 0;
+    std::atomic<std::uint64_t> completedCount = 0;
+    std::atomic<std::uint64_t> abortedCount = 0;
+    std::atomic<std::uint64_t> yieldedCount = 0;
+};
+
+/**
+ * @brief The UtilizationReporter class is implemented by the compute engines that account for their time
+ */
+class UtilizationReporter
+{
+public:
+    virtual ~UtilizationReporter() = default;
+
+    /**
+     * @brief getUtilization Returns a snapshot of the utilization of the engine, may be called from any thread
+     */
+    [[nodiscard]] virtual EngineUtilization getUtilization() const = 0;
+};
+
+#endif // UTILIZATION_H
@@ -0,0 +1,128 @@
+//     ____  __________     ___   ____ ___  _____ //
+//    / __ \/ ____/ __ \   |__ \ / __ \__ \|__  / //
+//   / /_/ / /   / / / /   __/ // / / /_/ / /_ <  //
+//  / ____/ /___/ /_/ /   / __// /_/ / __/___/ /  //
+// /_/    \____/\____/   /____/\____/____/____/   //
+// Auteurs : Timothée Van Hove, Aubry Mangold
+
+#ifndef WAITSTRATEGY_H
+#define WAITSTRATEGY_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+/**
+ * @brief The WaitStrategy enum selects how the threads waiting on the ComputationManager behave.
+ * Park blocks on the monitor condition right away, SpinThenPark first spins (then yields) for an
+ * adaptive amount of time and only blocks on the condition if nothing arrived in the meantime.
+ */
+enum class WaitStrategy {Park, SpinThenPark};
+
+/**
+ * @brief The AdaptiveSpinner class decides for how long a waiter should spin before parking.
+ * It keeps an exponentially weighted moving average of the intervals between arrivals (requests or
+ * results) and only spins for a long time when the next arrival is expected within the spin window.
+ * @note recordArrival() must be called by one thread at a time (i.e. from inside the monitor), the
+ * spinning itself happens outside of the monitor and only reads the estimate.
+ */
+class AdaptiveSpinner
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief MIN_SPIN The spin duration used when arrivals are rare or not yet known
+     */
+    static constexpr std::chrono::nanoseconds MIN_SPIN{1'000};
+
+    /**
+     * @brief MAX_SPIN The longest a waiter will ever spin before parking
+     */
+    static constexpr std::chrono::nanoseconds MAX_SPIN{50'000};
+
+    /**
+     * @brief recordArrival Registers an arrival and updates the interval estimate
+     */
+    void recordArrival() {
+        auto const now = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+        auto const last = lastArrival.exchange(now, std::memory_order_relaxed);
+        if (last == 0) {
+            return;
+        }
+
+        // The newest interval weighs 1/8 in the average, which smooths out isolated bursts.
+        auto const interval = now - last;
+        auto const mean = meanInterval.load(std::memory_order_relaxed);
+        meanInterval.store(mean == 0 ? interval : mean + (interval - mean) / 8, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief spinBudget Returns for how long a waiter should spin given the recent arrivals
+     * @return the spin duration
+     */
+    [[nodiscard]] std::chrono::nanoseconds spinBudget() const {
+        auto const mean = meanInterval.load(std::memory_order_relaxed);
+        if (mean == 0 || mean > MAX_SPIN.count()) {
+            return MIN_SPIN;
+        }
+        return std::clamp(std::chrono::nanoseconds(2 * mean), MIN_SPIN, MAX_SPIN);
+    }
+
+    /**
+     * @brief spinUntil Spins until the predicate holds or the spin budget is exhausted. The first half
+     * of the budget busy-waits with a cpu hint, the second half yields the processor between checks.
+     * On a single processor busy-waiting only delays the thread we are waiting for, so it always yields.
+     * @param ready the predicate to check, must be safe to call outside of the monitor
+     * @return true if the predicate became true while spinning
+     */
+    template <typename Predicate>
+    bool spinUntil(Predicate ready) const {
+        auto const start    = Clock::now();
+        auto const budget   = spinBudget();
+        auto const yieldAt  = start + (multiprocessor() ? budget / 2 : std::chrono::nanoseconds(0));
+        auto const deadline = start + budget;
+
+        for (;;) {
+            if (ready()) {
+                return true;
+            }
+            auto const now = Clock::now();
+            if (now >= deadline) {
+                return false;
+            }
+            if (now < yieldAt) {
+                cpuRelax();
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+private:
+    /**
+     * @brief multiprocessor Returns true if the threads can actually run in parallel
+     */
+    static bool multiprocessor() {
+        static const bool result = std::thread::hardware_concurrency() > 1;
+        return result;
+    }
+
+    /**
+     * @brief cpuRelax Hints the processor that we are in a spin loop
+     */
+    static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+    std::atomic<std::int64_t> lastArrival{0};
+    std::atomic<std::int64_t> meanInterval{0};
+};
+
+#endif // WAITSTRATEGY_H